@@ -7,15 +7,59 @@
 #include "cmdwrite.h"
 #include "cmddasm.h"
 #include "cmdasm.h"
+#include "cmdbreak.h"
+#include "cmdprof.h"
 #include "cmdprog.h"
+#include "cmdrun.h"
+#include "cmdxfer.h"
+#include "cmdsnap.h"
+#include "cmdwatch.h"
+#include "snap.h"
+#include "console.h"
+#include "via.h"
 
 
-// The read, write, asm, dasm and prog commands expect a memory
+// A console device at 8000 (data) and 8001 (status); the example program writes to it
+// The console command (below) queues received bytes; commands like 'read 8000' show ?? for the I/O page
+#define CON_ADDR 0x8000
+console_t con;
+
+
+// A VIA at 9000-900F (mirrored in page 90), its timers run on the scheduler of the cpu of the run commands
+#define VIA_PAGE 0x90
+via_t via;
+cpusched_t sched;
+
+
+// The read, write, asm, dasm, prog, load, save, import, snapshot, restore and run commands expect a memory
+// The snapshot module needs to be told about writes (page copy-on-write)
 #define MEM_SIZE 1024
 const uint16_t mem_size= MEM_SIZE;
 uint8_t mem[MEM_SIZE]={0};
-uint8_t mem_read(uint16_t addr) { return mem[addr%MEM_SIZE];}
-void    mem_write(uint16_t addr, uint8_t data) { mem[addr%MEM_SIZE]=data; }
+uint8_t mem_read(uint16_t addr) { if( console_at(&con,addr) ) return console_read(&con,addr); if( (addr>>8)==VIA_PAGE ) return via_read(&via,addr); return mem[addr%MEM_SIZE];}
+void    mem_write(uint16_t addr, uint8_t data) { if( console_at(&con,addr) ) { console_write(&con,addr,data); return; } if( (addr>>8)==VIA_PAGE ) { via_write(&via,addr,data); return; } snap_write(addr); mem[addr%MEM_SIZE]=data; }
+
+
+// The handler for the "console" command: it feeds the input queue of the console, as a serial line would
+static void cmdconsole_main(int argc, char * argv[]) {
+  if( argc==1 ) { cmd_printf_P(PSTR("INFO: console input has %X bytes\r\n"),con.rxlen); return; }
+  for( int i=1; i<argc; i++ ) {
+    uint16_t data;
+    if( !cmd_parse(argv[i],&data) || data>0xFF ) { cmd_printf_P(PSTR("ERROR: expected hex <byte>, not '%s'\r\n"),argv[i]); return; }
+    if( !console_rx(&con,data) ) { Serial.println(F("ERROR: console input full")); return; }
+  }
+}
+
+
+static const char cmdconsole_longhelp[] PROGMEM = 
+  "SYNTAX: console\r\n"
+  "- shows the number of bytes in the input queue of the console\r\n"
+  "SYNTAX: console <byte>...\r\n"
+  "- adds the <byte>s (00..FF) to the input queue of the console\r\n"
+  "NOTES:\r\n"
+  "- the program reads them from the data register 8000\r\n"
+  "- bit 0 of the status register 8001 is set when a byte is available\r\n"
+;
 
 
 void banner() {
@@ -37,6 +81,7 @@ void banner() {
 void setup() {
   Serial.begin(115200);
   banner();
+  console_init(&con,CON_ADDR,0);
   cmd_begin();
   // Register in alphabetical order
   cmdasm_register();  
@@ -47,9 +92,23 @@ void setup() {
   cmdprog_register();
   cmdread_register(); 
   cmdwrite_register();
+  cmdxfer_register(); // load, save and import
+  // Registered after the above, so that existing short forms (like w for write) keep their meaning
+  cmdbreak_register();
+  cmdprof_register();
+  cmdrun_register(); // regs, run, step and until
+  cmdsnap_register(); // snapshot and restore
+  cmdwatch_register();
+  cmd_register(cmdconsole_main, PSTR("console"), PSTR("feed input to the console at 8000"), cmdconsole_longhelp);
+  // Attach the devices to the cpu of the run commands
+  cpusched_init(&sched,cmdrun_cpu.cycles);
+  cmdrun_cpu.sched= &sched;
+  via_init(&via,&cmdrun_cpu,&sched,VIA_PAGE);
 }
 
 
 void loop() {
   cmd_pollserial(); // Feed command interpreter with chars from serial
+  cmdrun_poll(); // Next burst of a running program
+  console_flush(&con); // Write out what the 6502 printed
 }
@@ -1,6 +1,7 @@
 # isa6502.py - Instruction set architecture of the 6502: generate various tables opcode tables
 
 import sys
+import re
 import datetime
 
 version=7
@@ -479,12 +480,100 @@ for ins in instructions :
   for amode in addrmodes :
     if ins.iname==amode.aname : print("ERROR: duplicate name ", ins.iname)
 
+# FLAGS ###############################################################
+
+# The flags string of an instruction has one letter per bit of the status register, "NVxBDIZC" (bit 7 to bit 0).
+# An uppercase letter means the instruction writes (updates) that flag.
+flag_names= "NVxBDIZC"
+
+# Flags read by instructions; this is not in the flags strings, so listed here (instructions not listed read no flags)
+flag_reads= {
+  "ADC":"DC", "SBC":"DC", "ROL":"C", "ROR":"C",
+  "BCC":"C", "BCS":"C", "BEQ":"Z", "BNE":"Z", "BMI":"N", "BPL":"N", "BVC":"V", "BVS":"V",
+  "PHP":"NVDIZC", "BRK":"NVDIZC", 
+}
+
+# Returns the bit mask (of the status register) for the flags in string `flags`, using `flag_names` positions
+def flags_mask(flags) :
+  mask= 0
+  for pos,ch in enumerate(flags) :
+    if ch==flag_names[pos].upper() and ch!='X' : mask|= 0x80>>pos
+  return mask
+
+# Post-processing: set fwrites and freads (bit masks) of all instructions
+for ins in instructions :
+  ins.fwrites= flags_mask(ins.flags) if ins.iix>0 else 0
+  ins.freads= 0
+  for ch in flag_reads.get(ins.iname,"") : ins.freads|= 0x80>>flag_names.upper().index(ch)
+
 def variant_find_by_name(instruction,aname) :
   for var in instruction.vars :
     if var.amode.aname==aname : 
       return var
   return None
 
+# FUSION ##############################################################
+
+# The execution engine executes a pair of opcodes from the fusion table in one step (see cpu_run in cpu.h).
+# The engine has a handler per class of pairs; a class lists the instructions (an instruction without
+# addressing mode stands for all its variants) that may come first, and those that may come second.
+fuse_classes= [
+  ("LDST",   "LDA.IMM LDX.IMM LDY.IMM",                             "STA.ZPG STA.ABS STX.ZPG STX.ABS STY.ZPG STY.ABS"),
+  ("CARRY",  "CLC SEC",                                             "ADC.IMM ADC.ZPG ADC.ABS SBC.IMM SBC.ZPG SBC.ABS"),
+  ("INCBRA", "INX INY DEX DEY",                                     "BNE BEQ BPL BMI"),
+  ("INCCMP", "INX INY DEX DEY",                                     "CMP.IMM CMP.ZPG CMP.ABS CPX.IMM CPX.ZPG CPX.ABS CPY.IMM CPY.ZPG CPY.ABS"),
+  ("CMPBRA", "CMP.IMM CMP.ZPG CMP.ABS CPX.IMM CPX.ZPG CPX.ABS CPY.IMM CPY.ZPG CPY.ABS", "BNE BEQ BCC BCS BPL BMI"),
+]
+
+# The pairs in the table are selected from the pair counts of the profiler: the output of 'prof pairs', saved
+# to a file, is passed to 'cpp'. Without such a file the default pairs are used; they dominate the loops of
+# typical code. A pair is written as "LDA.IMM STA.ABS"; pairs without a class are skipped.
+fuse_default= [ "LDA.IMM STA.ABS", "CLC ADC", "DEX BNE", "INY CPY" ]
+fuse_max= 16   # The table has at most this many pairs
+fuse_share= 1  # A pair from the profile needs at least this share (in percent) of all pairs counted
+
+# Returns the name (e.g. "LDA.IMM") of `opcode`
+def variants_name(opcode) :
+  for ins in instructions :
+    for var in ins.vars :
+      if var.opcode==opcode : return f"{ins.iname}.{var.amode.aname}"
+  return "???"
+
+# Returns the opcodes of `spec` (e.g. "LDA.IMM" or "LDA")
+def fuse_opcodes(spec) :
+  iname,_,aname= spec.partition(".")
+  for ins in instructions :
+    if ins.iname==iname : return [var.opcode for var in ins.vars if aname in ("",var.amode.aname)]
+  return []
+
+# Returns the name of the class of the pair (op1,op2), or None when no handler executes that pair
+def fuse_class(op1,op2) :
+  for name,firsts,seconds in fuse_classes :
+    if any(op1 in fuse_opcodes(spec) for spec in firsts.split()) and any(op2 in fuse_opcodes(spec) for spec in seconds.split()) :
+      return name
+  return None
+
+# Returns the (sorted) list of (op1,op2) pairs of the default table
+def fuse_pairs_default() :
+  pairs= []
+  for spec in fuse_default :
+    first,second= spec.split()
+    pairs+= [(op1,op2) for op1 in fuse_opcodes(first) for op2 in fuse_opcodes(second) if fuse_class(op1,op2)]
+  return sorted(pairs)[:fuse_max]
+
+# Returns the (sorted) list of (op1,op2) pairs from file `name` with the output of 'prof pairs'
+def fuse_pairs_load(name) :
+  counts= []
+  total= 0
+  for line in open(name) :
+    m= re.match(r"^([0-9A-F]{2}) ([0-9A-F]{2}) ([0-9A-F]{8})", line)
+    if m : counts.append( (int(m[3],16),int(m[1],16),int(m[2],16)) )
+    m= re.match(r"^total +([0-9A-F]{8})", line)
+    if m : total= int(m[1],16)
+  counts.sort(reverse=True)
+  pairs= [(op1,op2) for count,op1,op2 in counts if count*100>=fuse_share*total and fuse_class(op1,op2)]
+  return sorted(pairs[:fuse_max])
+
 # Print addressing modes ##############################################
 
 def print_amodes() :
@@ -771,6 +860,8 @@ def print_cpp_instructions() :
   print("  const char * const help;")
   print("  const char * const flags;")
   print(f"  const uint8_t opcodes[{len(addrmodes)}]; // for each addrmode, the opcode")
+  print("  const uint8_t fwrites; // flags (ISA_FLAG_xxx) written by the instruction, derived from `flags`")
+  print("  const uint8_t freads; // flags (ISA_FLAG_xxx) read by the instruction")
   print("} isa_instruction_t;")
   print()
   print("// Opcode 0xBB is not in use in the 6502. We use it in instructions.opcodes to signal the addrmode does not exist for that instruction");
@@ -783,7 +874,7 @@ def print_cpp_instructions() :
     for var in ins.vars :
       opcodes[var.amode.aix]= var.opcode 
     opcodes_s = "{" + ",".join([ f"0x{o:02x}" for o in opcodes ]) + "}"
-    print( f"  /*{ins.iix:2}*/ {{ ISA_IIX_{ins.iname}_iname, ISA_IIX_{ins.iname}_desc, ISA_IIX_{ins.iname}_help, ISA_IIX_{ins.iname}_flags, {opcodes_s} }},")
+    print( f"  /*{ins.iix:2}*/ {{ ISA_IIX_{ins.iname}_iname, ISA_IIX_{ins.iname}_desc, ISA_IIX_{ins.iname}_help, ISA_IIX_{ins.iname}_flags, {opcodes_s}, 0x{ins.fwrites:02x}, 0x{ins.freads:02x} }},")
   print("};")
   print()
   print("const char *  isa_instruction_iname  ( int iix )          { return (const char *)pgm_read_word(&isa_instructions[iix].iname ); }")
@@ -791,6 +882,8 @@ def print_cpp_instructions() :
   print("const char *  isa_instruction_help   ( int iix )          { return (const char *)pgm_read_word(&isa_instructions[iix].help  ); }")
   print("const char *  isa_instruction_flags  ( int iix )          { return (const char *)pgm_read_word(&isa_instructions[iix].flags ); }")
   print("uint8_t       isa_instruction_opcodes( int iix, int aix ) { return (uint8_t     )pgm_read_byte(&isa_instructions[iix].opcodes[aix] ); }")
+  print("uint8_t       isa_instruction_fwrites( int iix )          { return (uint8_t     )pgm_read_byte(&isa_instructions[iix].fwrites ); }")
+  print("uint8_t       isa_instruction_freads ( int iix )          { return (uint8_t     )pgm_read_byte(&isa_instructions[iix].freads  ); }")
   print()
   print("// Prints the addressing mode name (eg ABS) associated with `aix` to `str`. ")
   print("// This function writes at most `size` bytes to `str`.")
@@ -865,16 +958,116 @@ def print_cpp_opcodes() :
   print("uint8_t isa_opcode_cycles ( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&isa_opcodes[opcode].cycles ); }")
   print("uint8_t isa_opcode_xcycles( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&isa_opcodes[opcode].xcycles); }")
   print()
+  print("// The length (in bytes) of the instruction for each opcode; 0 for opcodes not in use.")
+  print("// This duplicates isa_addrmode_bytes(isa_opcode_aix(opcode)), but with a single lookup, for scanning memory.")
+  print("const uint8_t isa_opcode_lens[] PROGMEM = {")
+  for row in range(16) :
+    print("  /*"+f"{row*16:02x}"+"*/ "+ " ".join( f"{var.amode.bytes if var else 0}," for var in vars[row*16:row*16+16] ) )
+  print("};")
+  print()
+  print("uint8_t isa_opcode_bytes  ( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&isa_opcode_lens[opcode]); }")
+  print()
+  print("// The cycles of an instruction depend on where it is and what it accesses (datasheet footnotes 1 and 2):")
+  print("// - reading with ABX, ABY or ZIY costs one more when indexing crosses a page (the high byte of the address")
+  print("//   needs fixing); writing (and read-modify-write) always takes that cycle, so their xcycles is 0")
+  print("// - a taken branch costs one more, and another one when it lands in another page than the next instruction")
+  print("uint8_t isa_cycles_exact( uint8_t opcode, uint16_t pc, uint16_t base, uint16_t ea, bool taken ) {")
+  print("  uint8_t cycles= pgm_read_byte(&isa_opcodes[opcode].cycles);")
+  print("  switch( pgm_read_byte(&isa_opcodes[opcode].aix) ) {")
+  print("    case ISA_AIX_ABX : case ISA_AIX_ABY : case ISA_AIX_ZIY :")
+  print("      if( (base^ea)&0xFF00 ) cycles+= pgm_read_byte(&isa_opcodes[opcode].xcycles);")
+  print("      break;")
+  print("    case ISA_AIX_REL :")
+  print("      if( taken ) cycles+= (((uint16_t)(pc+2)^ea)&0xFF00) ? 2 : 1;")
+  print("      break;")
+  print("  }")
+  print("  return cycles;")
+  print("}")
+  print()
+  print()
+  print("// SCANNING ####################################################")
+  print()
+  print()
+  print("// Fills lens[i] with the length of the instruction that would start at buf[i], for all i in 0..n-1.")
+  print("// An opcode not in use gets length 0 (a walker should step over it as 1 byte).")
+  print("void isa_scan_lengths( const uint8_t * buf, uint16_t n, uint8_t * lens ) {")
+  print("  while( n-- > 0 ) *lens++= pgm_read_byte(&isa_opcode_lens[*buf++]);")
+  print("}")
+  print()
+  print("// Returns the most likely offset (0, 1 or 2) of the first instruction boundary in the `n` bytes of `buf`.")
+  print("// The three instruction chains (starting at offset 0, 1 and 2) are walked in lockstep, each collecting penalties:")
+  print("// 4 for an opcode not in use, 4 for an instruction sticking out of `buf`, and 1 for BRK (00 is more likely data).")
+  print("// Chains typically merge within a few instructions; once all three are at the same position the walk stops,")
+  print("// because the rest would add the same penalties to all. The chain with the lowest penalty wins (ties: lowest offset).")
+  print("uint8_t isa_scan_resync( const uint8_t * buf, uint16_t n ) {")
+  print("  uint16_t pos[3];")
+  print("  uint16_t penalty[3]= {0,0,0};")
+  print("  for( uint8_t c=0; c<3; c++ ) pos[c]= c<n ? c : n;")
+  print("  while( 1 ) {")
+  print("    // Step the chain that is behind the most")
+  print("    uint8_t c= 0;")
+  print("    if( pos[1]<pos[c] ) c= 1;")
+  print("    if( pos[2]<pos[c] ) c= 2;")
+  print("    if( pos[c]>=n ) break;")
+  print("    if( pos[0]==pos[1] && pos[1]==pos[2] ) break;")
+  print("    uint8_t opcode= buf[pos[c]];")
+  print("    uint8_t len= pgm_read_byte(&isa_opcode_lens[opcode]);")
+  print("    if( len==0 ) { penalty[c]+= 4; len= 1; } else if( opcode==0x00 ) penalty[c]+= 1;")
+  print("    if( pos[c]+len>n ) penalty[c]+= 4;")
+  print("    pos[c]+= len;")
+  print("  }")
+  print("  uint8_t best= 0;")
+  print("  for( uint8_t c=1; c<3; c++ ) if( penalty[c]<penalty[best] ) best= c;")
+  print("  return best;")
+  print("}")
+  print()
   print()
   
+def print_cpp_fuse(pairs,source) :
+  print("// FUSION ######################################################")
+  print()
+  print()
+  print(f"// The pairs of opcodes that cpu_run() executes in one step ({source}).")
+  print("// The bit map has a bit per opcode that starts a pair; the list of pairs is sorted.")
+  firsts= [0]*32
+  for op1,op2 in pairs : firsts[op1>>3]|= 1<<(op1&7)
+  print("const uint8_t isa_fuse_firsts[] PROGMEM = {")
+  for row in range(4) :
+    print("  "+" ".join( f"0x{b:02X}," for b in firsts[row*8:row*8+8] ) )
+  print("};")
+  print("const uint16_t isa_fuse_pairs[] PROGMEM = {")
+  for op1,op2 in pairs :
+    print( f"  0x{op1:02X}{op2:02X}, // {variants_name(op1)} {variants_name(op2)}" )
+  print("};")
+  print("const uint8_t isa_fuse_classes[] PROGMEM = {")
+  for op1,op2 in pairs :
+    print( f"  ISA_FUSE_{fuse_class(op1,op2)}," )
+  print("};")
+  print( f"#define ISA_FUSE_NUM {len(pairs)}")
+  print()
+  print("uint8_t isa_opcode_fuse( uint8_t op1, uint8_t op2 ) {")
+  print("  if( !(pgm_read_byte(&isa_fuse_firsts[op1>>3]) & (1<<(op1&7))) ) return 0;")
+  print("  uint16_t pair= (op1<<8) | op2;")
+  print("  for( uint8_t i=0; i<ISA_FUSE_NUM; i++ ) {")
+  print("    uint16_t p= pgm_read_word(&isa_fuse_pairs[i]);")
+  print("    if( p>=pair ) return p==pair ? pgm_read_byte(&isa_fuse_classes[i]) : 0;")
+  print("  }")
+  print("  return 0;")
+  print("}")
+  print()
+  print()
+
 def print_cpp_footer() :
   pass
 
-def print_cpp() :
+def print_cpp(pairsfile=None) :
+  if pairsfile : pairs,source= fuse_pairs_load(pairsfile), f"from the profile in {pairsfile}"
+  else : pairs,source= fuse_pairs_default(), "the default pairs of isa6502.py"
   print_cpp_header()
   print_cpp_addrmodes()
   print_cpp_instructions()
   print_cpp_opcodes()
+  print_cpp_fuse(pairs,source)
   print_cpp_footer()
 
 # Print H file content ################################################
@@ -949,11 +1142,17 @@ def print_h_instructions() :
   print("// Opcode 0xBB is not in use in the 6502. We use it in instruction.opcodes to signal the addrmode does not exist for that instruction")
   print("#define ISA_OPCODE_INVALID 0xBB")
   print()
+  print("// The flags in the (program) status register; bit masks for isa_instruction_fwrites() and isa_instruction_freads()")
+  for pos,ch in enumerate(flag_names) :
+    if ch!='x' : print( f"#define ISA_FLAG_{ch.upper()} 0x{0x80>>pos:02X}")
+  print()
   print("/*PROGMEM*/ const char * isa_instruction_iname  ( int iix );          // The instruction name (e.g. LDA)")
   print("/*PROGMEM*/ const char * isa_instruction_desc   ( int iix );          // The description of the instruction")
   print("/*PROGMEM*/ const char * isa_instruction_help   ( int iix );          // The detailed description of the instruction")
   print("/*PROGMEM*/ const char * isa_instruction_flags  ( int iix );          // The (program status) flags the instruction updates")
   print("            uint8_t      isa_instruction_opcodes( int iix, int aix ); // For each addrmode, the actual opcode")
+  print("            uint8_t      isa_instruction_fwrites( int iix );          // The flags (ISA_FLAG_xxx mask) the instruction writes (uppercase letters in flags)")
+  print("            uint8_t      isa_instruction_freads ( int iix );          // The flags (ISA_FLAG_xxx mask) the instruction reads (so they must be valid)")
   print("            int          isa_snprint_iname      (char * str, int size, int minlen, int iix); // Prints the instruction name (eg LDA) associated with `iix` to `str`.")
   print("            int          isa_instruction_find   (const char * iname); // Returns iix for `iname` or 0 if not found")
   print()
@@ -969,6 +1168,27 @@ def print_h_opcodes() :
   print("uint8_t isa_opcode_aix    ( uint8_t opcode ); // Index into isa_addrmode_xxx[]")
   print("uint8_t isa_opcode_cycles ( uint8_t opcode ); // The (minimal) number of cycles to execute this instruction variant (0..)")
   print("uint8_t isa_opcode_xcycles( uint8_t opcode ); // The worst case additional number of cycles to execute this instruction variant (0..)")
+  print("uint8_t isa_opcode_bytes  ( uint8_t opcode ); // Number of bytes of the instruction (1..3), 0 for opcodes not in use (single table lookup)")
+  print("")
+  print("// The exact number of cycles of instruction `opcode` at `pc`, with effective address `ea`. For the indexed modes (ABX, ABY,")
+  print("// ZIY) `base` is the address before indexing, for a branch `ea` is the target and `taken` tells whether the branch is taken.")
+  print("uint8_t isa_cycles_exact  ( uint8_t opcode, uint16_t pc, uint16_t base, uint16_t ea, bool taken );")
+  print("")
+  print("")
+  print("// Fusion =============================================================")
+  print("// Pairs of opcodes that the execution engine executes in one step (see cpu_run), by class of pair")
+  print()
+  for ix,(name,firsts,seconds) in enumerate(fuse_classes) :
+    print( f"#define ISA_FUSE_{name:6} {ix+1} // {firsts} followed by {seconds}")
+  print()
+  print("uint8_t isa_opcode_fuse   ( uint8_t op1, uint8_t op2 ); // The class (ISA_FUSE_xxx) of the pair in the fusion table, 0 when not in the table")
+  print("")
+  print("")
+  print("// Scanning ===========================================================")
+  print("// Finding instruction boundaries in a block of bytes (e.g. a ROM image) copied to RAM.")
+  print()
+  print("void    isa_scan_lengths( const uint8_t * buf, uint16_t n, uint8_t * lens ); // lens[i] is isa_opcode_bytes(buf[i]), for all i<n")
+  print("uint8_t isa_scan_resync ( const uint8_t * buf, uint16_t n ); // Returns most likely offset (0..2) of first instruction boundary in buf")
   print("")
   print("")
 
@@ -1027,7 +1247,7 @@ def help() :
   print("  amodes - prints the addressing modes")
   print("  insts  - prints alphabetical list of instructions, a column per address mode")
   print("  opcodes- prints the 16x16 opcode matrix")
-  print("  cpp    - prints source file for c module")
+  print("  cpp    - prints source file for c module; 'cpp <file>' takes the fusion table from 'prof pairs' output in <file>")
   print("  h      - prints header file for c module")
   print("  test   - prints python file for testing")
   
@@ -1037,7 +1257,7 @@ def main() :
     print()
     print("Missing table name, try 'help'")
     exit(1)
-  if len(sys.argv)>2:
+  if len(sys.argv)>2 and not (sys.argv[1]=="cpp" and len(sys.argv)==3):
     print("Welcome to 6502ins")
     print()
     print("Specify one table name, try 'help'")
@@ -1053,7 +1273,7 @@ def main() :
   elif sys.argv[1]=="opcodes" :
     print_opcodes()
   elif sys.argv[1]=="cpp" :
-    print_cpp()
+    print_cpp(sys.argv[2] if len(sys.argv)==3 else None)
   elif sys.argv[1]=="h" :
     print_h()
   elif sys.argv[1]=="test" :
@@ -1064,6 +1284,7 @@ def main() :
     print("Unknown table name, try 'help'")
     exit(1)
 
-main()
+if __name__=="__main__" :
+  main()
 
 
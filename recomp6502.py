@@ -0,0 +1,335 @@
+# recomp6502.py - Static recompiler: translates a 6502 memory image to C++, with the code of each basic block (see src/cpurecomp.h)
+
+import sys
+import argparse
+import datetime
+import isa6502
+
+version=2
+
+# Opcode table: opcode -> Variant of isa6502 (with .ins, .amode, .cycles and .xcycles)
+variants= {}
+for ins in isa6502.instructions :
+  for var in ins.vars :
+    variants[var.opcode]= var
+
+# LOADING #############################################################
+
+# The image is 64k of bytes, with a flag per byte telling whether it was loaded
+mem= [0]*0x10000
+loaded= [False]*0x10000
+
+def load_bytes(addr,data) :
+  for i,b in enumerate(data) :
+    mem[(addr+i)&0xFFFF]= b
+    loaded[(addr+i)&0xFFFF]= True
+
+# Loads Intel HEX records (as printed by 'prog compile hex'); returns the number of data bytes
+def load_hex(lines) :
+  num= 0
+  for line in lines :
+    line= line.strip()
+    if not line.startswith(":") : continue
+    rec= bytes.fromhex(line[1:])
+    if sum(rec)&0xFF!=0 : sys.exit(f"ERROR: checksum error in '{line}'")
+    if rec[3]==0x00 : load_bytes(rec[1]*256+rec[2],rec[4:4+rec[0]]); num+= rec[0]
+  return num
+
+# Loads Motorola S1 records (as printed by 'prog compile srec'); returns the number of data bytes
+def load_srec(lines) :
+  num= 0
+  for line in lines :
+    line= line.strip()
+    if not line.startswith("S1") : continue
+    rec= bytes.fromhex(line[2:])
+    if sum(rec)&0xFF!=0xFF : sys.exit(f"ERROR: checksum error in '{line}'")
+    load_bytes(rec[1]*256+rec[2],rec[3:rec[0]]); num+= rec[0]-3
+  return num
+
+def word(addr) :
+  return mem[addr&0xFFFF] | mem[(addr+1)&0xFFFF]<<8
+
+# BASIC BLOCKS ########################################################
+
+# Returns the Variant of the instruction at `addr`, or None when it can not be recompiled (not loaded, or opcode not in use)
+def decode(addr) :
+  var= variants.get(mem[addr])
+  if var is None : return None
+  for i in range(var.amode.bytes) :
+    if not loaded[(addr+i)&0xFFFF] : return None
+  return var
+
+# Instructions the interpreter executes: they end the block before them
+def interpreted(var) :
+  return var.ins.iname in ("BRK","RTI") or (var.ins.iname=="JMP" and var.amode.aname=="IND")
+
+# Instructions that end a block after them
+def ends_block(var) :
+  return var.amode.aname=="REL" or var.ins.iname in ("JMP","JSR","RTS","CLI","PLP")
+
+def target(addr,var) :
+  if var.amode.aname=="REL" : return (addr+2+((mem[(addr+1)&0xFFFF]^0x80)-0x80))&0xFFFF
+  return word(addr+1)
+
+# Finds the instructions reachable from `entries`; returns the sorted list of block start addresses (leaders)
+def find_leaders(entries) :
+  leaders= set(entries)
+  seen= set()
+  todo= list(entries)
+  while todo :
+    addr= todo.pop()
+    while addr not in seen :
+      seen.add(addr)
+      var= decode(addr)
+      if var is None or interpreted(var) : break
+      nxt= (addr+var.amode.bytes)&0xFFFF
+      if var.amode.aname=="REL" or var.ins.iname=="JSR" or (var.ins.iname=="JMP" and var.amode.aname=="ABS") :
+        t= target(addr,var)
+        leaders.add(t)
+        todo.append(t)
+      if var.ins.iname in ("JMP","RTS") : break
+      if ends_block(var) : leaders.add(nxt)
+      addr= nxt
+  return sorted(leaders)
+
+# Returns the instructions (list of (addr,var)) of the block starting at `start`
+def block_instructions(start,leaders) :
+  insts= []
+  addr= start
+  while True :
+    var= decode(addr)
+    if var is None or interpreted(var) : break
+    insts.append((addr,var))
+    addr= (addr+var.amode.bytes)&0xFFFF
+    if ends_block(var) or addr in leaders or addr==start : break
+  return insts
+
+# CODE GENERATION #####################################################
+
+def dasm(addr,var) :
+  am= var.amode
+  if am.bytes==1 : op= ""
+  elif am.aname=="REL" : op= f"{target(addr,var):04X}"
+  elif am.bytes==2 : op= f"{mem[(addr+1)&0xFFFF]:02X}"
+  else : op= f"{word(addr+1):04X}"
+  text= isa6502.addrmode_op_subst(am,op)
+  return f"{addr:04X} {var.ins.iname}" + (" "+text if text else "")
+
+# Returns (lines,ea,cross) for the memory operand of the instruction at `addr`: statements computing the
+# effective address, its expression, and the expression for the extra cycle of a page crossing (or None)
+def operand(addr,var) :
+  op8= mem[(addr+1)&0xFFFF]
+  op16= word(addr+1)
+  am= var.amode.aname
+  if am=="ZPG" : return [], f"0x{op8:02X}", None
+  if am=="ZPX" : return [], f"(uint8_t)(0x{op8:02X} + x)", None
+  if am=="ZPY" : return [], f"(uint8_t)(0x{op8:02X} + y)", None
+  if am=="ABS" : return [], f"0x{op16:04X}", None
+  if am=="ABX" : return [], f"(uint16_t)(0x{op16:04X} + x)", f"(0x{op16&0xFF:02X} + x)>>8"
+  if am=="ABY" : return [], f"(uint16_t)(0x{op16:04X} + y)", f"(0x{op16&0xFF:02X} + y)>>8"
+  if am=="ZXI" : return [f"uint8_t zp= 0x{op8:02X} + x;", "uint16_t ea= mem_read(zp) | mem_read((uint8_t)(zp+1))<<8;"], "ea", None
+  if am=="ZIY" : return [f"uint16_t base= mem_read(0x{op8:02X}) | mem_read(0x{(op8+1)&0xFF:02X})<<8;", "uint16_t ea= base + y;"], "ea", "((base&0xFF) + y)>>8"
+  return [], None, None
+
+# Binary add of `m` (an expression) to a, as ADC does (SBC adds the inverted operand)
+def adc(m,sub) :
+  dec= f"uint16_t rf= cpu_decimal(a,m,c,{'true' if sub else 'false'}); a= rf>>8; n= rf; z= ~rf & ISA_FLAG_Z; v= (rf & ISA_FLAG_V)!=0; c= rf & ISA_FLAG_C;"
+  bin= f"uint16_t s= a + {'(uint8_t)~m' if sub else 'm'} + c; v= ((a^s) & ({'(uint8_t)~m' if sub else 'm'}^s) & 0x80)!=0; c= s>>8; n= z= a= s;"
+  return [f"uint8_t m= {m};", f"if( p & ISA_FLAG_D ) {{ {dec} }}", f"else {{ {bin} }}"]
+
+# Branch conditions (in terms of the flag locals)
+conditions= {
+  "BCC":"!c", "BCS":"c", "BNE":"z", "BEQ":"!z", "BPL":"!(n & 0x80)", "BMI":"n & 0x80", "BVC":"!v", "BVS":"v",
+}
+
+# Returns the lines of C++ for the instruction `var` at `addr`; `leaders` are the block start addresses
+# The flag locals: n (N is bit 7), z (Z when 0), c and v (0 or 1); D and I are in p.
+def instruction(addr,var,leaders) :
+  iname= var.ins.iname
+  am= var.amode.aname
+  nxt= (addr+var.amode.bytes)&0xFFFF
+  lines,ea,cross= operand(addr,var)
+  # A device sees cpu->cycles at the start of the instruction (as with cpu_step), so that is stored before
+  # an access that may hit an I/O page (zero page and stack are taken not to be I/O)
+  if am in ("ABS","ABX","ABY","ZXI","ZIY") and iname not in ("JMP","JSR") : lines.insert(0,"cpu->cycles= cyc;")
+  lines.append(f"cyc+= {var.cycles};")
+  if cross and var.xcycles : lines.append(f"cyc+= {cross};")
+  if am=="IMM" : m= f"0x{mem[(addr+1)&0xFFFF]:02X}"
+  elif am=="ACC" : m= "a"
+  else : m= f"mem_read({ea})"
+  def write(v) :
+    if am=="ACC" : return [f"a= {v};"]
+    return [f"if( cpurecomp_write({ea},{v}) ) {{ pc= 0x{nxt:04X}; goto leave; }}"]
+  def push(v,pc=nxt) :
+    return [f"if( cpurecomp_write(0x0100|sp--,{v}) ) {{ pc= 0x{pc:04X}; goto leave; }}"]
+  def jump(t) :
+    # Continue in C++ with the block at the target (when there is one)
+    if t in leaders : return [f"pc= 0x{t:04X}; goto chain_{t:04X};"]
+    return [f"pc= 0x{t:04X}; goto leave;"]
+  if   iname=="ADC" : lines+= adc(m,False)
+  elif iname=="SBC" : lines+= adc(m,True)
+  elif iname in ("AND","ORA","EOR") : lines.append(f"n= z= a{ {'AND':'&','ORA':'|','EOR':'^'}[iname] }= {m};")
+  elif iname=="ASL" : lines+= [f"uint8_t m= {m};", "c= m>>7; m<<= 1; n= z= m;"] + write("m")
+  elif iname=="LSR" : lines+= [f"uint8_t m= {m};", "c= m&1; m>>= 1; n= z= m;"] + write("m")
+  elif iname=="ROL" : lines+= [f"uint8_t m= {m};", "uint8_t r= (m<<1) | c; c= m>>7; n= z= r;"] + write("r")
+  elif iname=="ROR" : lines+= [f"uint8_t m= {m};", "uint8_t r= (m>>1) | (c<<7); c= m&1; n= z= r;"] + write("r")
+  elif iname=="BIT" : lines+= [f"uint8_t m= {m};", "z= a & m; n= m; v= (m>>6)&1;"]
+  elif iname in ("CMP","CPX","CPY") : lines+= [f"uint16_t s= { {'CMP':'a','CPX':'x','CPY':'y'}[iname] } + (uint8_t)~{m} + 1;", "c= s>>8; n= z= s;"]
+  elif iname=="DEC" : lines+= [f"uint8_t m= {m} - 1;", "n= z= m;"] + write("m")
+  elif iname=="INC" : lines+= [f"uint8_t m= {m} + 1;", "n= z= m;"] + write("m")
+  elif iname in ("DEX","DEY") : lines.append(f"n= z= --{iname[2].lower()};")
+  elif iname in ("INX","INY") : lines.append(f"n= z= ++{iname[2].lower()};")
+  elif iname in ("LDA","LDX","LDY") : lines.append(f"n= z= {iname[2].lower()}= {m};")
+  elif iname in ("STA","STX","STY") : lines+= write(iname[2].lower())
+  elif iname in ("TAX","TAY","TSX","TXA","TYA") :
+    src= {"TAX":"a","TAY":"a","TSX":"sp","TXA":"x","TYA":"y"}[iname]
+    lines.append(f"n= z= {iname[2].lower()}= {src};")
+  elif iname=="TXS" : lines.append("sp= x;")
+  elif iname=="PHA" : lines+= push("a")
+  elif iname=="PHP" : lines+= push("RECOMP_P | ISA_FLAG_B | 0x20")
+  elif iname=="PLA" : lines.append("n= z= a= mem_read(0x0100|++sp);")
+  elif iname=="PLP" : lines+= ["uint8_t m= mem_read(0x0100|++sp) & ~ISA_FLAG_B;", "p= m; n= m; z= ~m & ISA_FLAG_Z; v= (m>>6)&1; c= m&1;", f"pc= 0x{nxt:04X}; goto leave;"] # I may have cleared
+  elif iname=="CLC" : lines.append("c= 0;")
+  elif iname=="SEC" : lines.append("c= 1;")
+  elif iname=="CLV" : lines.append("v= 0;")
+  elif iname=="CLD" : lines.append("p&= ~ISA_FLAG_D;")
+  elif iname=="SED" : lines.append("p|= ISA_FLAG_D;")
+  elif iname=="CLI" : lines+= ["p&= ~ISA_FLAG_I;", f"pc= 0x{nxt:04X}; goto leave;"] # a pending IRQ is taken before the next instruction
+  elif iname=="SEI" : lines.append("p|= ISA_FLAG_I;")
+  elif iname=="NOP" : pass
+  elif am=="REL" :
+    t= target(addr,var)
+    extra= 2 if (nxt^t)&0xFF00 else 1
+    lines+= [f"if( {conditions[iname]} ) {{", f"  cyc+= {extra};"] + ["  "+l for l in jump(t)] + ["}"] + jump(nxt)
+  elif iname=="JMP" : lines+= jump(word(addr+1))
+  elif iname=="JSR" :
+    ret= (nxt-1)&0xFFFF
+    lines+= push(f"0x{ret>>8:02X}",word(addr+1)) + push(f"0x{ret&0xFF:02X}",word(addr+1)) + jump(word(addr+1))
+  elif iname=="RTS" : lines+= ["uint8_t lo= mem_read(0x0100|++sp);", "pc= (lo | mem_read(0x0100|++sp)<<8) + 1;", "goto dispatch;"]
+  else : sys.exit(f"ERROR: no code for {iname} at {addr:04X}")
+  return lines
+
+# Returns the worst case cycles of one pass through the block
+def block_cycles(insts) :
+  return sum(var.cycles+var.xcycles for addr,var in insts)
+
+# Returns the lines of the block (after its `block_` label); `leaders` are the starts of all blocks
+def block_lines(start,insts,leaders) :
+  lines= []
+  for addr,var in insts :
+    lines.append(f"  {{ // {dasm(addr,var)}")
+    lines+= ["    "+l for l in instruction(addr,var,leaders)]
+    lines.append("  }")
+  # A block that does not end in a jump continues with the next block
+  last,lastvar= insts[-1]
+  if not ends_block(lastvar) :
+    nxt= (last+lastvar.amode.bytes)&0xFFFF
+    lines+= [f"  pc= 0x{nxt:04X};", f"  goto chain_{nxt:04X};" if nxt in leaders else "  goto leave;"]
+  return lines
+
+def block_size(insts) :
+  last,var= insts[-1]
+  return ((last+var.amode.bytes)-insts[0][0])&0xFFFF
+
+def print_cpp(source,entries,name) :
+  leaders= find_leaders(entries)
+  blocks= [(start,block_instructions(start,leaders)) for start in leaders]
+  blocks= [(start,insts) for start,insts in blocks if insts]
+  print(f"// {name}.cpp - recompiled from {source} (entries {' '.join(f'{e:04X}' for e in entries)})")
+  print(f"// This file is generated by {sys.argv[0]} V{version} on", datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S") )
+  print()
+  print()
+  print(f"#include <Arduino.h>")
+  print(f"#include \"isa.h\"")
+  print(f"#include \"cpu.h\"")
+  print(f"#include \"cpurecomp.h\"")
+  print()
+  print()
+  print(f"// The registers are locals; n holds N in bit 7, z is 0 for Z, c and v are 0 or 1, p holds D and I.")
+  print(f"// A block leaves N, V, Z and C lazy in `cpu` (see cpu.h), so the next block can take them without evaluation.")
+  print(f"#define RECOMP_LAZY (ISA_FLAG_N|ISA_FLAG_V|ISA_FLAG_Z|ISA_FLAG_C)")
+  print(f"#define RECOMP_P ((p & ~RECOMP_LAZY) | (n & ISA_FLAG_N) | (v ? ISA_FLAG_V : 0) | (z ? 0 : ISA_FLAG_Z) | (c ? ISA_FLAG_C : 0))")
+  print(f"#define RECOMP_ENTER \\")
+  print(f"  uint8_t  a= cpu->a, x= cpu->x, y= cpu->y, sp= cpu->sp; \\")
+  print(f"  uint8_t  p, n, z, c, v; \\")
+  print(f"  if( cpu->lazy==RECOMP_LAZY ) {{ \\")
+  print(f"    p= cpu->p; n= cpu->lz_n; z= cpu->lz_z; c= (cpu->lz_c>>8) & 1; v= ((cpu->lz_v1^cpu->lz_vr) & (cpu->lz_v2^cpu->lz_vr))>>7; \\")
+  print(f"  }} else {{ \\")
+  print(f"    p= cpu_status(cpu); n= p; z= ~p & ISA_FLAG_Z; c= p & ISA_FLAG_C; v= (p>>6) & 1; \\")
+  print(f"  }} \\")
+  print(f"  uint16_t pc; \\")
+  print(f"  uint32_t cyc= cpu->cycles; \\")
+  print(f"  (void)end;")
+  print(f"#define RECOMP_LEAVE \\")
+  print(f"  cpu->a= a; cpu->x= x; cpu->y= y; cpu->sp= sp; cpu->pc= pc; cpu->cycles= cyc; \\")
+  print(f"  cpu->p= p; cpu->lz_n= n; cpu->lz_z= z; cpu->lz_c= c<<8; cpu->lz_v1= cpu->lz_v2= v<<7; cpu->lz_vr= 0; cpu->lazy= RECOMP_LAZY;")
+  print()
+  print()
+  for start,insts in blocks :
+    print(f"static const uint8_t {name}_{start:04X}_code[]= {{ {', '.join(f'0x{mem[(start+i)&0xFFFF]:02X}' for i in range(block_size(insts)))} }};")
+  print()
+  print()
+  # One function holds all blocks, so that the registers stay in locals from block to block
+  leaders= [start for start,insts in blocks]
+  bodies= [(start,insts,block_lines(start,insts,leaders)) for start,insts in blocks]
+  code= "\n".join(l for start,insts,lines in bodies for l in lines)
+  dispatch= "goto dispatch" in code
+  print(f"// Runs the block at cpu->pc, then the blocks it jumps to, as long as they fit before `end` (see cpurecomp.h)")
+  print(f"static void {name}_run(cpu_t * cpu, uint32_t end) {{")
+  print(f"  RECOMP_ENTER")
+  print(f"  pc= cpu->pc;")
+  print(f"  switch( pc ) {{")
+  for start in leaders : print(f"    case 0x{start:04X}: goto block_{start:04X};")
+  print(f"  }}")
+  print(f"  goto leave;")
+  if dispatch :
+    print(f"dispatch: // after a return, continue with the block at pc (if any)")
+    print(f"  switch( pc ) {{")
+    for start in leaders : print(f"    case 0x{start:04X}: goto chain_{start:04X};")
+    print(f"  }}")
+    print(f"  goto leave;")
+  for start,insts,lines in bodies :
+    # A jump to a block goes via its chain label, which checks that the block may run
+    if dispatch or f"goto chain_{start:04X};" in code :
+      print(f"chain_{start:04X}:")
+      print(f"  if( !cpurecomp_chain || (int32_t)(end-cyc)<{block_cycles(insts)} ) goto leave;")
+    print(f"block_{start:04X}: // {block_cycles(insts)} cycles worst case")
+    for l in lines : print(l)
+  print(f"leave:")
+  print(f"  RECOMP_LEAVE")
+  print(f"}}")
+  print()
+  print()
+  print(f"// The table of blocks, for cpurecomp_init() (declared extern, since a const has internal linkage)")
+  print(f"extern const cpurecomp_block_t {name}_blocks[];")
+  print(f"extern const uint16_t {name}_blocks_num;")
+  print(f"const cpurecomp_block_t {name}_blocks[]= {{")
+  for start,insts in blocks :
+    print(f"  {{ 0x{start:04X}, {block_size(insts)}, {block_cycles(insts)}, {name}_{start:04X}_code, {name}_run }},")
+  print(f"}};")
+  print(f"const uint16_t {name}_blocks_num= {len(blocks)};")
+
+def main() :
+  parser= argparse.ArgumentParser(description="Translates a 6502 memory image to C++, with the code of each basic block (see src/cpurecomp.h)")
+  parser.add_argument("image", help="Intel HEX (.hex) or Motorola S-record (.srec, .s19) file, e.g. from 'prog compile hex', or a binary file")
+  parser.add_argument("-a", "--addr", default="0000", help="load address (hex) of a binary file")
+  parser.add_argument("-e", "--entry", action="append", default=[], help="entry point (hex); may be repeated; default the vectors at FFFA, FFFC and FFFE that are in the image")
+  parser.add_argument("-n", "--name", default="recomp", help="prefix of the generated names; the table is <name>_blocks")
+  args= parser.parse_args()
+  if args.image.lower().endswith(".hex") :
+    num= load_hex(open(args.image).readlines())
+  elif args.image.lower().endswith((".srec",".s19",".s")) :
+    num= load_srec(open(args.image).readlines())
+  else :
+    data= open(args.image,"rb").read()
+    load_bytes(int(args.addr,16),data)
+    num= len(data)
+  if num==0 : sys.exit("ERROR: image is empty")
+  entries= [int(e,16) for e in args.entry]
+  if not entries :
+    entries= [word(v) for v in (0xFFFA,0xFFFC,0xFFFE) if loaded[v] and loaded[v+1]]
+  if not entries : sys.exit("ERROR: no entry points (vectors not in image, use --entry)")
+  print_cpp(args.image,entries,args.name)
+
+if __name__=="__main__" :
+  main()
@@ -9,7 +9,210 @@
 
 // Next address to assemble
 static uint16_t cmdasm_addr= 0x0200; // page 0 is zero-page, page 1 is stack
-static uint16_t cmdasm_addr_first;   // for the undo feature
+
+
+// Labels ("loop:" defines, "BNE loop" uses) for the streaming mode; the scope is one asm command.
+// A use of a label that is not yet defined is recorded as a fixup; the fixup is patched when the label is defined.
+#define CMDASM_LBL_NUM  16   // Max number of labels
+#define CMDASM_LBL_SIZE  8   // Max number of chars in a label
+#define CMDASM_LBL_NONE 0xFF // Label index for "no label"
+typedef struct cmdasm_lbl_s {
+  char     name[CMDASM_LBL_SIZE+1]; // Empty string for a free slot
+  bool     defined;                 // If false, the label is used, but not yet defined
+  uint16_t addr;                    // Value of the label (when defined)
+} cmdasm_lbl_t;
+static cmdasm_lbl_t cmdasm_lbl[CMDASM_LBL_NUM];
+
+#define CMDASM_FIX_NUM  16 // Max number of uses of undefined labels
+typedef struct cmdasm_fix_s {
+  uint16_t addr; // Address of the instruction that uses the label
+  uint8_t  lix;  // Index (in cmdasm_lbl) of the label
+  uint8_t  aix;  // Addressing mode of the instruction (determines REL, byte or word operand)
+} cmdasm_fix_t;
+static cmdasm_fix_t cmdasm_fix[CMDASM_FIX_NUM];
+static uint8_t cmdasm_fix_num;
+
+
+// Clears all labels and fixups
+static void cmdasm_lbl_clear(void) {
+  for( uint8_t lix=0; lix<CMDASM_LBL_NUM; lix++ ) cmdasm_lbl[lix].name[0]= '\0';
+  cmdasm_fix_num= 0;
+}
+
+
+// Returns true if `s` is a syntactically valid label name; not starting with a digit, and not a reserved word 
+// (a mnemonic, a register name or a hex lookalike like "dead").
+static bool cmdasm_lbl_valid(const char * s) {
+  if( *s=='\0' || strlen(s)>CMDASM_LBL_SIZE ) return false;
+  if( '0'<=*s && *s<='9' ) return false;
+  bool ishex= true;
+  for( const char * p=s; *p!='\0'; p++ ) {
+    char c= *p;
+    bool isdigit= '0'<=c && c<='9';
+    bool isalpha= ('a'<=c && c<='z') || ('A'<=c && c<='Z') || c=='_';
+    if( !isdigit && !isalpha ) return false;
+    ishex= ishex && ( isdigit || ('a'<=c && c<='f') || ('A'<=c && c<='F') );
+  }
+  if( ishex ) return false;
+  if( isa_instruction_find((char*)s) ) return false;
+  if( strcasecmp_P(s,PSTR("X"))==0 || strcasecmp_P(s,PSTR("Y"))==0 ) return false;
+  return true;
+}
+
+
+// Returns the index of label `name`; if absent, adds it (undefined). Returns CMDASM_LBL_NONE when the table is full.
+static uint8_t cmdasm_lbl_find(const char * name) {
+  uint8_t free= CMDASM_LBL_NONE;
+  for( uint8_t lix=0; lix<CMDASM_LBL_NUM; lix++ ) {
+    if( cmdasm_lbl[lix].name[0]=='\0' ) { if( free==CMDASM_LBL_NONE ) free= lix; continue; }
+    if( strcmp(cmdasm_lbl[lix].name,name)==0 ) return lix;
+  }
+  if( free!=CMDASM_LBL_NONE ) {
+    strcpy(cmdasm_lbl[free].name,name); // length was checked by cmdasm_lbl_valid()
+    cmdasm_lbl[free].defined= false;
+  }
+  return free;
+}
+
+
+// Patches the operand of the instruction at `addr` (with addressing mode `aix`) with the value of label `lix`.
+// Returns false (and prints an error) when the value does not fit the operand.
+static bool cmdasm_fix_patch(uint16_t addr, uint8_t aix, uint8_t lix) {
+  uint16_t val= cmdasm_lbl[lix].addr;
+  if( aix==ISA_AIX_REL ) {
+    val= val-(addr+2);
+    if( 0x7f<val && val<0xff80 ) { cmd_printf_P(PSTR("ERROR: label '%s' too far for branch at %04X\r\n"),cmdasm_lbl[lix].name,addr); return false; }
+    mem_write(addr+1, val&0xFF);
+  } else if( isa_addrmode_bytes(aix)==2 ) {
+    if( val>0xFF ) { cmd_printf_P(PSTR("ERROR: label '%s' does not fit byte operand at %04X\r\n"),cmdasm_lbl[lix].name,addr); return false; }
+    mem_write(addr+1, val&0xFF);
+  } else {
+    mem_write(addr+1, val&0xFF);
+    mem_write(addr+2, (val>>8)&0xFF);
+  }
+  return true;
+}
+
+
+// Records that the instruction at `addr` (with addressing mode `aix`) uses undefined label `lix`.
+// Returns false (and prints an error) when the fixup table is full.
+static bool cmdasm_fix_add(uint16_t addr, uint8_t aix, uint8_t lix) {
+  if( cmdasm_fix_num==CMDASM_FIX_NUM ) { cmd_printf_P(PSTR("ERROR: too many uses of undefined labels\r\n")); return false; }
+  cmdasm_fix[cmdasm_fix_num].addr= addr;
+  cmdasm_fix[cmdasm_fix_num].aix= aix;
+  cmdasm_fix[cmdasm_fix_num].lix= lix;
+  cmdasm_fix_num++;
+  return true;
+}
+
+
+// Removes the fixup for the instruction at `addr` (if any)
+static void cmdasm_fix_del(uint16_t addr) {
+  for( uint8_t fix=0; fix<cmdasm_fix_num; fix++ ) {
+    if( cmdasm_fix[fix].addr==addr ) { cmdasm_fix[fix]= cmdasm_fix[--cmdasm_fix_num]; return; }
+  }
+}
+
+
+// Defines label `name` at the current address, and patches all instructions waiting for it.
+// Returns false (and prints an error) if that fails.
+static bool cmdasm_lbl_define(const char * name) {
+  if( !cmdasm_lbl_valid(name) ) { cmd_printf_P(PSTR("ERROR: label '%s' must be an identifier (max %X chars), not a hex lookalike or reserved word\r\n"),name,CMDASM_LBL_SIZE); return false; }
+  uint8_t lix= cmdasm_lbl_find(name);
+  if( lix==CMDASM_LBL_NONE ) { cmd_printf_P(PSTR("ERROR: too many labels\r\n")); return false; }
+  if( cmdasm_lbl[lix].defined ) { cmd_printf_P(PSTR("ERROR: label '%s' already defined (%04X)\r\n"),name,cmdasm_lbl[lix].addr); return false; }
+  cmdasm_lbl[lix].defined= true;
+  cmdasm_lbl[lix].addr= cmdasm_addr;
+  // Patch the waiting instructions (iterate backwards, because the last one replaces the deleted)
+  for( int fix=cmdasm_fix_num-1; fix>=0; fix-- ) {
+    if( cmdasm_fix[fix].lix!=lix ) continue;
+    cmdasm_fix_patch(cmdasm_fix[fix].addr,cmdasm_fix[fix].aix,lix); // Error is printed, but fixup is dropped anyhow
+    cmdasm_fix[fix]= cmdasm_fix[--cmdasm_fix_num];
+  }
+  return true;
+}
+
+
+// Reports (and clears) all uses of labels that were never defined
+static void cmdasm_fix_report(void) {
+  for( uint8_t fix=0; fix<cmdasm_fix_num; fix++ ) {
+    cmd_printf_P(PSTR("WARNING: unresolved label '%s' at %04X\r\n"),cmdasm_lbl[cmdasm_fix[fix].lix].name,cmdasm_fix[fix].addr);
+  }
+  cmdasm_fix_num= 0;
+}
+
+
+// History of assembled instructions, for undo ('-') and redo ('+') in streaming mode.
+// Each entry records the bytes an instruction overwrote and the bytes it wrote, so both are O(1) and exact.
+#define CMDASM_HIST_NUM 16 // Number of entries in the history ring (power of two is good for the "mod")
+typedef struct cmdasm_hist_s {
+  uint16_t addr;    // Address of the instruction
+  uint8_t  len;     // Number of bytes of the instruction (1..3)
+  uint8_t  prev[3]; // Memory content before the instruction was assembled
+  uint8_t  next[3]; // Memory content after the instruction was assembled
+  uint8_t  lix;     // Label used by the instruction, that was undefined when assembled (or CMDASM_LBL_NONE)
+  uint8_t  aix;     // Addressing mode of the instruction (needed for the label fixup)
+} cmdasm_hist_t;
+static cmdasm_hist_t cmdasm_hist[CMDASM_HIST_NUM];
+static uint8_t cmdasm_hist_head; // Slot for the next entry
+static uint8_t cmdasm_hist_undo; // Number of entries (before head) that can be undone
+static uint8_t cmdasm_hist_redo; // Number of entries (from head) that can be redone
+
+
+// Clears the history (undo and redo)
+static void cmdasm_hist_clear(void) {
+  cmdasm_hist_undo= 0;
+  cmdasm_hist_redo= 0;
+}
+
+
+// Writes the `len` bytes `bytes` to memory at `addr`, and records that in the history (redo is lost).
+// The instruction has addressing mode `aix`, and `lix` is the undefined label it waits for (or CMDASM_LBL_NONE).
+static void cmdasm_hist_write(uint16_t addr, const uint8_t * bytes, uint8_t len, uint8_t aix, uint8_t lix) {
+  cmdasm_hist_t * h= &cmdasm_hist[cmdasm_hist_head];
+  h->addr= addr;
+  h->len= len;
+  h->aix= aix;
+  h->lix= lix;
+  for( uint8_t i=0; i<len; i++ ) {
+    h->prev[i]= mem_read(addr+i);
+    h->next[i]= bytes[i];
+    mem_write(addr+i, bytes[i]);
+  }
+  cmdasm_hist_head= (cmdasm_hist_head+1) % CMDASM_HIST_NUM;
+  if( cmdasm_hist_undo<CMDASM_HIST_NUM ) cmdasm_hist_undo++; // oldest entry is overwritten when full
+  cmdasm_hist_redo= 0;
+}
+
+
+// Undoes the last instruction (restores old bytes); returns false if there is nothing to undo
+static bool cmdasm_hist_undo_one(void) {
+  if( cmdasm_hist_undo==0 ) return false;
+  cmdasm_hist_head= (cmdasm_hist_head+CMDASM_HIST_NUM-1) % CMDASM_HIST_NUM;
+  cmdasm_hist_t * h= &cmdasm_hist[cmdasm_hist_head];
+  for( uint8_t i=0; i<h->len; i++ ) mem_write(h->addr+i, h->prev[i]);
+  if( h->lix!=CMDASM_LBL_NONE ) cmdasm_fix_del(h->addr); // Instruction no longer waits for its label
+  cmdasm_addr= h->addr;
+  cmdasm_hist_undo--;
+  cmdasm_hist_redo++;
+  return true;
+}
+
+
+// Redoes the last undone instruction (writes new bytes again); returns false if there is nothing to redo
+static bool cmdasm_hist_redo_one(void) {
+  if( cmdasm_hist_redo==0 ) return false;
+  cmdasm_hist_t * h= &cmdasm_hist[cmdasm_hist_head];
+  for( uint8_t i=0; i<h->len; i++ ) mem_write(h->addr+i, h->next[i]);
+  if( h->lix!=CMDASM_LBL_NONE ) { // Instruction waits (again) for its label, unless that got defined meanwhile
+    if( cmdasm_lbl[h->lix].defined ) cmdasm_fix_patch(h->addr,h->aix,h->lix); else cmdasm_fix_add(h->addr,h->aix,h->lix);
+  }
+  cmdasm_addr= h->addr+h->len;
+  cmdasm_hist_head= (cmdasm_hist_head+1) % CMDASM_HIST_NUM;
+  cmdasm_hist_undo++;
+  cmdasm_hist_redo--;
+  return true;
+}
 
 
 // This notification is called for an asm command; lowest changed address is passed.
@@ -23,55 +226,83 @@ static void cmdasm_notify(uint16_t addr) {
 }
 
 
+// Assembles one instruction (<mnemonic> [<operand>]) to `cmdasm_addr`
+static void cmdasm_inst( int argc, char * argv[] ) {
+  char buf[20];
+  // Get Mnemonic  
+  int iix= isa_instruction_find(argv[0]);
+  if( iix==0 ) { cmd_printf_P(PSTR("ERROR: unknown mnemonic '%s'\r\n"),argv[0]); return; }
+  // Parse operand syntax to find addressing mode
+  if( argc==1 ) buf[0]='\0'; else strncpy(buf, argv[1], sizeof buf );
+  int aix= isa_parse(buf);
+  if( aix==0 ) { cmd_printf_P(PSTR("ERROR: syntax error in operand '%s'\r\n"),buf); return; }
+  // We now have instruction type and addressing mode, does the combo map to an opcode?
+  bool rel_as_abs= isa_instruction_opcodes(iix,ISA_AIX_REL)!=ISA_OPCODE_INVALID && aix==ISA_AIX_ABS;
+  if( rel_as_abs ) aix=ISA_AIX_REL; // We accept ABS notation for REL-only instructions
+  uint8_t opcode= isa_instruction_opcodes(iix,aix);
+  if( opcode==ISA_OPCODE_INVALID ) { cmd_printf_P(PSTR("ERROR: instruction '%S' does not have addressing mode %S\r\n"),isa_instruction_iname(iix),isa_addrmode_aname(aix)); return; }
+  // Check operand size
+  uint16_t op= 0;
+  uint8_t lix= CMDASM_LBL_NONE; // Undefined label the instruction waits for
+  int bytes= isa_addrmode_bytes(aix);
+  if( bytes>1 ) { // todo: what is buf here?
+    if( cmd_parse(buf,&op) ) {
+      // `op` is the operand (a number) parsed from `buf`
+    } else if( cmdasm_lbl_valid(buf) ) {
+      uint8_t x= cmdasm_lbl_find(buf);
+      if( x==CMDASM_LBL_NONE ) { cmd_printf_P(PSTR("ERROR: too many labels\r\n")); return; }
+      if( cmdasm_lbl[x].defined ) {
+        op= cmdasm_lbl[x].addr;
+      } else if( cmd_get_streamfunc()==0 ) {
+        cmd_printf_P(PSTR("ERROR: undefined label '%s' (forward references need streaming mode)\r\n"),buf); return;
+      } else {
+        lix= x; // patched when the label gets defined
+      }
+    } else { 
+      cmd_printf_P(PSTR("ERROR: operand must be <hex> or <label>, not '%s'\r\n"),buf); return; 
+    }
+    if( lix!=CMDASM_LBL_NONE ) { 
+      // the placeholder 0 will be patched later
+    } else {
+      if( rel_as_abs ) { op= op-(cmdasm_addr+2); if( 0x7f<op && op<0xff80 ) { cmd_printf_P(PSTR("ERROR: ABS address too far (%X), need 80..7F\r\n"),op); return; } op&=0xFF; }
+      if( !rel_as_abs && bytes==2 && op>0xff ) { cmd_printf_P(PSTR("ERROR: operand must be 00..ff, not '%s'\r\n"),buf); return; }
+    }
+  }
+  // Check
+  if( argc>2 ) { cmd_printf_P(PSTR("ERROR: text after operand ('%s')\r\n"),argv[2]); return; }
+  if( lix!=CMDASM_LBL_NONE && !cmdasm_fix_add(cmdasm_addr,aix,lix) ) return;
+  // Now assemble
+  uint8_t code[3]= { opcode, (uint8_t)(op&0xFF), (uint8_t)((op>>8)&0xFF) };
+  cmdasm_hist_write(cmdasm_addr, code, bytes, aix, lix);
+  cmdasm_addr+= bytes;
+  // Print hints
+  if( lix!=CMDASM_LBL_NONE ) return; // operand not yet known
+  #define PAGE(a) (((a)>>8)&0xff)
+  if( aix==ISA_AIX_ABS && op<0x100 ) Serial.println(F("INFO: suggest ZPG instead of ABS (try - for undo)")); 
+  if( aix==ISA_AIX_ABX && op<0x100 ) Serial.println(F("INFO: suggest ZPX instead of ABX (try - for undo)")); 
+  if( aix==ISA_AIX_ABY && op<0x100 ) Serial.println(F("INFO: suggest ZPY instead of ABY (try - for undo)")); 
+  if( aix==ISA_AIX_REL && PAGE(cmdasm_addr+(int8_t)op)!=PAGE(cmdasm_addr) ) Serial.println(F("INFO: branch to other page takes 1 cycle extra (try - for undo)")); 
+}
+
+
 static void cmdasm_stream( int argc, char * argv[] ) {
   char buf[20];
   if( argc==0 ) { // no arguments toggles streaming mode
-    if( cmd_get_streamfunc()==0 ) cmd_set_streamfunc(cmdasm_stream); else cmd_set_streamfunc(0);
+    if( cmd_get_streamfunc()==0 ) cmd_set_streamfunc(cmdasm_stream); else { cmd_set_streamfunc(0); cmdasm_fix_report(); }
   }  else if( argc==1 && argv[0][0]=='-'&& argv[0][1]==0 ) {
-    // Recall that `cmddasm_addr` was set for first instruction, search for last
-    uint16_t addr= cmdasm_addr_first;
-    if( addr==cmdasm_addr ) { Serial.println(F("ERROR: can not undo")); return; }
-    while(1) {
-      uint8_t opcode= mem_read(addr);
-      uint8_t aix= isa_opcode_aix(opcode);
-      uint8_t bytes= isa_addrmode_bytes(aix);
-      if( addr+bytes == cmdasm_addr ) break;
-      addr+= bytes;
-    }
-    cmdasm_addr= addr;
+    if( !cmdasm_hist_undo_one() ) { Serial.println(F("ERROR: can not undo")); return; }
+  }  else if( argc==1 && argv[0][0]=='+'&& argv[0][1]==0 ) {
+    if( !cmdasm_hist_redo_one() ) { Serial.println(F("ERROR: can not redo")); return; }
   } else {
-    // Get Mnemonic  
-    int iix= isa_instruction_find(argv[0]);
-    if( iix==0 ) { cmd_printf_P(PSTR("ERROR: unknown mnemonic '%s'\r\n"),argv[0]); return; }
-    // Parse operand syntax to find addressing mode
-    if( argc==1 ) buf[0]='\0'; else strncpy(buf, argv[1], sizeof buf );
-    int aix= isa_parse(buf);
-    if( aix==0 ) { cmd_printf_P(PSTR("ERROR: syntax error in operand '%s'\r\n"),buf); return; }
-    // We now have instruction type and addressing mode, does the combo map to an opcode?
-    bool rel_as_abs= isa_instruction_opcodes(iix,ISA_AIX_REL)!=ISA_OPCODE_INVALID && aix==ISA_AIX_ABS;
-    if( rel_as_abs ) aix=ISA_AIX_REL; // We accept ABS notation for REL-only instructions
-    uint8_t opcode= isa_instruction_opcodes(iix,aix);
-    if( opcode==ISA_OPCODE_INVALID ) { cmd_printf_P(PSTR("ERROR: instruction '%S' does not have addressing mode %S\r\n"),isa_instruction_iname(iix),isa_addrmode_aname(aix)); return; }
-    // Check operand size
-    uint16_t op;
-    int bytes= isa_addrmode_bytes(aix);
-    if( bytes>1 ) { // todo: what is buf here?
-      if( !cmd_parse(buf,&op) ) { cmd_printf_P(PSTR("ERROR: operand must be <hex>, not '%s'\r\n"),buf); return; }
-      if( rel_as_abs ) { op= op-(cmdasm_addr+2); if( 0x7f<op && op<0xff80 ) { cmd_printf_P(PSTR("ERROR: ABS address too far (%X), need 80..7F\r\n"),op); return; } op&=0xFF; }
-      if( !rel_as_abs && bytes==2 && op>0xff ) { cmd_printf_P(PSTR("ERROR: operand must be 00..ff, not '%s'\r\n"),buf); return; }
+    // Optional label definition
+    int len= strlen(argv[0]);
+    if( argv[0][len-1]==':' ) {
+      argv[0][len-1]= '\0';
+      if( !cmdasm_lbl_define(argv[0]) ) return;
+      argc--; argv++; // remove '<label>:'
     }
-    // Check
-    if( argc>2 ) { cmd_printf_P(PSTR("ERROR: text after operand ('%s')\r\n"),argv[2]); return; }
-    // Now assemble
-    if( bytes>=1 ) { mem_write(cmdasm_addr++, opcode); }
-    if( bytes>=2 ) { mem_write(cmdasm_addr++, op&0xFF); }
-    if( bytes>=3 ) { mem_write(cmdasm_addr++, (op>>8)&0xFF); }
-    // Print hints
-    #define PAGE(a) (((a)>>8)&0xff)
-    if( aix==ISA_AIX_ABS && op<0x100 ) Serial.println(F("INFO: suggest ZPG instead of ABS (try - for undo)")); 
-    if( aix==ISA_AIX_ABX && op<0x100 ) Serial.println(F("INFO: suggest ZPX instead of ABX (try - for undo)")); 
-    if( aix==ISA_AIX_ABY && op<0x100 ) Serial.println(F("INFO: suggest ZPY instead of ABY (try - for undo)")); 
-    if( aix==ISA_AIX_REL && PAGE(cmdasm_addr+(int8_t)op)!=PAGE(cmdasm_addr) ) Serial.println(F("INFO: branch to other page takes 1 cycle extra (try - for undo)")); 
+    // Optional instruction
+    if( argc>0 ) cmdasm_inst(argc,argv);
   }
   // Set the streaming prompt (will only be shown in streaming mode)
   snprintf_P(buf,sizeof buf, PSTR("A:%04x> "),cmdasm_addr); cmd_set_streamprompt(buf);
@@ -93,7 +324,8 @@ static void cmdasm_main( int argc, char * argv[] ) {
     }
   }
   cmdasm_addr= addr;
-  cmdasm_addr_first= addr;
+  cmdasm_hist_clear();
+  cmdasm_lbl_clear();
   cmdasm_notify(addr); // Notify lowest changed address
   cmdasm_stream(argc,argv); // note that argc/argv have been moved
 }
@@ -106,10 +338,13 @@ static const char cmdasm_longhelp[] PROGMEM =
   "- streaming mode ends with an empty line\r\n"
   "- if <addr> is absent, continues with previous address\r\n"
   "NOTES:\r\n"
-  "- <inst> is <mnemonic> <operand>\r\n"
+  "- <inst> is [<label>:] <mnemonic> <operand>, or just <label>:\r\n"
   "- <mnemonic> is one of the 3 letter opcode abbreviations\r\n"
   "- <operand> syntax determines addressing mode\r\n"
-  "- in streaming mode '-' undoes previous instruction\r\n"
+  "- <operand> is <hex> or <label>; labels are known until the next asm command\r\n"
+  "- in streaming mode <label> may be defined later; unresolved ones are reported at end\r\n"
+  "- in streaming mode '-' undoes previous instruction (restoring the old bytes)\r\n"
+  "- in streaming mode '+' redoes the last undone instruction\r\n"
   "- <addr> is 0000..FFFF, but physical memory is limited and mirrored\r\n"
 ;
   
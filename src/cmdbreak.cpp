@@ -0,0 +1,69 @@
+// cmdbreak.cpp - command to set, clear and list breakpoints
+
+#include <Arduino.h>
+#include "cmd.h"
+#include "cpu.h"
+#include "cmdbreak.h"
+
+
+// Calls `func` for every breakpoint (only pages with a breakpoint are scanned); returns the number of breakpoints
+static uint16_t cmdbreak_each( void (*func)(uint16_t addr) ) {
+  uint16_t num= 0;
+  for( uint16_t page=0; page<256; page++ ) {
+    if( !(cpu_page_get(page) & CPU_PAGE_BREAK) ) continue;
+    for( uint16_t i=0; i<256; i++ ) {
+      uint16_t addr= (page<<8) | i;
+      if( cpu_break_get(addr) ) { func(addr); num++; }
+    }
+  }
+  return num;
+}
+
+
+static void cmdbreak_print(uint16_t addr) {
+  cmd_printf_P( PSTR("%04X\r\n"), addr);
+}
+
+
+static void cmdbreak_clr(uint16_t addr) {
+  cpu_break_set(addr,false);
+}
+
+
+// The handler for the "break" command
+static void cmdbreak_main( int argc, char * argv[] ) {
+  // break [ clr ] [ <addr> ]
+  if( argc==1 ) { 
+    if( cmdbreak_each(cmdbreak_print)==0 ) Serial.println(F("INFO: no breakpoints")); 
+    return; 
+  }
+  uint16_t addr;
+  bool clr= false;
+  // Note cmd_isprefix needs a PROGMEM string. PSTR stores a string in PROGMEM.
+  if( !cmd_parse(argv[1],&addr) && cmd_isprefix(PSTR("clr"),argv[1]) ) { 
+    clr= true; argc--; argv++; 
+    if( argc==1 ) { cmdbreak_each(cmdbreak_clr); return; }
+  }
+  if( !cmd_parse(argv[1],&addr) ) { cmd_printf_P(PSTR("ERROR: expected hex <addr>, not '%s'\r\n"),argv[1]); return; }
+  if( argc>2 ) { Serial.println(F("ERROR: too many arguments")); return; }
+  if( !cpu_break_set(addr,!clr) ) cmd_printf_P(PSTR("ERROR: too many breakpoints (max %X)\r\n"),CPU_BREAK_NUM);
+}
+
+
+static const char cmdbreak_longhelp[] PROGMEM = 
+  "SYNTAX: break\r\n"
+  "- lists all breakpoints\r\n"
+  "SYNTAX: break <addr>\r\n"
+  "- sets a breakpoint at <addr>\r\n"
+  "SYNTAX: break clr [ <addr> ]\r\n"
+  "- clears the breakpoint at <addr>, or all breakpoints\r\n"
+  "NOTES:\r\n"
+  "- execution stops before the instruction at a breakpoint\r\n"
+  "- 'clr' may be abbreviated to 'cl' ('c' is hex)\r\n"
+;
+
+  
+// Note cmd_register needs all strings to be PROGMEM strings. For the short string we do that inline with PSTR.
+void cmdbreak_register(void) {
+  cmd_register(cmdbreak_main, PSTR("break"), PSTR("set, clear or list breakpoints"), cmdbreak_longhelp);
+}
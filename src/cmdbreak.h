@@ -0,0 +1,10 @@
+// cmdbreak.h - command to set, clear and list breakpoints
+#ifndef __CMDBREAK_H__
+#define __CMDBREAK_H__
+
+
+// This module implements a command
+void cmdbreak_register(void);
+
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "isa.h"
+#include "cpu.h"
 #include "cmd.h"
 #include "cmddasm.h"
 
@@ -11,44 +12,70 @@
 uint16_t cmddasm_addr;  // Not static, set by write/asm
 
 
+// Prints the instruction with `opcode` and operand bytes `op1` and `op2` (if it has them), located at `addr`.
+// Prints to Serial, without a newline; returns the number of bytes of the instruction (0 on error).
+uint8_t cmddasm_print( uint16_t addr, uint8_t opcode, uint8_t op1, uint8_t op2 ) {
+  uint8_t iix= isa_opcode_iix(opcode);
+  uint8_t aix= isa_opcode_aix(opcode);
+  uint8_t bytes= isa_addrmode_bytes(aix);
+  // Prepare format
+  char opsB[7]; // binary rep (first 3 columns)
+  char opsT[5]; // text rep (last operand column)
+  if(      bytes==1 ) { snprintf_P(opsB,sizeof opsB,PSTR("     "));             *opsT=0;                                               }
+  else if( bytes==2 ) { snprintf_P(opsB,sizeof opsB,PSTR("%02X   "),op1);       snprintf_P(opsT,sizeof opsT,PSTR("%02X"),op1);         }
+  else if( bytes==3 ) { snprintf_P(opsB,sizeof opsB,PSTR("%02X %02X"),op1,op2); snprintf_P(opsT,sizeof opsT,PSTR("%02X%02X"),op2,op1); }
+  else { cmd_printf_P(PSTR("ERROR: this should not happen (wrong bytes %d)"),bytes); return 0; }
+  // Print binary columns
+  cmd_printf_P( PSTR("%04X %02X %s "), addr, opcode, opsB); 
+  // Print text columns 
+  if( iix>0 ) { // valid instructions
+    // Print opcode 
+    cmd_printf_P( PSTR("%S"), isa_instruction_iname(iix));
+    // Add syntax around opsT to match addressing mode
+    char buf[10];
+    int len= isa_snprint_op(buf,sizeof buf,aix,opsT);
+    // Print dressed up opsT (prepended with space)
+    if( len>0 ) cmd_printf_P( PSTR(" %s"), buf);
+    // add target addr for addressing mode REL 
+    if( aix==ISA_AIX_REL ) {
+      uint16_t target= addr+bytes+(int8_t)op1;
+      // int otherpage= (addr>>8) != (target>>8);
+      cmd_printf_P( PSTR(" (%04X)"), target );
+    }
+  } else { // invalid instructions
+    Serial.print(F("---")); 
+  }
+  return bytes;
+}
+
+
+// Prints the instruction located at `addr`, reading it from memory, without a newline. Bytes on an I/O page are not
+// read; they are printed as ?? and end the instruction. Returns the number of bytes shown.
+uint8_t cmddasm_print_mem( uint16_t addr ) {
+  if( cpu_page_get(addr>>8) & CPU_PAGE_IO ) { cmd_printf_P(PSTR("%04X ??"),addr); return 1; }
+  uint8_t opcode= mem_read(addr);
+  uint8_t bytes= isa_addrmode_bytes(isa_opcode_aix(opcode));
+  uint8_t ops[2]= {0,0};
+  for( uint8_t i=1; i<bytes; i++ ) {
+    uint16_t a= addr+i;
+    if( cpu_page_get(a>>8) & CPU_PAGE_IO ) { // operand crosses into an I/O page
+      cmd_printf_P(PSTR("%04X %02X "),addr,opcode);
+      if( i==2 ) cmd_printf_P(PSTR("%02X "),ops[0]);
+      Serial.print(F("??"));
+      return i;
+    }
+    ops[i-1]= mem_read(a);
+  }
+  return cmddasm_print(addr,opcode,ops[0],ops[1]);
+}
+
+
 // Disassembles 'num' instructions from memory, starting at 'addr'.
 // Prints all values to Serial.
 static void cmddasm_dasm( uint16_t addr, uint16_t num ) {
   while( num>0 ) {
-    // Get all data for the instruction
-    uint8_t opcode= mem_read(addr);
-    uint8_t iix= isa_opcode_iix(opcode);
-    uint8_t aix= isa_opcode_aix(opcode);
-    uint8_t bytes= isa_addrmode_bytes(aix);
-    uint8_t op1= mem_read(addr+1);
-    uint8_t op2= mem_read(addr+2);
-    // Prepare format
-    char opsB[7]; // binary rep (first 3 columns)
-    char opsT[5]; // text rep (last operand column)
-    if(      bytes==1 ) { snprintf_P(opsB,sizeof opsB,PSTR("     "));             *opsT=0;                                               }
-    else if( bytes==2 ) { snprintf_P(opsB,sizeof opsB,PSTR("%02X   "),op1);       snprintf_P(opsT,sizeof opsT,PSTR("%02X"),op1);         }
-    else if( bytes==3 ) { snprintf_P(opsB,sizeof opsB,PSTR("%02X %02X"),op1,op2); snprintf_P(opsT,sizeof opsT,PSTR("%02X%02X"),op2,op1); }
-    else { cmd_printf_P(PSTR("ERROR: this should not happen (wrong bytes %d)"),bytes); return; }
-    // Print binary columns
-    cmd_printf_P( PSTR("%04X %02X %s "), addr, opcode, opsB); 
-    // Print text columns 
-    if( iix>0 ) { // valid instructions
-      // Print opcode 
-      cmd_printf_P( PSTR("%S"), isa_instruction_iname(iix));
-      // Add syntax around opsT to match addressing mode
-      char buf[10];
-      int len= isa_snprint_op(buf,sizeof buf,aix,opsT);
-      // Print dressed up opsT (prepended with space)
-      if( len>0 ) cmd_printf_P( PSTR(" %s"), buf);
-      // add target addr for addressing mode REL 
-      if( aix==ISA_AIX_REL ) {
-        uint16_t target= addr+bytes+(int8_t)op1;
-        // int otherpage= (addr>>8) != (target>>8);
-        cmd_printf_P( PSTR(" (%04X)"), target );
-      }
-    } else { // invalid instructions
-      Serial.print(F("---")); 
-    }
+    uint8_t bytes= cmddasm_print_mem(addr);
+    if( bytes==0 ) return;
     Serial.println(); 
     num--; addr+= bytes;
   }
@@ -57,9 +84,23 @@ static void cmddasm_dasm( uint16_t addr, uint16_t num ) {
 
 
 #define CMDDASM_NUM 8 // also in help
+#define CMDDASM_SYNC 32 // Number of bytes inspected to find the first instruction boundary
+
+
+// Returns the address (addr, addr+1 or addr+2) where disassembly most likely starts at an instruction boundary.
+// Bytes on an I/O page are not read, they count as 00.
+static uint16_t cmddasm_resync( uint16_t addr ) {
+  uint8_t buf[CMDDASM_SYNC];
+  for( uint8_t i=0; i<CMDDASM_SYNC; i++ ) {
+    uint16_t a= addr+i;
+    buf[i]= cpu_page_get(a>>8) & CPU_PAGE_IO ? 0 : mem_read(a);
+  }
+  return addr + isa_scan_resync(buf,CMDDASM_SYNC);
+}
+
 // The handler for the "dasm" command
 static void cmddasm_main( int argc, char * argv[] ) {
-  // dasm [ <addr> [ <num> ] ]
+  // dasm [ <addr> [ <num> [ sync ] ] ]
   if( argc==1 ) { cmddasm_dasm(cmddasm_addr,CMDDASM_NUM); return; }
   // Parse addr
   uint16_t addr;
@@ -72,16 +113,25 @@ static void cmddasm_main( int argc, char * argv[] ) {
   uint16_t num;
   if( !cmd_parse(argv[2],&num) ) { cmd_printf_P(PSTR("ERROR: expected hex <num>, not '%s'\r\n"),argv[2]); return; }
   if( argc==3 ) { cmddasm_dasm(addr,num); return; }
+  // Parse sync
+  if( argc==4 && cmd_isprefix(PSTR("sync"),argv[3]) ) {
+    uint16_t start= cmddasm_resync(addr);
+    if( start!=addr ) cmd_printf_P(PSTR("INFO: skipped %X bytes to sync\r\n"),start-addr);
+    cmddasm_dasm(start,num); 
+    return; 
+  }
   Serial.println(F("ERROR: too many arguments"));
 }
 
 
 static const char cmddasm_longhelp[] PROGMEM = 
-  "SYNTAX: dasm [ <addr> [ <num> ] ]\r\n"
+  "SYNTAX: dasm [ <addr> [ <num> [ sync ] ] ]\r\n"
   "- disassembles <num> instructions from memory, starting at location <addr>\r\n"
   "- when <num> is absent, it defaults to 8\r\n"
+  "- with 'sync', first skips 0, 1 or 2 bytes to the most likely instruction start\r\n"
   "- when <addr> is absent or '-', it defaults to \"previous\" address\r\n"
   "- <addr> and <num> is 0000..FFFF, but physical memory is limited and mirrored\r\n"
+  "- bytes on an I/O page are not read (that could take a received byte), they show as ??\r\n"
 ;
   
  
@@ -11,6 +11,11 @@ extern void    mem_write(uint16_t addr, uint8_t data);
 
 // Next address to show; the default for the dasm command
 extern uint16_t cmddasm_addr; 
+// Prints one instruction (without newline), as the dasm command does; returns its number of bytes (also used for traces)
+uint8_t cmddasm_print(uint16_t addr, uint8_t opcode, uint8_t op1, uint8_t op2);
+// Prints the instruction at `addr` in memory, as cmddasm_print(); bytes on an I/O page (CPU_PAGE_IO, see cpu.h) are
+// not read, because a read may have a side effect (e.g. take a received byte), they print as ??
+uint8_t cmddasm_print_mem(uint16_t addr);
 // This module implements a command
 void cmddasm_register(void);
 
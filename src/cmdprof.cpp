@@ -0,0 +1,139 @@
+// cmdprof.cpp - command to control the profiler and show the hot addresses
+
+#include <Arduino.h>
+#include "cmd.h"
+#include "isa.h"
+#include "cpu.h"
+#include "cmdprof.h"
+
+
+#define CMDPROF_NUM  8 // Default number of addresses shown
+#define CMDPROF_MAX 16 // Max number of addresses shown
+
+
+void cmdprof_share(uint32_t part, uint32_t total) {
+  while( total>0x400000L ) { part>>=1; total>>=1; } // avoids overflow of part*1000
+  uint16_t permille= total==0 ? 0 : part*1000/total;
+  cmd_printf_P(PSTR("%3u.%u%%"), permille/10, permille%10);
+}
+
+
+// Shows the `num` buckets with the most cycles
+static void cmdprof_top(uint8_t num) {
+  uint16_t addrs[CMDPROF_MAX];
+  uint32_t counts[CMDPROF_MAX];
+  uint32_t cycles[CMDPROF_MAX];
+  uint8_t  found= 0;
+  uint32_t total= 0;
+  uint32_t count, cyc;
+  if( !cpu_prof_get(0,&count,&cyc) ) { Serial.println(F("INFO: no profile (use 'prof on')")); return; }
+  // One pass, keeping the best `num` sorted (insertion)
+  for( uint32_t a=0; a<0x10000L; a+=CPU_PROF_BUCKET ) {
+    cpu_prof_get(a,&count,&cyc);
+    total+= cyc;
+    if( cyc==0 ) continue;
+    if( found==num && cyc<=cycles[num-1] ) continue;
+    uint8_t i= found<num ? found++ : num-1;
+    while( i>0 && cycles[i-1]<cyc ) { addrs[i]= addrs[i-1]; counts[i]= counts[i-1]; cycles[i]= cycles[i-1]; i--; }
+    addrs[i]= a; counts[i]= count; cycles[i]= cyc;
+  }
+  if( found==0 ) { Serial.println(F("INFO: profile is empty")); return; }
+  Serial.println(F("addr count    cycles    share"));
+  for( uint8_t i=0; i<found; i++ ) {
+    cmd_printf_P(PSTR("%04X %08lX %08lX "), addrs[i], (unsigned long)counts[i], (unsigned long)cycles[i]);
+    cmdprof_share(cycles[i],total);
+    Serial.println();
+  }
+  cmd_printf_P(PSTR("total         %08lX\r\n"), (unsigned long)total);
+}
+
+
+// Prints the name of the instruction with `opcode`, with its addressing mode (e.g. LDA.IMM)
+static void cmdprof_opcode(uint8_t opcode) {
+  Serial.print(f(isa_instruction_iname(isa_opcode_iix(opcode))));
+  Serial.print('.');
+  Serial.print(f(isa_addrmode_aname(isa_opcode_aix(opcode))));
+}
+
+
+// Shows the CMDPROF_MAX pairs of opcodes that were executed in sequence most (input for 'isa6502.py cpp')
+static void cmdprof_pairs(void) {
+  uint16_t pairs[CMDPROF_MAX];
+  uint32_t counts[CMDPROF_MAX];
+  uint8_t  found= 0;
+  uint32_t total= 0;
+  uint32_t count;
+  if( !cpu_prof_pair(0,0,&count) ) {
+    if( CPU_PROF_PAIRS ) Serial.println(F("INFO: no profile (use 'prof on')")); else Serial.println(F("ERROR: no pair counts on this target"));
+    return;
+  }
+  // One pass, keeping the best CMDPROF_MAX sorted (insertion)
+  for( uint32_t pair=0; pair<0x10000L; pair++ ) {
+    cpu_prof_pair(pair>>8,pair&0xFF,&count);
+    total+= count;
+    if( count==0 ) continue;
+    if( found==CMDPROF_MAX && count<=counts[CMDPROF_MAX-1] ) continue;
+    uint8_t i= found<CMDPROF_MAX ? found++ : CMDPROF_MAX-1;
+    while( i>0 && counts[i-1]<count ) { pairs[i]= pairs[i-1]; counts[i]= counts[i-1]; i--; }
+    pairs[i]= pair; counts[i]= count;
+  }
+  if( found==0 ) { Serial.println(F("INFO: profile is empty")); return; }
+  Serial.println(F("pair  count    share  instructions"));
+  for( uint8_t i=0; i<found; i++ ) {
+    cmd_printf_P(PSTR("%02X %02X %08lX "), pairs[i]>>8, pairs[i]&0xFF, (unsigned long)counts[i]);
+    cmdprof_share(counts[i],total);
+    Serial.print(' ');
+    cmdprof_opcode(pairs[i]>>8);
+    Serial.print(' ');
+    cmdprof_opcode(pairs[i]&0xFF);
+    Serial.println();
+  }
+  cmd_printf_P(PSTR("total %08lX\r\n"), (unsigned long)total);
+}
+
+
+// The handler for the "prof" command
+static void cmdprof_main( int argc, char * argv[] ) {
+  // prof [ on | off | clr | pairs | <num> ]
+  if( argc>2 ) { Serial.println(F("ERROR: too many arguments")); return; }
+  uint16_t num= CMDPROF_NUM;
+  if( argc==2 ) {
+    // Note cmd_isprefix needs a PROGMEM string. PSTR stores a string in PROGMEM.
+    if( strcasecmp_P(argv[1],PSTR("on"))==0 ) {
+      if( !cpu_prof_start() ) Serial.println(F("ERROR: not enough memory for profile"));
+      return;
+    }
+    if( strcasecmp_P(argv[1],PSTR("off"))==0 ) { cpu_prof_stop(false); return; }
+    if( cmd_isprefix(PSTR("pairs"),argv[1]) ) { cmdprof_pairs(); return; }
+    if( !cmd_parse(argv[1],&num) && cmd_isprefix(PSTR("clr"),argv[1]) ) { cpu_prof_stop(true); return; }
+    if( !cmd_parse(argv[1],&num) ) { cmd_printf_P(PSTR("ERROR: expected on, off, clr, pairs or hex <num>, not '%s'\r\n"),argv[1]); return; }
+    if( num<1 || num>CMDPROF_MAX ) { cmd_printf_P(PSTR("ERROR: <num> must be 1..%X\r\n"),CMDPROF_MAX); return; }
+  }
+  cmdprof_top(num);
+}
+
+
+static const char cmdprof_longhelp[] PROGMEM = 
+  "SYNTAX: prof [ <num> ]\r\n"
+  "- shows the <num> addresses where most cycles were spent (default 8)\r\n"
+  "SYNTAX: prof on\r\n"
+  "- clears the profile and starts profiling\r\n"
+  "SYNTAX: prof off\r\n"
+  "- stops profiling (the profile is kept)\r\n"
+  "SYNTAX: prof clr\r\n"
+  "- stops profiling and frees the memory of the profile\r\n"
+  "SYNTAX: prof pairs\r\n"
+  "- shows the pairs of opcodes that were executed in sequence most\r\n"
+  "NOTES:\r\n"
+  "- counts and cycles are in hex, the share of all cycles in percent\r\n"
+  "- 'prog compile list prof' annotates the listing with the share per line\r\n"
+  "- 'isa6502.py cpp <file>' makes the fusion table of 'run' from 'prof pairs' output\r\n"
+  "- on AVR the profile is per page, and only one in 16 instructions is counted\r\n"
+  "- 'clr' may be abbreviated to 'cl' ('c' is hex)\r\n"
+;
+
+  
+// Note cmd_register needs all strings to be PROGMEM strings. For the short string we do that inline with PSTR.
+void cmdprof_register(void) {
+  cmd_register(cmdprof_main, PSTR("prof"), PSTR("profile execution, show hot addresses"), cmdprof_longhelp);
+}
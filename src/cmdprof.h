@@ -0,0 +1,17 @@
+// cmdprof.h - command to control the profiler and show the hot addresses
+#ifndef __CMDPROF_H__
+#define __CMDPROF_H__
+
+
+#include <stdint.h>
+
+
+// Prints `part` as a percentage of `total`, with one decimal (also used by 'prog compile list prof')
+void cmdprof_share(uint32_t part, uint32_t total);
+
+
+// This module implements a command
+void cmdprof_register(void);
+
+
+#endif
@@ -5,7 +5,9 @@
 #include <string.h>
 #include "isa.h"
 #include "cmd.h"
+#include "cpu.h"
 #include "cmdprog.h"
+#include "cmdprof.h"
 
 
 // todo: prog file [load name, save name, del name, dir]
@@ -673,7 +675,7 @@ static ln_t * ln_parse(int argc, char* argv[]) {
 void ln_del(ln_t * ln) {
   switch( ln->tag ) {
   case LN_TAG_COMMENT       : 
-    for( uint8_t i=0; i<sizeof(ln->cmt.cmt_fsxs); i++ ) fs_del(ln->cmt.cmt_fsxs[i]); 
+    for( uint8_t i=0; i<sizeof(ln->cmt.cmt_fsxs) && ln->cmt.cmt_fsxs[i]!=0; i++ ) fs_del(ln->cmt.cmt_fsxs[i]); // slots after the 0 are not in use
     return;
   case LN_TAG_PRAGMA_ORG    : 
     // skip
@@ -953,6 +955,7 @@ static void comp_compile_pass1( int * errors, int * warnings ) {
     if( ln->tag==LN_TAG_COMMENT ) {
       for( uint8_t i=0; i<sizeof(ln->cmt.cmt_fsxs); i++ ) {
         uint8_t fsx= ln->cmt.cmt_fsxs[i];
+        if( fsx==0 ) break; // slots after the 0 are not in use
         comp_fs_t * cfs= &comp_result.fs[fsx];
         cfs->flags= COMP_FLAGS_FSOTHER;
         cfs->lix= lix;
@@ -1152,7 +1155,6 @@ static void comp_compile_pass4( int * errors, int * warnings ) {
   for( uint16_t lix=0; lix<ln_num; lix++ ) {
     ln_t * ln= &ln_store[lix]; 
     if( ln->tag == LN_TAG_INST ) {
-      #define PAGE(a) (((a)>>8)&0xff)
       uint8_t opcode= ln->inst.opcode;
       uint8_t aix= isa_opcode_aix(opcode);
       uint16_t op = ( ln->inst.flags & LN_FLAG_OPisLBL ) ? comp_result.fs[comp_result.fs[ln->inst.op].defx].val : ln->inst.op ;
@@ -1163,19 +1165,21 @@ static void comp_compile_pass4( int * errors, int * warnings ) {
         if( ((dst_addr>src_addr)&&(dst_addr-src_addr>0x7f)) || ((dst_addr<src_addr)&&(src_addr-dst_addr>0x80)) ) {
           cmd_printf_P(PSTR("ERROR: branch to far on line %X\r\n"),lix); (*errors)++;
         } else {
-          if( PAGE(src_addr)!=PAGE(dst_addr) ) { cmd_printf_P(PSTR("WARNING: branch to other page on line %X has one clock tick penalty\r\n"),lix); (*warnings)++; }
+          if( isa_cycles_exact(opcode,src_addr-2,0,dst_addr,true)>isa_opcode_cycles(opcode)+1 ) { cmd_printf_P(PSTR("WARNING: branch to other page on line %X has one clock tick penalty\r\n"),lix); (*warnings)++; }
         } 
       }
       if( aix==ISA_AIX_REL && !(ln->inst.flags & LN_FLAG_ABSforREL) ) {
         // check if REL is to a different page: warning for extra clock tick
         uint16_t src_addr = comp_get_addr(lix)+2; 
         uint16_t dst_addr = src_addr+(int8_t)op;
-        if( PAGE(src_addr)!=PAGE(dst_addr) ) { cmd_printf_P(PSTR("WARNING: branch to other page on line %X has one clock tick penalty\r\n"),lix); (*warnings)++; }
+        if( isa_cycles_exact(opcode,src_addr-2,0,dst_addr,true)>isa_opcode_cycles(opcode)+1 ) { cmd_printf_P(PSTR("WARNING: branch to other page on line %X has one clock tick penalty\r\n"),lix); (*warnings)++; }
       }      
       if( aix==ISA_AIX_ABS && op<0x100 ) { cmd_printf_P(PSTR("WARNING: suggest ZPG instead of ABS on line %X\r\n"),lix); (*warnings)++; }
       if( aix==ISA_AIX_ABX && op<0x100 ) { cmd_printf_P(PSTR("WARNING: suggest ZPX instead of ABX on line %X\r\n"),lix); (*warnings)++; }
       if( aix==ISA_AIX_ABY && op<0x100 ) { cmd_printf_P(PSTR("WARNING: suggest ZPY instead of ABY on line %X\r\n"),lix); (*warnings)++; }
-      // todo: There is a sentence in the original 6502 datasheet, footnote 1 on page 6, eg for LDA 'ADD 1 TO "N" IF PAGE BOUNDARY IS CROSSED' do not yet understand
+      // Footnote 1 on page 6 of the datasheet, eg for LDA 'ADD 1 TO "N" IF PAGE BOUNDARY IS CROSSED', is about reading with ABX, ABY
+      // or ZIY: when adding the index crosses a page, the high byte of the address needs fixing. That depends on the index, so it is
+      // only known at run time (see isa_cycles_exact); 'prog compile list cycles' shows the range.
     }
   }
 }
@@ -1275,13 +1279,122 @@ static void comp_map( void ) {
 }
 
 
-static void comp_list( void ) {
+// Prints the profile column of the listing: the share of the cycles spent in the instruction at `addr`
+// (when `inst`, otherwise the column is blank); `total` is the total of the profile
+static void comp_list_share( bool inst, uint16_t addr, uint32_t total ) {
+  uint32_t count, cycles= 0;
+  if( inst ) cpu_prof_get(addr,&count,&cycles);
+  if( !inst || total==0 ) { Serial.print(F("|        ")); return; }
+  Serial.print(F("| "));
+  cmdprof_share(cycles,total);
+  Serial.print(' ');
+}
+
+
+// After compiling: returns the operand of the instruction on line `lix` (with a label replaced by its value);
+// for a branch it returns the target address
+static uint16_t comp_get_operand(uint16_t lix) {
+  ln_t * ln= &ln_store[lix]; 
+  uint16_t op = ( ln->inst.flags & LN_FLAG_OPisLBL ) ? comp_result.fs[comp_result.fs[ln->inst.op].defx].val : ln->inst.op ;
+  if( isa_opcode_aix(ln->inst.opcode)==ISA_AIX_REL && !(ln->inst.flags & LN_FLAG_ABSforREL) ) op= comp_get_addr(lix)+2+(int8_t)op;
+  return op;
+}
+
+// Returns true when the instruction on line `lix` ends a basic block (branch, jump, subroutine call, return or break)
+static bool comp_is_transfer(uint16_t lix) {
+  uint8_t opcode= ln_store[lix].inst.opcode;
+  uint8_t iix= isa_opcode_iix(opcode);
+  return isa_opcode_aix(opcode)==ISA_AIX_REL || iix==ISA_IIX_JMP || iix==ISA_IIX_JSR || iix==ISA_IIX_RTS || iix==ISA_IIX_RTI || iix==ISA_IIX_BRK;
+}
+
+// Returns true when some instruction branches, jumps or calls to `addr` (so a basic block starts there)
+static bool comp_is_target(uint16_t addr) {
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    ln_t * ln= &ln_store[lix]; 
+    if( ln->tag!=LN_TAG_INST ) continue;
+    uint8_t iix= isa_opcode_iix(ln->inst.opcode);
+    uint8_t aix= isa_opcode_aix(ln->inst.opcode);
+    if( aix==ISA_AIX_REL || (aix==ISA_AIX_ABS && (iix==ISA_IIX_JMP || iix==ISA_IIX_JSR)) ) {
+      if( comp_get_operand(lix)==addr ) return true;
+    }
+  }
+  return false;
+}
+
+// Gets the cycles of the instruction on line `lix`: `lo` is the minimum, `hi` the maximum. For a branch they are the cycles 
+// when not taken and when taken (the target is known, so whether it lands in another page is known). An indexed read (ABX, ABY) 
+// crosses a page for some index unless the base is at the start of a page; for ZIY the base is only known at run time.
+static void comp_get_cycles(uint16_t lix, uint8_t * lo, uint8_t * hi) {
+  uint8_t  opcode= ln_store[lix].inst.opcode;
+  uint16_t addr= comp_get_addr(lix);
+  uint16_t op= comp_get_operand(lix);
+  *lo= isa_cycles_exact(opcode,addr,0,0,false);
+  switch( isa_opcode_aix(opcode) ) {
+    case ISA_AIX_REL : *hi= isa_cycles_exact(opcode,addr,0,op,true); break;
+    case ISA_AIX_ABX : case ISA_AIX_ABY : *hi= isa_cycles_exact(opcode,addr,op,op+0xFF,false); break;
+    case ISA_AIX_ZIY : *hi= isa_cycles_exact(opcode,addr,0x00FF,0x0100,false); break;
+    default          : *hi= *lo; break;
+  }
+}
+
+// Prints the cycles column of the listing (in hex): `lo` and `hi` (as computed by comp_get_cycles, or summed), `sep` separates them
+// ('/' for the alternatives of a branch, '-' for a range); when `lo` is 0 the column is blank
+static void comp_list_cycles( uint16_t lo, uint16_t hi, char sep ) {
+  char buf[12];
+  if( lo==0 ) buf[0]= '\0';
+  else if( lo==hi ) snprintf_P(buf,sizeof buf,PSTR("%X"),lo);
+  else snprintf_P(buf,sizeof buf,PSTR("%X%c%X"),lo,sep,hi);
+  cmd_printf_P(PSTR("| %-6s "),buf);
+}
+
+// The basic block being listed: its first and last address, its last instruction, and its cycles (minimum and maximum)
+static uint16_t comp_block_lix; // line of the last instruction, 0xFFFF when no block is open
+static uint16_t comp_block_addr;
+static uint16_t comp_block_end;
+static uint16_t comp_block_lo;
+static uint16_t comp_block_hi;
+
+// Prints the totals of the open basic block (if any) and closes it. When the block ends with a branch back to its start 
+// (a simple loop, e.g. DEX and BNE), the cycles of one iteration are printed too (the branch is then always taken).
+static void comp_list_block( bool prof ) {
+  if( comp_block_lix==0xFFFF ) return;
+  Serial.print(F("     |             ")); 
+  if( prof ) comp_list_share(false,0,0);
+  comp_list_cycles(comp_block_lo,comp_block_hi,'-');
+  cmd_printf_P(PSTR("| block %04X-%04X\r\n"),comp_block_addr,comp_block_end);
+  uint16_t lix= comp_block_lix;
+  if( isa_opcode_aix(ln_store[lix].inst.opcode)==ISA_AIX_REL && comp_get_operand(lix)==comp_block_addr ) {
+    uint8_t lo, hi;
+    comp_get_cycles(lix,&lo,&hi);
+    Serial.print(F("     |             ")); 
+    if( prof ) comp_list_share(false,0,0);
+    comp_list_cycles(comp_block_lo-lo+hi,comp_block_hi,'-');
+    cmd_printf_P(PSTR("| loop %04X-%04X per iteration\r\n"),comp_block_addr,comp_block_end);
+  }
+  comp_block_lix= 0xFFFF;
+}
+
+// Lists the compiled program; when `prof`, each instruction is annotated with its share of the profiled cycles;
+// when `cycles`, each instruction is annotated with its cycles, and each basic block with its total
+static void comp_list( bool prof, bool cycles ) {
   uint8_t oix= 0;
   char buf[40]; 
+  uint32_t total= 0;
+  comp_block_lix= 0xFFFF;
+  if( prof ) {
+    uint32_t count, sum;
+    for( uint32_t a=0; a<0x10000L; a+=CPU_PROF_BUCKET ) { cpu_prof_get(a,&count,&sum); total+= sum; }
+  }
   Serial.println();
   for(uint16_t lix=0; lix<ln_num; lix++) {
     if( oix+1<comp_result.org_num && comp_result.org[oix+1].lix==lix ) { // A new .ORG section
-      if( comp_result.org[oix].addr1!=comp_result.org[oix].addr2 ) cmd_printf_P(PSTR("%04X |             | section %X end\r\n"),comp_result.org[oix].addr2, oix); 
+      if( cycles ) comp_list_block(prof);
+      if( comp_result.org[oix].addr1!=comp_result.org[oix].addr2 ) {
+        cmd_printf_P(PSTR("%04X |             "),comp_result.org[oix].addr2); 
+        if( prof ) comp_list_share(false,0,0);
+        if( cycles ) comp_list_cycles(0,0,0);
+        cmd_printf_P(PSTR("| section %X end\r\n"),oix); 
+      }
       oix++;
     }
     ln_t * ln= &ln_store[lix]; 
@@ -1289,6 +1402,8 @@ static void comp_list( void ) {
     uint16_t addr= comp_get_addr(lix);
     uint8_t bix=0; // num bytes already printed
     uint8_t len= comp_get_numbytes(lix); // bytes to print
+    // A basic block ends before data, and before an instruction that is jumped to
+    if( cycles && len>0 && ( ln->tag!=LN_TAG_INST || comp_is_target(addr) ) ) comp_list_block(prof);
     if( len==0 ) {    
       Serial.print(F("     |             ")); 
     } else { 
@@ -1299,6 +1414,17 @@ static void comp_list( void ) {
       }
       for(int i=len; i<4; i++ ) Serial.print(F("   "));
     }
+    if( prof ) comp_list_share(ln->tag==LN_TAG_INST,addr,total);
+    uint8_t lo= 0, hi= 0;
+    if( cycles && ln->tag==LN_TAG_INST ) {
+      comp_get_cycles(lix,&lo,&hi);
+      if( comp_block_lix==0xFFFF ) { comp_block_addr= addr; comp_block_lo= 0; comp_block_hi= 0; }
+      comp_block_lix= lix;
+      comp_block_end= addr+len-1;
+      comp_block_lo+= lo;
+      comp_block_hi+= hi;
+    }
+    if( cycles ) comp_list_cycles(lo,hi,lo && isa_opcode_aix(ln->inst.opcode)==ISA_AIX_REL ? '/' : '-');
     // Print line
     ln_snprint(buf,40,ln);
     cmd_printf_P(PSTR("| %03X %s\r\n"),lix,buf); // END-OF_LINE
@@ -1310,15 +1436,28 @@ static void comp_list( void ) {
         bix++;
       }
       for(int i=len; i<8; i++ ) Serial.print(F("   "));
+      if( prof ) comp_list_share(false,0,0);
+      if( cycles ) comp_list_cycles(0,0,0);
       cmd_printf_P(PSTR("| more bytes\r\n")); 
     } 
+    if( cycles && ln->tag==LN_TAG_INST && comp_is_transfer(lix) ) comp_list_block(prof);
   }
+  if( cycles ) comp_list_block(prof);
   // print final .ORG section end
-  cmd_printf_P(PSTR("%04X |             | section %X end\r\n"),comp_result.org[oix].addr2, oix);
+  cmd_printf_P(PSTR("%04X |             "),comp_result.org[oix].addr2);
+  if( prof ) comp_list_share(false,0,0);
+  if( cycles ) comp_list_cycles(0,0,0);
+  cmd_printf_P(PSTR("| section %X end\r\n"),oix);
   // Vector?
   if( comp_result.add_reset_vector ) {
-    cmd_printf_P(PSTR("FFFC | 00 02       | implicit section with reset vector\r\n")); 
-    cmd_printf_P(PSTR("FFFD |             | section end\r\n")); 
+    cmd_printf_P(PSTR("FFFC | 00 02       ")); 
+    if( prof ) comp_list_share(false,0,0);
+    if( cycles ) comp_list_cycles(0,0,0);
+    cmd_printf_P(PSTR("| implicit section with reset vector\r\n")); 
+    cmd_printf_P(PSTR("FFFD |             ")); 
+    if( prof ) comp_list_share(false,0,0);
+    if( cycles ) comp_list_cycles(0,0,0);
+    cmd_printf_P(PSTR("| section end\r\n")); 
   }
 }
 
@@ -1348,6 +1487,64 @@ static void comp_bin( void ) {
   }
 }
 
+// Records for `comp_hex` are collected in a buffer; it is flushed when full, or when the next byte is not adjacent
+#define COMP_REC_SIZE 16 // Max data bytes per record
+static uint8_t  comp_rec_buf[COMP_REC_SIZE];
+static uint8_t  comp_rec_len;
+static uint16_t comp_rec_addr;
+static bool     comp_rec_srec; // Intel HEX or Motorola S-record
+
+// Prints the buffered bytes as one data record (if any)
+static void comp_rec_flush( void ) {
+  if( comp_rec_len==0 ) return;
+  uint8_t sum;
+  if( comp_rec_srec ) {
+    sum= comp_rec_len+3; // count includes address and checksum
+    cmd_printf_P(PSTR("S1%02X%04X"),sum,comp_rec_addr);
+  } else {
+    sum= comp_rec_len; // type 00 does not contribute
+    cmd_printf_P(PSTR(":%02X%04X00"),sum,comp_rec_addr);
+  }
+  sum+= (comp_rec_addr>>8) + (comp_rec_addr&0xFF);
+  for( uint8_t i=0; i<comp_rec_len; i++ ) { cmd_printf_P(PSTR("%02X"),comp_rec_buf[i]); sum+= comp_rec_buf[i]; }
+  cmd_printf_P(PSTR("%02X\r\n"),(uint8_t)(comp_rec_srec ? ~sum : -sum));
+  comp_rec_len= 0;
+}
+
+// Adds byte `data` for address `addr` to the record buffer
+static void comp_rec_add( uint16_t addr, uint8_t data ) {
+  if( comp_rec_len==COMP_REC_SIZE || (comp_rec_len>0 && addr!=(uint16_t)(comp_rec_addr+comp_rec_len)) ) comp_rec_flush();
+  if( comp_rec_len==0 ) comp_rec_addr= addr;
+  comp_rec_buf[comp_rec_len++]= data;
+}
+
+// Prints the compiled program as Intel HEX (`srec` false) or Motorola S-records (`srec` true).
+// Records are streamed per line of code; each .ORG section starts a new record.
+static void comp_hex( bool srec ) {
+  uint8_t oix= 0;
+  comp_rec_srec= srec;
+  comp_rec_len= 0;
+  Serial.println();
+  for(uint16_t lix=0; lix<ln_num; lix++) {
+    if( oix+1<comp_result.org_num && comp_result.org[oix+1].lix==lix ) { // A new .ORG section
+      comp_rec_flush();
+      oix++; 
+    }
+    uint8_t len= comp_get_numbytes(lix); 
+    uint16_t addr= comp_get_addr(lix);
+    for( uint8_t bix=0; bix<len; bix++ ) comp_rec_add(addr+bix,comp_get_byte(lix,bix));
+  }
+  comp_rec_flush();
+  // Vector?
+  if( comp_result.add_reset_vector ) {
+    comp_rec_add(0xFFFC,0x00);
+    comp_rec_add(0xFFFD,0x02);
+    comp_rec_flush();
+  }
+  // End record
+  if( srec ) cmd_printf_P(PSTR("S9030000FC\r\n")); else cmd_printf_P(PSTR(":00000001FF\r\n"));
+}
+
 static void comp_install( void ) {
   int count=0;
   for(uint16_t lix=0; lix<ln_num; lix++) {
@@ -1367,6 +1564,263 @@ static void comp_install( void ) {
 }
 
 
+// ==========================================================================
+// Worst case execution time
+// ==========================================================================
+
+// After compiling, the control flow graph follows from ln_store: the successors of an instruction are the next instruction
+// and/or the target of its branch or jump. The analysis assumes structured code: a branch or jump back (to the same or an
+// earlier line) closes a loop, which runs from that target (the head) up to the last line that jumps back to it (the latch).
+// A loop must be entered at its head, and needs a bound: either a comment '; loop <num>' on the line just before the head,
+// or LDX #<num> before the head with DEX and BNE at the end (or the same with Y) and no other writes to that register.
+#define WCET_NONE 0xFFFF       // No line
+#define WCET_INF  0xFFFFFFFFUL // Unbounded (or not yet known)
+
+// For each line, the worst case cycles from that line until the path leaves the region being analysed (see wcet_region).
+// Only allocated during wcet_analyse(), so that the analysis costs no RAM the rest of the time.
+static uint32_t * wcet_d;
+
+static uint32_t wcet_add(uint32_t a, uint32_t b) {
+  return a>WCET_INF-b ? WCET_INF : a+b;
+}
+
+static uint32_t wcet_mul(uint32_t n, uint32_t a) {
+  return a!=0 && n>WCET_INF/a ? WCET_INF : n*a;
+}
+
+static uint32_t wcet_max(uint32_t a, uint32_t b) {
+  return a>b ? a : b;
+}
+
+// Returns the line with the instruction at `addr`, WCET_NONE if there is none
+static uint16_t wcet_line(uint16_t addr) {
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    if( ln_store[lix].tag==LN_TAG_INST && comp_get_addr(lix)==addr ) return lix;
+  }
+  return WCET_NONE;
+}
+
+// Returns true when line `lix` generates no code and does not change the address (so the code flows over it)
+static bool wcet_skip(uint16_t lix) {
+  uint8_t tag= ln_store[lix].tag;
+  return tag==LN_TAG_COMMENT || tag==LN_TAG_PRAGMA_EB || tag==LN_TAG_PRAGMA_EW;
+}
+
+// Returns the line with the instruction after the one on line `lix`, WCET_NONE when data or a new section follows
+static uint16_t wcet_next(uint16_t lix) {
+  for( lix++; lix<ln_num && wcet_skip(lix); lix++ ) ;
+  return lix<ln_num && ln_store[lix].tag==LN_TAG_INST ? lix : WCET_NONE;
+}
+
+// Returns the line with the instruction before the one on line `lix`, WCET_NONE when there is none
+static uint16_t wcet_prev(uint16_t lix) {
+  while( lix>0 && wcet_skip(lix-1) ) lix--;
+  return lix>0 && ln_store[lix-1].tag==LN_TAG_INST ? lix-1 : WCET_NONE;
+}
+
+// Fills `succ` with the successors of the instruction on line `lix`, and `extra` with the cycles of taking that edge on top of
+// wcet_cost (for a taken branch). Returns the number of successors; a successor WCET_NONE is unknown (e.g. for JMP (ind)).
+// RTS and RTI have none; neither has BRK, it enters the IRQ handler, which is analysed as a routine of its own.
+static uint8_t wcet_succs(uint16_t lix, uint16_t succ[2], uint8_t extra[2]) {
+  uint8_t opcode= ln_store[lix].inst.opcode;
+  uint8_t iix= isa_opcode_iix(opcode);
+  uint8_t aix= isa_opcode_aix(opcode);
+  extra[0]= 0;
+  extra[1]= 0;
+  if( iix==ISA_IIX_RTS || iix==ISA_IIX_RTI || iix==ISA_IIX_BRK ) return 0;
+  if( iix==ISA_IIX_JMP ) { succ[0]= aix==ISA_AIX_ABS ? wcet_line(comp_get_operand(lix)) : WCET_NONE; return 1; }
+  succ[0]= wcet_next(lix);
+  if( aix!=ISA_AIX_REL ) return 1;
+  uint8_t lo, hi;
+  comp_get_cycles(lix,&lo,&hi);
+  succ[1]= wcet_line(comp_get_operand(lix));
+  extra[1]= hi-lo;
+  return 2;
+}
+
+// Returns the worst case cycles of the instruction on line `lix`, including the subroutine it calls (a branch counts as not taken)
+static uint32_t wcet_cost(uint16_t lix) {
+  uint8_t lo, hi;
+  comp_get_cycles(lix,&lo,&hi);
+  uint8_t opcode= ln_store[lix].inst.opcode;
+  if( isa_opcode_aix(opcode)==ISA_AIX_REL ) return lo;
+  if( isa_opcode_iix(opcode)==ISA_IIX_JSR ) {
+    uint16_t sub= wcet_line(comp_get_operand(lix));
+    return sub==WCET_NONE ? WCET_INF : wcet_add(hi,wcet_d[sub]);
+  }
+  return hi;
+}
+
+// Returns the last line that branches or jumps back to line `head`, WCET_NONE if there is none (so `head` is no loop head)
+static uint16_t wcet_latch(uint16_t head) {
+  uint16_t latch= WCET_NONE;
+  for( uint16_t lix=head; lix<ln_num; lix++ ) {
+    if( ln_store[lix].tag!=LN_TAG_INST ) continue;
+    uint16_t succ[2]; uint8_t extra[2];
+    uint8_t num= wcet_succs(lix,succ,extra);
+    for( uint8_t k=0; k<num; k++ ) if( succ[k]==head ) latch= lix;
+  }
+  return latch;
+}
+
+// Returns true when some instruction outside the loop `head`..`latch` branches or jumps into it, other than to the head
+static bool wcet_entered(uint16_t head, uint16_t latch) {
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    if( ln_store[lix].tag!=LN_TAG_INST || (head<=lix && lix<=latch) ) continue;
+    uint16_t succ[2]; uint8_t extra[2];
+    uint8_t num= wcet_succs(lix,succ,extra);
+    for( uint8_t k=0; k<num; k++ ) if( succ[k]!=WCET_NONE && head<succ[k] && succ[k]<=latch ) return true;
+  }
+  return false;
+}
+
+// Returns true when instruction `iix` writes X (when `x`) or Y (when not `x`)
+static bool wcet_writes(uint8_t iix, bool x) {
+  if( x ) return iix==ISA_IIX_LDX || iix==ISA_IIX_TAX || iix==ISA_IIX_TSX || iix==ISA_IIX_INX || iix==ISA_IIX_DEX;
+  return iix==ISA_IIX_LDY || iix==ISA_IIX_TAY || iix==ISA_IIX_INY || iix==ISA_IIX_DEY;
+}
+
+// Returns the maximum number of iterations of the loop `head`..`latch`, 0 when it has no bound
+static uint32_t wcet_bound(uint16_t head, uint16_t latch) {
+  // A comment '; loop <num>' on the line just before the head
+  if( head>0 && ln_store[head-1].tag==LN_TAG_COMMENT ) {
+    char buf[40];
+    uint16_t num;
+    ln_snprint(buf,40,&ln_store[head-1]);
+    if( strncmp_P(buf,PSTR("; loop "),7)==0 && cmd_parse(buf+7,&num) ) return num;
+  }
+  // The latch is BNE after DEX (or DEY), and that is the only write to X (or Y) and the only branch back in the loop
+  uint16_t dec= wcet_prev(latch);
+  if( ln_store[latch].inst.opcode!=0xD0 || dec==WCET_NONE || dec<head ) return 0; // D0 is BNE
+  uint8_t iix= isa_opcode_iix(ln_store[dec].inst.opcode);
+  if( iix!=ISA_IIX_DEX && iix!=ISA_IIX_DEY ) return 0;
+  bool x= iix==ISA_IIX_DEX;
+  for( uint16_t lix=head; lix<dec; lix++ ) {
+    if( ln_store[lix].tag!=LN_TAG_INST ) continue;
+    uint16_t succ[2]; uint8_t extra[2];
+    uint8_t num= wcet_succs(lix,succ,extra);
+    for( uint8_t k=0; k<num; k++ ) if( succ[k]==head ) return 0;
+    iix= isa_opcode_iix(ln_store[lix].inst.opcode);
+    if( wcet_writes(iix,x) || iix==ISA_IIX_JSR ) return 0; // A subroutine might write the register
+  }
+  // Walking back from the head over straight code, LDX #<num> (or LDY) sets the count; 0 means 256 iterations
+  for( uint16_t lix=wcet_prev(head); lix!=WCET_NONE && !comp_is_transfer(lix); lix=wcet_prev(lix) ) {
+    uint8_t opcode= ln_store[lix].inst.opcode;
+    if( opcode==(x?0xA2:0xA0) ) { uint8_t num= comp_get_operand(lix); return num==0 ? 256 : num; } // A2 is LDX #, A0 is LDY #
+    if( wcet_writes(isa_opcode_iix(opcode),x) || comp_is_target(comp_get_addr(lix)) ) return 0;
+  }
+  return 0;
+}
+
+// Computes wcet_d[] for the lines `lo`..`hi`, backwards, so the successors further down are known. A path ends when it leaves 
+// the region, branches back, or returns. A loop inside the region is one step: its bound times its worst iteration, plus its 
+// worst exit. When `loop`, the region is the loop with head `lo`, so wcet_d[lo] becomes the worst case of one iteration.
+static void wcet_region(uint16_t lo, uint16_t hi, bool loop) {
+  for( uint16_t lix=hi+1; lix-- > lo; ) {
+    if( ln_store[lix].tag!=LN_TAG_INST ) continue;
+    uint16_t succ[2]; uint8_t extra[2];
+    uint16_t latch= loop && lix==lo ? WCET_NONE : wcet_latch(lix);
+    if( latch!=WCET_NONE ) {
+      // The exits of the loop go to lines after the loop (known), or back to an enclosing loop
+      uint32_t exits= 0;
+      for( uint16_t w=lix; w<=latch; w++ ) {
+        if( ln_store[w].tag!=LN_TAG_INST ) continue;
+        uint8_t num= wcet_succs(w,succ,extra);
+        for( uint8_t k=0; k<num; k++ ) {
+          if( succ[k]==WCET_NONE ) exits= WCET_INF;
+          else if( succ[k]>latch ) exits= wcet_max(exits, wcet_add(extra[k], succ[k]<=hi ? wcet_d[succ[k]] : 0));
+          else if( succ[k]<lix ) exits= wcet_max(exits, extra[k]);
+        }
+      }
+      uint32_t bound= latch<=hi && !wcet_entered(lix,latch) ? wcet_bound(lix,latch) : 0;
+      wcet_region(lix,latch,true);
+      wcet_d[lix]= bound>0 ? wcet_add(wcet_mul(bound,wcet_d[lix]),exits) : WCET_INF;
+    } else {
+      uint32_t worst= 0;
+      uint8_t num= wcet_succs(lix,succ,extra);
+      for( uint8_t k=0; k<num; k++ ) {
+        if( succ[k]==WCET_NONE ) worst= WCET_INF;
+        else if( lix<succ[k] && succ[k]<=hi ) worst= wcet_max(worst, wcet_add(extra[k],wcet_d[succ[k]]));
+        else worst= wcet_max(worst, extra[k]); // Leaves the region, or ends an iteration
+      }
+      wcet_d[lix]= wcet_add(wcet_cost(lix),worst);
+    }
+  }
+}
+
+// After compiling: gets in `val` the word at `addr` (e.g. the IRQ vector at FFFE); returns false when the program does not set it
+static bool wcet_vector(uint16_t addr, uint16_t * val) {
+  uint8_t found= 0;
+  *val= 0;
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    uint8_t len= comp_get_numbytes(lix);
+    for( uint8_t bix=0; bix<len; bix++ ) {
+      uint16_t a= comp_get_addr(lix)+bix;
+      if( a==addr   ) { *val|= comp_get_byte(lix,bix);    found|= 1; }
+      if( a==addr+1 ) { *val|= comp_get_byte(lix,bix)<<8; found|= 2; }
+    }
+  }
+  return found==3;
+}
+
+// Prints the worst case cycles of the routine at `addr` of kind `kind`; warns when it exceeds `budget` (if not 0)
+static void wcet_print(uint16_t addr, const char * kind, uint16_t budget, int * warnings) {
+  uint16_t lix= wcet_line(addr);
+  uint32_t cycles= lix==WCET_NONE ? WCET_INF : wcet_d[lix];
+  if( lix==WCET_NONE ) cmd_printf_P(PSTR(" %04X (ln ---) %-5S "),addr,kind); else cmd_printf_P(PSTR(" %04X (ln %03X) %-5S "),addr,lix,kind);
+  if( cycles==WCET_INF ) Serial.println(F("unbounded")); else cmd_printf_P(PSTR("%lX\r\n"),(unsigned long)cycles);
+  if( budget>0 && cycles>budget ) { cmd_printf_P(PSTR("WARNING: %S handler at %04X exceeds budget %X\r\n"),kind,addr,budget); (*warnings)++; }
+}
+
+// Prints the worst case cycles of the reset, NMI and IRQ handlers and of each subroutine; warns for loops without a bound, 
+// and for an NMI or IRQ handler that exceeds `budget` cycles (if not 0). The cycles start at the first instruction of the
+// routine, and include its RTS or RTI (but not the 7 cycles of the interrupt itself, nor the JSR).
+static void wcet_analyse( uint16_t budget ) {
+  int warnings= 0;
+  if( ln_num==0 ) return;
+  wcet_d= (uint32_t *)malloc(ln_num*sizeof(uint32_t));
+  if( wcet_d==0 ) { Serial.println(F("ERROR: not enough memory for analysis")); return; }
+  // A call to an earlier line uses the result of the previous round, so a chain of such calls needs a round each
+  uint16_t rounds= 1;
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    wcet_d[lix]= WCET_INF;
+    ln_t * ln= &ln_store[lix]; 
+    if( ln->tag==LN_TAG_INST && isa_opcode_iix(ln->inst.opcode)==ISA_IIX_JSR && wcet_line(comp_get_operand(lix))<=lix ) rounds++;
+  }
+  while( rounds-- > 0 ) wcet_region(0,ln_num-1,false);
+  // Loops without a bound
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    if( ln_store[lix].tag!=LN_TAG_INST ) continue;
+    uint16_t latch= wcet_latch(lix);
+    if( latch==WCET_NONE ) continue;
+    if( wcet_entered(lix,latch) ) { cmd_printf_P(PSTR("WARNING: loop on line %X is entered in the middle\r\n"),lix); warnings++; }
+    else if( wcet_bound(lix,latch)==0 ) { cmd_printf_P(PSTR("WARNING: loop on line %X has no bound (add '; loop <num>' before it)\r\n"),lix); warnings++; }
+  }
+  // The routines
+  Serial.println();
+  cmd_printf_P(PSTR("routines: addr (ln ln#) kind cycles\r\n")); 
+  uint16_t addr;
+  if( comp_result.add_reset_vector ) wcet_print(0x0200,PSTR("reset"),0,&warnings);
+  else if( wcet_vector(0xFFFC,&addr) ) wcet_print(addr,PSTR("reset"),0,&warnings);
+  if( wcet_vector(0xFFFA,&addr) ) wcet_print(addr,PSTR("nmi"),budget,&warnings);
+  if( wcet_vector(0xFFFE,&addr) ) wcet_print(addr,PSTR("irq"),budget,&warnings);
+  for( uint16_t lix=0; lix<ln_num; lix++ ) {
+    ln_t * ln= &ln_store[lix]; 
+    if( ln->tag!=LN_TAG_INST || isa_opcode_iix(ln->inst.opcode)!=ISA_IIX_JSR ) continue;
+    addr= comp_get_operand(lix);
+    bool first= true; // Print each subroutine once
+    for( uint16_t l=0; l<lix; l++ ) {
+      ln_t * ln2= &ln_store[l];
+      if( ln2->tag==LN_TAG_INST && isa_opcode_iix(ln2->inst.opcode)==ISA_IIX_JSR && comp_get_operand(l)==addr ) first= false;
+    }
+    if( first ) wcet_print(addr,PSTR("sub"),0,&warnings);
+  }
+  cmd_printf_P(PSTR("INFO: warnings %X\r\n"),warnings); 
+  free(wcet_d);
+  wcet_d= 0;
+}
+
+
 // ==========================================================================
 // Command handling
 // ==========================================================================
@@ -1507,23 +1961,49 @@ static void cmdprog_insert_stream(int argc, char * argv[]) {
 }
 
 static void cmdprog_compile(int argc, char * argv[]) {
-  // prog compile [ list | install | map ]
-  if( argc>3 ) { cmd_printf_P(PSTR("ERROR: too many arguments\r\n"));  return; }
+  // prog compile [ list [prof] [cycles] | install | map | bin | hex | srec | wcet [<budget>] ]
+  if( argc>5 ) { cmd_printf_P(PSTR("ERROR: too many arguments\r\n"));  return; }
   int cmd= 0;
-  if( argc==3 ) {
+  if( argc>=3 ) {
     if( cmd_isprefix(PSTR("map"),argv[2]) ) cmd=1;
     else if( cmd_isprefix(PSTR("install"),argv[2]) ) cmd=2;
     else if( cmd_isprefix(PSTR("list"),argv[2]) ) cmd=3;
     else if( cmd_isprefix(PSTR("bin"),argv[2]) ) cmd=4;
+    else if( cmd_isprefix(PSTR("hex"),argv[2]) ) cmd=5;
+    else if( cmd_isprefix(PSTR("srec"),argv[2]) ) cmd=6;
+    else if( cmd_isprefix(PSTR("wcet"),argv[2]) ) cmd=7;
     else { cmd_printf_P(PSTR("ERROR: unexpected arguments\r\n")); return; }
   }
+  bool prof= false;
+  bool cycles= false;
+  uint16_t budget= 0;
+  for( int i=3; i<argc; i++ ) {
+    if( cmd==7 && i==3 ) {
+      if( !cmd_parse(argv[i],&budget) ) { cmd_printf_P(PSTR("ERROR: expected hex <budget>, not '%s'\r\n"),argv[i]); return; }
+      continue;
+    }
+    if( cmd!=3 ) { cmd_printf_P(PSTR("ERROR: too many arguments\r\n"));  return; }
+    if( !prof && cmd_isprefix(PSTR("prof"),argv[i]) ) {
+      uint32_t count, sum;
+      if( !cpu_prof_get(0,&count,&sum) ) { cmd_printf_P(PSTR("ERROR: no profile (see 'prof')\r\n")); return; }
+      if( CPU_PROF_BUCKET>1 ) { cmd_printf_P(PSTR("ERROR: profile is per page, not per line\r\n")); return; }
+      prof= true;
+    } else if( !cycles && cmd_isprefix(PSTR("cycles"),argv[i]) ) {
+      cycles= true;
+    } else {
+      cmd_printf_P(PSTR("ERROR: expected prof or cycles, not '%s'\r\n"),argv[i]); return;
+    }
+  }
   bool ok=comp_compile();
   if( cmd==0 ) { return; }
   if( cmd==1 ) { comp_map(); return; }
   if( !ok ) { return; } 
   if( cmd==2 ) { comp_install(); return; }
-  if( cmd==3 ) { comp_list(); return; }
+  if( cmd==3 ) { comp_list(prof,cycles); return; }
   if( cmd==4 ) { comp_bin(); return; }
+  if( cmd==5 ) { comp_hex(false); return; }
+  if( cmd==6 ) { comp_hex(true); return; }
+  if( cmd==7 ) { wcet_analyse(budget); return; }
 }
 
 
@@ -1613,12 +2093,21 @@ const char cmdprog_longhelp[] PROGMEM =
   "- if <num2> is absent deletes only line <num1>\r\n"
   "- if both present, deletes lines <num1> upto <num2>\r\n"
   "- if both present, they may be '-', meaning 0 for <num1> and last for <num2>\r\n"
-  "SYNTAX: prog compile [ list | install | map | bin ]\r\n"
+  "SYNTAX: prog compile [ list [prof] [cycles] | install | map | bin | hex | srec | wcet [<budget>] ]\r\n"
   "- compiles the program; giving info\r\n"
   "- 'list' compiles and produces an instruction listing\r\n"
+  "- 'list prof' adds a column with the share of the profiled cycles per instruction (see 'prof')\r\n"
+  "  (not on AVR: there the profile is per page; 'prof' shows it)\r\n"
+  "- 'list cycles' adds a column with the cycles per instruction (2/3 for a branch not taken/taken,\r\n"
+  "  4-5 when a page may be crossed), with totals per basic block and per iteration of a simple loop\r\n"
   "- 'install' compiles and writes to memory\r\n"
   "- 'map' compiles and produces a table of labels and sections\r\n"
   "- 'bin' shows the generated binary\r\n"
+  "- 'hex' shows the generated binary as Intel HEX records (see 'import')\r\n"
+  "- 'srec' shows the generated binary as Motorola S-records (see 'import')\r\n"
+  "- 'wcet' shows the worst case cycles of the reset, nmi and irq handlers and of each subroutine;\r\n"
+  "  a loop needs a bound: '; loop <num>' on the line before it, or LDX #<num> ... DEX BNE (or Y)\r\n"
+  "- 'wcet <budget>' also warns for an nmi or irq handler that takes more than hex <budget> cycles\r\n"
 ;
 
 
@@ -1,6 +1,7 @@
 // cmdread.cpp - command to read from memory
 
 #include <Arduino.h>
+#include "cpu.h"
 #include "cmd.h"
 #include "cmdread.h"
 
@@ -16,8 +17,12 @@ static void cmdread_read( uint16_t addr, uint16_t num ) {
   int n= 0;
   while( num>0 ) {
     if( n%CMD_BYTESPERLINE==0 ) cmd_printf_P( PSTR("%04X:"), addr); 
-    uint8_t data= mem_read(addr);
-    cmd_printf_P( PSTR(" %02X"), data);
+    if( cpu_page_get(addr>>8) & CPU_PAGE_IO ) { // a read could have a side effect
+      Serial.print(F(" ??"));
+    } else {
+      uint8_t data= mem_read(addr);
+      cmd_printf_P( PSTR(" %02X"), data);
+    }
     n++; num--; addr++; // addr auto wraps
     if( n%CMD_BYTESPERLINE==0 ) { Serial.println(); }
   }
@@ -52,6 +57,7 @@ static const char cmdread_longhelp[] PROGMEM =
   "- when <num> is absent, it defaults to 40\r\n"
   "- when <addr> is absent or -, it defaults to \"previous\" address\r\n"
   "- <addr> and <num> is 0000..FFFF, but physical memory is limited and mirrored\r\n"
+  "- bytes on an I/O page are not read (that could take a received byte), they show as ??\r\n"
 ;
 
   
@@ -0,0 +1,349 @@
+// cmdrun.cpp - commands (run, step, regs and until) to execute the program in memory
+
+#include <Arduino.h>
+#include "cmd.h"
+#include "cpu.h"
+#include "cpupace.h"
+#include "cpurec.h"
+#include "snap.h"
+#include "cmddasm.h"
+#include "cmdread.h"
+#include "cmdrun.h"
+
+
+cpu_t cmdrun_cpu; // Not static, the context may attach devices
+static cpupace_t cmdrun_pacer;
+
+
+// The log of 'run record' (see cpurec.h)
+#ifdef __AVR__
+#define CMDRUN_LOG   64
+#else
+#define CMDRUN_LOG 4096
+#endif
+static cpurec_t cmdrun_rec;
+static uint8_t  cmdrun_log[CMDRUN_LOG];
+
+
+// Why a run ended
+#define CMDRUN_RUNNING 0 // Not ended, continues with the next burst
+#define CMDRUN_BUDGET  1 // All cycles are used
+#define CMDRUN_BREAK   2 // At a breakpoint
+#define CMDRUN_WATCH   3 // A watched address was accessed
+#define CMDRUN_UNUSED  4 // At an opcode not in use
+#define CMDRUN_UNTIL   5 // At the address of 'until'
+#define CMDRUN_STOP    6 // Stopped by 'run stop'
+
+
+// The run in progress
+static bool     cmdrun_running;   // A run continues in cmdrun_poll()
+static uint32_t cmdrun_start;     // Cycle count of the cpu at the start of the run
+static uint32_t cmdrun_end;       // Cycle count of the cpu at which the run ends ..
+static bool     cmdrun_endless;   // .. unless the run is endless
+static bool     cmdrun_untilset;  // The run ends at `cmdrun_untiladdr`
+static uint16_t cmdrun_untiladdr;
+
+
+// Parses up to 8 hex digits from `s` into `*v`; returns false on error
+static bool cmdrun_parse32(const char * s, uint32_t * v) {
+  uint32_t r= 0;
+  uint8_t n= 0;
+  for( ; *s; s++, n++ ) {
+    char ch= *s;
+    if(      ch>='0' && ch<='9' ) r= r*16 + ch-'0';
+    else if( ch>='A' && ch<='F' ) r= r*16 + ch-'A'+10;
+    else if( ch>='a' && ch<='f' ) r= r*16 + ch-'a'+10;
+    else return false;
+  }
+  if( n==0 || n>8 ) return false;
+  *v= r;
+  return true;
+}
+
+
+// Prints the cycle count and registers, the first part of a trace line
+static void cmdrun_line(uint32_t cycles, uint8_t a, uint8_t x, uint8_t y, uint8_t p, uint8_t sp) {
+  cmd_printf_P(PSTR("%08lX A=%02X X=%02X Y=%02X P=%02X S=%02X "), (unsigned long)cycles, a, x, y, p, sp);
+}
+
+
+// Prints the registers and the instruction at pc, in the format of a trace line
+static void cmdrun_print(void) {
+  cpu_t * cpu= &cmdrun_cpu;
+  cmdrun_line(cpu->cycles, cpu->a, cpu->x, cpu->y, cpu_status(cpu), cpu->sp);
+  cmddasm_print_mem(cpu->pc); // does not read an I/O page
+  Serial.println();
+}
+
+
+void cmdrun_trace_print(const cputrace_entry_t * entry) {
+  cmdrun_line(entry->cycles, entry->a, entry->x, entry->y, cputrace_status(entry), entry->sp);
+  cmddasm_print(entry->pc, entry->opcode, entry->op1, entry->op2);
+  Serial.println();
+}
+
+
+uint16_t cmdrun_trace_drain(cputrace_t * tr, uint16_t max) {
+  cputrace_entry_t entry;
+  uint16_t num= 0;
+  while( num<max && cputrace_get(tr,&entry) ) { cmdrun_trace_print(&entry); num++; }
+  return num;
+}
+
+
+// Lets read and dasm continue at the pc
+static void cmdrun_follow(void) {
+  cmddasm_addr= cmdrun_cpu.pc;
+  cmdread_addr= cmdrun_cpu.pc;
+}
+
+
+// Prints why execution ended (`res` is a CMDRUN_xxx)
+static void cmdrun_reason(uint8_t res) {
+  switch( res ) {
+    case CMDRUN_BUDGET : cmd_printf_P(PSTR("INFO: all cycles used")); break;
+    case CMDRUN_BREAK  : cmd_printf_P(PSTR("INFO: breakpoint")); break;
+    case CMDRUN_WATCH  : cmd_printf_P(PSTR("INFO: watchpoint %04X"),cmdrun_cpu.watch); break;
+    case CMDRUN_UNUSED : cmd_printf_P(PSTR("INFO: opcode not in use")); break;
+    case CMDRUN_UNTIL  : cmd_printf_P(PSTR("INFO: reached %04X"),cmdrun_untiladdr); break;
+    case CMDRUN_STOP   : cmd_printf_P(PSTR("INFO: stopped")); break;
+  }
+}
+
+
+// Executes one burst of the run in progress; returns CMDRUN_xxx
+static uint8_t cmdrun_burst(void) {
+  cpu_t * cpu= &cmdrun_cpu;
+  uint32_t burst= cmdrun_pacer.throttle ? cmdrun_pacer.hz/1000 : CMDRUN_BURST; // paced: 1 ms worth of cycles
+  if( burst==0 ) burst= 1;
+  uint32_t end= cpu->cycles + burst;
+  if( !cmdrun_endless && (int32_t)(cmdrun_end-end)<0 ) end= cmdrun_end;
+  if( cmdrun_untilset ) {
+    while( (int32_t)(cpu->cycles-end)<0 ) {
+      if( cpu_step(cpu)==0 ) return cpu->stop==CPU_STOP_BREAK ? CMDRUN_BREAK : CMDRUN_UNUSED;
+      if( cpu->stop==CPU_STOP_WATCH ) return CMDRUN_WATCH;
+      if( cpu->pc==cmdrun_untiladdr ) return CMDRUN_UNTIL;
+    }
+  } else {
+    // Without an until address, pc needs no check after each instruction, so cpu_run() may fuse pairs
+    if( !cpu_run(cpu,end) ) return cpu->stop==CPU_STOP_BREAK ? CMDRUN_BREAK : cpu->stop==CPU_STOP_WATCH ? CMDRUN_WATCH : CMDRUN_UNUSED;
+  }
+  if( !cmdrun_endless && (int32_t)(cpu->cycles-cmdrun_end)>=0 ) return CMDRUN_BUDGET;
+  cpupace_wait(&cmdrun_pacer,cpu);
+  return CMDRUN_RUNNING;
+}
+
+
+// Ends the run in progress, `res` tells why
+static void cmdrun_finish(uint8_t res) {
+  cmdrun_running= false;
+  cmdrun_reason(res);
+  cmd_printf_P(PSTR(" (ran %lX cycles"), (unsigned long)(cmdrun_cpu.cycles-cmdrun_start));
+  // The speed is only meaningful for longer runs
+  if( cpupace_us()-cmdrun_pacer.start_us >= 100000UL ) cmd_printf_P(PSTR(", at %lu%% of %lu Hz"), (unsigned long)cpupace_ratio(&cmdrun_pacer,&cmdrun_cpu), (unsigned long)cmdrun_pacer.hz);
+  cmd_printf_P(PSTR(")\r\n"));
+  if( cmdrun_rec.mode==CPUREC_FULL ) Serial.println(F("WARNING: record log full, recording stopped"));
+  if( cmdrun_rec.mode==CPUREC_DESYNC ) Serial.println(F("WARNING: replay differs from the recording, replay stopped"));
+  cmdrun_print();
+  cmdrun_follow();
+}
+
+
+// Starts a run and executes its first burst; the rest runs from cmdrun_poll()
+static void cmdrun_begin(bool endless, uint32_t cycles, bool untilset, uint16_t untiladdr) {
+  cmdrun_start= cmdrun_cpu.cycles;
+  cmdrun_end= cmdrun_cpu.cycles+cycles;
+  cmdrun_endless= endless;
+  cmdrun_untilset= untilset;
+  cmdrun_untiladdr= untiladdr;
+  cmdrun_cpu.stop= CPU_STOP_BREAK; // as if just reported: execution starts at pc, even when it has a breakpoint
+  cmdrun_running= true;
+  cpupace_start(&cmdrun_pacer,&cmdrun_cpu);
+  cmdrun_poll();
+}
+
+
+void cmdrun_poll(void) {
+  if( !cmdrun_running ) return;
+  uint8_t res= cmdrun_burst();
+  if( res!=CMDRUN_RUNNING ) cmdrun_finish(res);
+}
+
+
+void cmdrun_pace(uint32_t hz, bool throttle) {
+  cpupace_init(&cmdrun_pacer,hz,throttle);
+}
+
+
+// The handler for the "run" command
+static void cmdrun_run_main(int argc, char * argv[]) {
+  // run [ <addr> [ <cycles> ] ]
+  // run stop
+  // run reset
+  // run record
+  // run replay
+  // run pace [ <hz> | off ]
+  // Note cmd_isprefix needs a PROGMEM string. PSTR stores a string in PROGMEM.
+  if( argc==2 && cmd_isprefix(PSTR("stop"),argv[1]) ) {
+    if( !cmdrun_running ) { Serial.println(F("ERROR: not running")); return; }
+    cmdrun_finish(CMDRUN_STOP);
+    return;
+  }
+  if( cmdrun_running ) { Serial.println(F("ERROR: already running (use 'run stop')")); return; }
+  if( argc==2 && cmd_isprefix(PSTR("reset"),argv[1]) ) {
+    // Devices stay attached
+    cpu_t saved= cmdrun_cpu;
+    cpu_reset(&cmdrun_cpu);
+    cmdrun_cpu.rec= saved.rec;
+    cmdrun_cpu.trace= saved.trace;
+    cmdrun_cpu.sched= saved.sched;
+    cmdrun_print();
+    cmdrun_follow();
+    return;
+  }
+  if( argc==2 && cmd_isprefix(PSTR("record"),argv[1]) ) {
+    if( cmdrun_cpu.rec ) cpurec_stop(&cmdrun_rec,&cmdrun_cpu);
+    if( cpurec_record(&cmdrun_rec,&cmdrun_cpu,cmdrun_log,CMDRUN_LOG)!=SNAP_OK ) { cmd_printf_P(PSTR("ERROR: memory size %X not supported by snapshot\r\n"),mem_size); return; }
+    Serial.println(F("INFO: recording (snapshot taken)"));
+    return;
+  }
+  if( argc==2 && cmd_isprefix(PSTR("replay"),argv[1]) ) {
+    if( cmdrun_rec.log==0 ) { Serial.println(F("ERROR: nothing recorded (use 'run record')")); return; }
+    if( cmdrun_cpu.rec ) cpurec_stop(&cmdrun_rec,&cmdrun_cpu);
+    if( cpurec_replay(&cmdrun_rec,&cmdrun_cpu)!=SNAP_OK ) { Serial.println(F("ERROR: snapshot lost or replaced")); return; }
+    cmd_printf_P(PSTR("INFO: replaying %X bytes of log\r\n"),cmdrun_rec.len);
+    cmdrun_print();
+    cmdrun_follow();
+    return;
+  }
+  if( argc>=2 && cmd_isprefix(PSTR("pace"),argv[1]) ) {
+    if( argc>3 ) { Serial.println(F("ERROR: too many arguments")); return; }
+    if( argc==3 ) {
+      uint32_t hz;
+      if( cmd_isprefix(PSTR("off"),argv[2]) ) {
+        cmdrun_pace(cmdrun_pacer.hz,false);
+      } else if( cmdrun_parse32(argv[2],&hz) && hz>0 ) {
+        cmdrun_pace(hz,true);
+      } else {
+        cmd_printf_P(PSTR("ERROR: expected hex <hz> (not 0) or off, not '%s'\r\n"),argv[2]); return;
+      }
+    }
+    if( cmdrun_pacer.throttle ) cmd_printf_P(PSTR("INFO: paced to %lu Hz\r\n"), (unsigned long)cmdrun_pacer.hz);
+    else cmd_printf_P(PSTR("INFO: not paced (speed compared to %lu Hz)\r\n"), (unsigned long)cmdrun_pacer.hz);
+    return;
+  }
+  if( argc>3 ) { Serial.println(F("ERROR: too many arguments")); return; }
+  // Parse addr
+  uint16_t addr= cmdrun_cpu.pc;
+  if( argc>=2 && !(argv[1][0]=='-' && argv[1][1]=='\0') ) {
+    if( !cmd_parse(argv[1],&addr) ) { cmd_printf_P(PSTR("ERROR: expected hex <addr>, not '%s'\r\n"),argv[1]); return; }
+  }
+  // Parse cycles
+  uint32_t cycles= 0;
+  if( argc==3 ) {
+    if( !cmdrun_parse32(argv[2],&cycles) ) { cmd_printf_P(PSTR("ERROR: expected hex <cycles>, not '%s'\r\n"),argv[2]); return; }
+  }
+  cmdrun_cpu.pc= addr;
+  cmdrun_begin(argc<3,cycles,false,0);
+}
+
+
+// The handler for the "until" command
+static void cmdrun_until_main(int argc, char * argv[]) {
+  // until <addr>
+  if( cmdrun_running ) { Serial.println(F("ERROR: already running (use 'run stop')")); return; }
+  if( argc==1 ) { Serial.println(F("ERROR: expected <addr>")); return; }
+  if( argc>2 ) { Serial.println(F("ERROR: too many arguments")); return; }
+  uint16_t addr;
+  if( !cmd_parse(argv[1],&addr) ) { cmd_printf_P(PSTR("ERROR: expected hex <addr>, not '%s'\r\n"),argv[1]); return; }
+  cmdrun_begin(true,0,true,addr);
+}
+
+
+// The handler for the "step" command
+static void cmdrun_step_main(int argc, char * argv[]) {
+  // step [ <num> ]
+  if( cmdrun_running ) { Serial.println(F("ERROR: already running (use 'run stop')")); return; }
+  if( argc>2 ) { Serial.println(F("ERROR: too many arguments")); return; }
+  uint16_t num= 1;
+  if( argc==2 ) {
+    if( !cmd_parse(argv[1],&num) ) { cmd_printf_P(PSTR("ERROR: expected hex <num>, not '%s'\r\n"),argv[1]); return; }
+  }
+  cpu_t * cpu= &cmdrun_cpu;
+  cpu->stop= CPU_STOP_BREAK; // as if just reported: the instruction at pc executes, even when it has a breakpoint
+  uint8_t res= CMDRUN_RUNNING;
+  for( uint16_t i=0; i<num && res==CMDRUN_RUNNING; i++ ) {
+    if( cpu_step(cpu)==0 ) res= cpu->stop==CPU_STOP_BREAK ? CMDRUN_BREAK : CMDRUN_UNUSED;
+    else if( cpu->stop==CPU_STOP_WATCH ) res= CMDRUN_WATCH;
+  }
+  if( res!=CMDRUN_RUNNING ) { cmdrun_reason(res); Serial.println(); }
+  cmdrun_print();
+  cmdrun_follow();
+}
+
+
+// The handler for the "regs" command
+static void cmdrun_regs_main(int argc, char * argv[]) {
+  (void)argv;
+  if( argc>1 ) { Serial.println(F("ERROR: no arguments allowed")); return; }
+  cmdrun_print();
+}
+
+
+static const char cmdrun_run_longhelp[] PROGMEM =
+  "SYNTAX: run [ <addr> [ <cycles> ] ]\r\n"
+  "- runs the program in memory, starting at <addr>\r\n"
+  "- when <addr> is absent or -, it continues at the current pc\r\n"
+  "- when <cycles> is present, stops after (about) that many cycles (up to 8 hex digits)\r\n"
+  "SYNTAX: run stop\r\n"
+  "- stops the program that is running\r\n"
+  "SYNTAX: run reset\r\n"
+  "- resets the cpu (pc from the reset vector at FFFC)\r\n"
+  "SYNTAX: run record\r\n"
+  "- takes a snapshot (of memory and cpu), and records the I/O reads and interrupts of the next runs\r\n"
+  "SYNTAX: run replay\r\n"
+  "- restores the snapshot of 'run record', and replays the recording in the next runs\r\n"
+  "SYNTAX: run pace [ <hz> | off ]\r\n"
+  "- paces the next runs to a clock of <hz> (hex, e.g. F4240 for 1 MHz), or runs them at full speed\r\n"
+  "- without arguments, shows the pace\r\n"
+  "NOTES:\r\n"
+  "- a run also stops at a breakpoint, a watchpoint, or an opcode not in use\r\n"
+  "- the program runs in bursts, between bursts commands are accepted\r\n"
+  "- when it stops, the registers are shown and read and dasm continue at the pc\r\n"
+  "- a run of at least 0.1s reports its speed relative to the clock of 'run pace' (default 1 MHz)\r\n"
+  "- 'run record' replaces the snapshot of 'snapshot'; a replay ends at the end of the recording\r\n"
+;
+
+
+static const char cmdrun_until_longhelp[] PROGMEM =
+  "SYNTAX: until <addr>\r\n"
+  "- runs the program from the current pc, until the pc is <addr>\r\n"
+  "NOTES:\r\n"
+  "- stops like run (see 'run'), e.g. use 'run stop' when <addr> is never reached\r\n"
+;
+
+
+static const char cmdrun_step_longhelp[] PROGMEM =
+  "SYNTAX: step [ <num> ]\r\n"
+  "- executes <num> instructions (default 1), then shows the registers\r\n"
+  "NOTES:\r\n"
+  "- stops early at a breakpoint, a watchpoint, or an opcode not in use\r\n"
+  "- read and dasm continue at the pc\r\n"
+;
+
+
+static const char cmdrun_regs_longhelp[] PROGMEM =
+  "SYNTAX: regs\r\n"
+  "- shows the cycle count, the registers and the instruction at the pc\r\n"
+;
+
+
+// Note cmd_register needs all strings to be PROGMEM strings. For the short string we do that inline with PSTR.
+void cmdrun_register(void) {
+  cpu_reset(&cmdrun_cpu);
+  cmdrun_pace(1000000UL,false);
+  cmd_register(cmdrun_regs_main, PSTR("regs"), PSTR("show the cpu registers"), cmdrun_regs_longhelp);
+  cmd_register(cmdrun_run_main, PSTR("run"), PSTR("run the program in memory"), cmdrun_run_longhelp);
+  cmd_register(cmdrun_step_main, PSTR("step"), PSTR("execute instructions one by one"), cmdrun_step_longhelp);
+  cmd_register(cmdrun_until_main, PSTR("until"), PSTR("run until an address is reached"), cmdrun_until_longhelp);
+}
@@ -0,0 +1,36 @@
+// cmdrun.h - commands (run, step, regs and until) to execute the program in memory
+#ifndef __CMDRUN_H__
+#define __CMDRUN_H__
+
+
+// The context is expected to implement
+#include <stdint.h>
+#include "cpu.h"
+#include "cputrace.h"
+extern uint8_t mem_read(uint16_t addr);
+extern void    mem_write(uint16_t addr, uint8_t data);
+extern const uint16_t mem_size;
+// and to call cmdrun_poll() from loop(), next to cmd_pollserial(), and snap_write() from mem_write() (see snap.h)
+
+
+// The cpu that the commands run; the context may attach devices to it (e.g. a scheduler, see cpusched.h)
+extern cpu_t cmdrun_cpu;
+// A run executes in bursts; cmdrun_poll() executes one burst of a run in progress (returns at once when
+// there is none). So between bursts, loop() feeds the command interpreter: the console is never blocked.
+#ifdef __AVR__
+#define CMDRUN_BURST    2000 // Cycles per burst when unthrottled
+#else
+#define CMDRUN_BURST 1000000
+#endif
+void cmdrun_poll(void);
+// Sets the clock the cpu is paced to (see cpupace.h); when not `throttle` it runs at full speed (the default)
+void cmdrun_pace(uint32_t hz, bool throttle);
+// Prints a trace entry (see cputrace.h) to Serial, in the format of 'step' (registers and disassembled instruction)
+void cmdrun_trace_print(const cputrace_entry_t * entry);
+// Prints up to `max` entries of trace ring `tr` (for idle time, e.g. from loop()); returns the number printed
+uint16_t cmdrun_trace_drain(cputrace_t * tr, uint16_t max);
+// This module implements four commands: regs, run, step and until
+void cmdrun_register(void);
+
+
+#endif
@@ -0,0 +1,64 @@
+// cmdsnap.cpp - commands (snapshot and restore) to save and restore the memory state
+
+
+#include <Arduino.h>
+#include "cmd.h"
+#include "snap.h"
+#include "cmdsnap.h"
+
+
+// Prints the error for `res` (a SNAP_ERR_xxx); returns true when there was none
+static bool cmdsnap_check(uint8_t res) {
+  switch( res ) {
+    case SNAP_OK       : return true;
+    case SNAP_ERR_NONE : Serial.println(F("ERROR: no snapshot taken")); break;
+    case SNAP_ERR_LOST : cmd_printf_P(PSTR("ERROR: snapshot lost (more than %X pages written)\r\n"),SNAP_COPIES); break;
+    case SNAP_ERR_SIZE : cmd_printf_P(PSTR("ERROR: memory size %X not supported (max %X pages of %X bytes)\r\n"),mem_size,SNAP_PAGES,SNAP_PAGE_SIZE); break;
+  }
+  return false;
+}
+
+
+// The handler for the "snapshot" command
+static void cmdsnap_snapshot_main(int argc, char * argv[]) {
+  (void)argv;
+  if( argc>1 ) { Serial.println(F("ERROR: no arguments allowed")); return; }
+  if( !cmdsnap_check(snap_take(0)) ) return;
+  Serial.println(F("INFO: snapshot taken"));
+}
+
+
+// The handler for the "restore" command
+static void cmdsnap_restore_main(int argc, char * argv[]) {
+  (void)argv;
+  if( argc>1 ) { Serial.println(F("ERROR: no arguments allowed")); return; }
+  uint16_t pages= snap_dirty();
+  if( !cmdsnap_check(snap_restore(0)) ) return;
+  cmd_printf_P(PSTR("INFO: restored %X pages\r\n"),pages);
+}
+
+
+static const char cmdsnap_snapshot_longhelp[] PROGMEM =
+  "SYNTAX: snapshot\r\n"
+  "- takes a snapshot of memory, see 'restore'\r\n"
+  "NOTES:\r\n"
+  "- nothing is copied yet; a page is copied when it is first written\r\n"
+  "- a new snapshot replaces the previous one\r\n"
+;
+
+
+static const char cmdsnap_restore_longhelp[] PROGMEM =
+  "SYNTAX: restore\r\n"
+  "- restores memory to the last snapshot\r\n"
+  "NOTES:\r\n"
+  "- only pages written since the snapshot are restored\r\n"
+  "- the snapshot stays, so it can be restored again\r\n"
+  "- when too many pages were written, the snapshot is lost\r\n"
+;
+
+
+// Note cmd_register needs all strings to be PROGMEM strings. For the short string we do that inline with PSTR.
+void cmdsnap_register(void) {
+  cmd_register(cmdsnap_restore_main, PSTR("restore"), PSTR("restore memory to snapshot"), cmdsnap_restore_longhelp);
+  cmd_register(cmdsnap_snapshot_main, PSTR("snapshot"), PSTR("take a snapshot of memory"), cmdsnap_snapshot_longhelp);
+}
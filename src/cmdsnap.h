@@ -0,0 +1,18 @@
+// cmdsnap.h - commands (snapshot and restore) to save and restore the memory state
+#ifndef __CMDSNAP_H__
+#define __CMDSNAP_H__
+
+
+// The context is expected to implement (see snap.h)
+#include <stdint.h>
+extern uint8_t mem_read(uint16_t addr);
+extern void    mem_write(uint16_t addr, uint8_t data);
+extern const uint16_t mem_size;
+// and to call snap_write(addr) in mem_write(), before the memory is changed
+
+
+// This module implements two commands: snapshot and restore
+void cmdsnap_register(void);
+
+
+#endif
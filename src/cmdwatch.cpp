@@ -0,0 +1,80 @@
+// cmdwatch.cpp - command to set, clear and list watchpoints
+
+#include <Arduino.h>
+#include "cmd.h"
+#include "cpu.h"
+#include "cmdwatch.h"
+
+
+// Calls `func` for every watchpoint (only pages with a watchpoint are scanned); returns the number of watchpoints
+static uint16_t cmdwatch_each( void (*func)(uint16_t addr, uint8_t mode) ) {
+  uint16_t num= 0;
+  for( uint16_t page=0; page<256; page++ ) {
+    if( !(cpu_page_get(page) & CPU_PAGE_WATCH) ) continue;
+    for( uint16_t i=0; i<256; i++ ) {
+      uint16_t addr= (page<<8) | i;
+      uint8_t mode= cpu_watch_get(addr);
+      if( mode ) { func(addr,mode); num++; }
+    }
+  }
+  return num;
+}
+
+
+static void cmdwatch_print(uint16_t addr, uint8_t mode) {
+  cmd_printf_P( PSTR("%04X %s%s\r\n"), addr, mode&CPU_WATCH_R?"r":"", mode&CPU_WATCH_W?"w":"");
+}
+
+
+static void cmdwatch_clr(uint16_t addr, uint8_t mode) {
+  (void)mode;
+  cpu_watch_set(addr,0);
+}
+
+
+// The handler for the "watch" command
+static void cmdwatch_main( int argc, char * argv[] ) {
+  // watch [ clr ] [ <addr> [ r | w | rw ] ]
+  if( argc==1 ) { 
+    if( cmdwatch_each(cmdwatch_print)==0 ) Serial.println(F("INFO: no watchpoints")); 
+    return; 
+  }
+  uint16_t addr;
+  bool clr= false;
+  // Note cmd_isprefix needs a PROGMEM string. PSTR stores a string in PROGMEM.
+  if( !cmd_parse(argv[1],&addr) && cmd_isprefix(PSTR("clr"),argv[1]) ) { 
+    clr= true; argc--; argv++; 
+    if( argc==1 ) { cmdwatch_each(cmdwatch_clr); return; }
+  }
+  if( !cmd_parse(argv[1],&addr) ) { cmd_printf_P(PSTR("ERROR: expected hex <addr>, not '%s'\r\n"),argv[1]); return; }
+  uint8_t mode= CPU_WATCH_R | CPU_WATCH_W;
+  if( !clr && argc>2 ) {
+    if( strcasecmp_P(argv[2],PSTR("r"))==0 ) mode= CPU_WATCH_R;
+    else if( strcasecmp_P(argv[2],PSTR("w"))==0 ) mode= CPU_WATCH_W;
+    else if( strcasecmp_P(argv[2],PSTR("rw"))==0 ) mode= CPU_WATCH_R | CPU_WATCH_W;
+    else { cmd_printf_P(PSTR("ERROR: expected r, w or rw, not '%s'\r\n"),argv[2]); return; }
+    argc--;
+  }
+  if( argc>2 ) { Serial.println(F("ERROR: too many arguments")); return; }
+  if( !cpu_watch_set(addr,clr?0:mode) ) cmd_printf_P(PSTR("ERROR: too many watchpoints (max %X)\r\n"),CPU_WATCH_NUM);
+}
+
+
+static const char cmdwatch_longhelp[] PROGMEM = 
+  "SYNTAX: watch\r\n"
+  "- lists all watchpoints\r\n"
+  "SYNTAX: watch <addr> [ r | w | rw ]\r\n"
+  "- sets a watchpoint at <addr> for reads, writes, or both (default)\r\n"
+  "SYNTAX: watch clr [ <addr> ]\r\n"
+  "- clears the watchpoint at <addr>, or all watchpoints\r\n"
+  "NOTES:\r\n"
+  "- execution stops after the instruction that accessed a watched address\r\n"
+  "- reads are data reads of instructions, not instruction fetches\r\n"
+  "- 'clr' may be abbreviated to 'cl' ('c' is hex)\r\n"
+;
+
+  
+// Note cmd_register needs all strings to be PROGMEM strings. For the short string we do that inline with PSTR.
+void cmdwatch_register(void) {
+  cmd_register(cmdwatch_main, PSTR("watch"), PSTR("set, clear or list watchpoints"), cmdwatch_longhelp);
+}
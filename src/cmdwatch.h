@@ -0,0 +1,10 @@
+// cmdwatch.h - command to set, clear and list watchpoints
+#ifndef __CMDWATCH_H__
+#define __CMDWATCH_H__
+
+
+// This module implements a command
+void cmdwatch_register(void);
+
+
+#endif
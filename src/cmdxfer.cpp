@@ -0,0 +1,352 @@
+// cmdxfer.cpp - commands (load, save and import) for bulk transfer of memory
+
+
+#include <Arduino.h>
+#include "cmd.h"
+#include "cmdxfer.h"
+
+
+// The `write` and `read` commands transfer memory as hex text, which costs three chars per byte plus echo.
+// The `load` and `save` commands transfer raw bytes in frames, protected by a CRC and acknowledged per frame.
+// A frame is: <seq> <len> <len payload bytes> <crc-lo> <crc-hi>
+//  - <seq> is the frame number (modulo 256), the first frame has number 0
+//  - <len> is the number of payload bytes, CMDXFER_FRAME for all frames except maybe the last one
+//  - the CRC-16/CCITT (poly 1021, init FFFF) is computed over <seq>, <len> and the payload
+// The receiver acknowledges a good frame with ACK <seq>; on a bad frame it waits until the line is quiet
+// and then sends NAK <seq> with the number of the frame it expects next (go-back-N).
+// The sender may have up to CMDXFER_WINDOW frames in flight (unacknowledged).
+#define CMDXFER_FRAME     32 // Max payload bytes per frame (also in test/cmd.py)
+#define CMDXFER_WINDOW     4 // Max number of frames in flight when saving
+#define CMDXFER_TIMEOUT 1000 // Max time in ms between two bytes (or a frame and its acknowledge)
+#define CMDXFER_QUIET     20 // Time in ms without bytes, after which a receiver considers the line quiet
+#define CMDXFER_RETRIES    8 // Max number of consecutive rejected frames
+#define CMDXFER_ACK     0x06 // Acknowledge
+#define CMDXFER_NAK     0x15 // Negative acknowledge
+
+
+// This notification is called for a load command; lowest changed address is passed.
+// For laziness, the handling is implemented here, not on app level
+static void cmdxfer_notify(uint16_t addr) {
+  // set read/dasm pointer (so that they can show what has just been written)
+  extern uint16_t cmddasm_addr;
+  cmddasm_addr= addr;
+  extern uint16_t cmdread_addr;
+  cmdread_addr= addr;
+}
+
+
+// Updates the CRC-16/CCITT `crc` with byte `data`
+static uint16_t cmdxfer_crc(uint16_t crc, uint8_t data) {
+  crc^= (uint16_t)data<<8;
+  for( uint8_t i=0; i<8; i++ ) crc= (crc&0x8000) ? (crc<<1)^0x1021 : crc<<1;
+  return crc;
+}
+
+
+// Returns the next byte from Serial, or -1 when nothing arrived within CMDXFER_TIMEOUT ms
+static int cmdxfer_getc(void) {
+  uint32_t start= millis();
+  while( !Serial.available() ) if( millis()-start>CMDXFER_TIMEOUT ) return -1;
+  return Serial.read();
+}
+
+
+// Discards all incoming bytes until the line has been quiet for CMDXFER_QUIET ms
+static void cmdxfer_quiet(void) {
+  uint32_t start= millis();
+  while( millis()-start<CMDXFER_QUIET ) if( Serial.available() ) { Serial.read(); start= millis(); }
+}
+
+
+// Receives one frame; it must have sequence number `seq` and `len` payload bytes, which are stored in `buf`.
+// Returns 1 on success, 0 when the frame is corrupt or out of sequence, -1 on timeout.
+static int cmdxfer_recvframe(uint8_t seq, uint8_t len, uint8_t * buf) {
+  int ch;
+  uint16_t crc= 0xFFFF;
+  if( (ch=cmdxfer_getc())<0 ) return -1;
+  crc= cmdxfer_crc(crc,ch);
+  bool inseq= ch==seq;
+  if( (ch=cmdxfer_getc())<0 ) return -1;
+  crc= cmdxfer_crc(crc,ch);
+  if( ch!=len ) return 0; // can not trust the rest of the frame
+  for( uint8_t i=0; i<len; i++ ) {
+    if( (ch=cmdxfer_getc())<0 ) return -1;
+    crc= cmdxfer_crc(crc,ch);
+    buf[i]= ch;
+  }
+  int lo, hi;
+  if( (lo=cmdxfer_getc())<0 ) return -1;
+  if( (hi=cmdxfer_getc())<0 ) return -1;
+  return inseq && crc==(uint16_t)((hi<<8)|lo);
+}
+
+
+// Sends one frame with sequence number `seq`; the payload are the `len` bytes from memory at `addr`.
+static void cmdxfer_sendframe(uint8_t seq, uint16_t addr, uint8_t len) {
+  uint16_t crc= 0xFFFF;
+  Serial.write(seq); crc= cmdxfer_crc(crc,seq);
+  Serial.write(len); crc= cmdxfer_crc(crc,len);
+  while( len>0 ) {
+    uint8_t data= mem_read(addr);
+    Serial.write(data); crc= cmdxfer_crc(crc,data);
+    addr++; len--; // addr auto wraps
+  }
+  Serial.write(crc&0xFF);
+  Serial.write(crc>>8);
+}
+
+
+// Receives `num` bytes in frames and writes them to memory, starting at `addr`.
+static void cmdxfer_load(uint16_t addr, uint32_t num) {
+  uint8_t  buf[CMDXFER_FRAME];
+  uint32_t done= 0;
+  uint8_t  seq= 0;
+  uint8_t  errors= 0;
+  cmdxfer_notify(addr); // Notify lowest changed address
+  Serial.println(F("INFO: load ready"));
+  while( done<num ) {
+    uint8_t len= num-done<CMDXFER_FRAME ? num-done : CMDXFER_FRAME;
+    int res= cmdxfer_recvframe(seq,len,buf);
+    if( res<0 ) { cmd_printf_P(PSTR("ERROR: timeout (after %lX bytes)\r\n"),(unsigned long)done); return; }
+    if( res==0 ) {
+      if( ++errors>CMDXFER_RETRIES ) { cmd_printf_P(PSTR("ERROR: too many bad frames (after %lX bytes)\r\n"),(unsigned long)done); return; }
+      cmdxfer_quiet(); // the sender stops when its window is full
+      Serial.write(CMDXFER_NAK); Serial.write(seq);
+      continue;
+    }
+    for( uint8_t i=0; i<len; i++ ) mem_write(addr++, buf[i]); // addr auto wraps
+    done+= len;
+    errors= 0;
+    Serial.write(CMDXFER_ACK); Serial.write(seq);
+    seq++;
+  }
+  cmd_printf_P(PSTR("INFO: loaded %lX bytes\r\n"),(unsigned long)done);
+}
+
+
+// Sends `num` bytes from memory, starting at `addr`, in frames.
+static void cmdxfer_save(uint16_t addr, uint32_t num) {
+  uint32_t base= 0; // offset of the oldest unacknowledged frame
+  uint32_t next= 0; // offset of the next frame to send
+  uint8_t  errors= 0;
+  Serial.println(F("INFO: save ready"));
+  while( base<num ) {
+    // Fill the window
+    while( next<num && next-base<(uint32_t)CMDXFER_WINDOW*CMDXFER_FRAME ) {
+      uint8_t len= num-next<CMDXFER_FRAME ? num-next : CMDXFER_FRAME;
+      cmdxfer_sendframe(next/CMDXFER_FRAME, addr+next, len);
+      next+= len;
+    }
+    // Wait for an (negative) acknowledge
+    int tag= cmdxfer_getc();
+    int seq= cmdxfer_getc();
+    if( tag<0 || seq<0 ) { cmd_printf_P(PSTR("\r\nERROR: timeout (after %lX bytes)\r\n"),(unsigned long)base); return; }
+    // Map `seq` to a frame in the window; stale (negative) acknowledges map outside the window
+    uint8_t ix= seq-base/CMDXFER_FRAME;
+    if( base+(uint32_t)ix*CMDXFER_FRAME>=next ) continue;
+    if( tag==CMDXFER_ACK ) {
+      base+= (uint32_t)(ix+1)*CMDXFER_FRAME;
+      if( base>num ) base= num;
+      errors= 0;
+    } else if( tag==CMDXFER_NAK ) {
+      if( ++errors>CMDXFER_RETRIES ) { cmd_printf_P(PSTR("\r\nERROR: too many bad frames (after %lX bytes)\r\n"),(unsigned long)base); return; }
+      base+= (uint32_t)ix*CMDXFER_FRAME;
+      next= base; // go back
+    }
+  }
+  cmd_printf_P(PSTR("INFO: saved %lX bytes\r\n"),(unsigned long)num);
+}
+
+
+// Parses `argv[1]` and `argv[2]` as <addr> and <num> ; <num> 0 means the full 64k.
+// Returns false (and prints an error) on failure.
+static bool cmdxfer_args(int argc, char * argv[], uint16_t * addr, uint32_t * num) {
+  if( argc<3 ) { cmd_printf_P(PSTR("ERROR: insufficient arguments, need <addr> and <num>\r\n")); return false; }
+  if( argc>3 ) { cmd_printf_P(PSTR("ERROR: too many arguments\r\n")); return false; }
+  if( !cmd_parse(argv[1],addr) ) { cmd_printf_P(PSTR("ERROR: expected hex <addr>, not '%s'\r\n"),argv[1]); return false; }
+  uint16_t n;
+  if( !cmd_parse(argv[2],&n) ) { cmd_printf_P(PSTR("ERROR: expected hex <num>, not '%s'\r\n"),argv[2]); return false; }
+  *num= n==0 ? 0x10000UL : n;
+  return true;
+}
+
+
+// The handler for the "load" command
+static void cmdxfer_load_main(int argc, char * argv[]) {
+  // load <addr> <num>
+  uint16_t addr;
+  uint32_t num;
+  if( cmdxfer_args(argc,argv,&addr,&num) ) cmdxfer_load(addr,num);
+}
+
+
+// The handler for the "save" command
+static void cmdxfer_save_main(int argc, char * argv[]) {
+  // save <addr> <num>
+  uint16_t addr;
+  uint32_t num;
+  if( cmdxfer_args(argc,argv,&addr,&num) ) cmdxfer_save(addr,num);
+}
+
+
+// The `import` command receives Intel HEX or Motorola S-records as text lines, so a terminal can paste them.
+// Each record is checked (length and checksum) and its data bytes are written to memory immediately.
+#define CMDXFER_RECMAX 40 // Max number of bytes (incl count, address, type, checksum) in an imported record
+static uint16_t cmdxfer_import_addr; // Address following the last imported byte
+static uint16_t cmdxfer_import_num;  // Number of imported bytes
+static uint16_t cmdxfer_import_bad;  // Number of rejected records
+
+
+// Converts the hex digit pairs in `s` to bytes in `buf` (of `size` bytes).
+// Returns the number of bytes, or -1 on odd length, non-hex digits or overflow.
+static int cmdxfer_hex2bytes(const char * s, uint8_t * buf, int size) {
+  int n= 0;
+  while( *s ) {
+    uint8_t b= 0;
+    for( uint8_t i=0; i<2; i++ ) {
+      char ch= *s++;
+      if( '0'<=ch && ch<='9' ) b= b*16 + ch-'0';
+      else if( 'A'<=ch && ch<='F' ) b= b*16 + ch-'A'+10;
+      else if( 'a'<=ch && ch<='f' ) b= b*16 + ch-'a'+10;
+      else return -1; // also catches the terminating 0 of an odd length string
+    }
+    if( n==size ) return -1;
+    buf[n++]= b;
+  }
+  return n;
+}
+
+
+// Writes the `len` bytes `data` to memory at `addr`.
+static void cmdxfer_import_write(uint16_t addr, const uint8_t * data, uint8_t len) {
+  if( cmdxfer_import_num==0 ) cmdxfer_notify(addr); // Notify lowest changed address (well, the first)
+  for( uint8_t i=0; i<len; i++ ) mem_write(addr++, data[i]); // addr auto wraps
+  cmdxfer_import_addr= addr;
+  cmdxfer_import_num+= len;
+}
+
+
+// Imports Intel HEX record `rec` (after the ':'). Returns 1 for an end record, 0 for another valid record, -1 on error.
+static int cmdxfer_import_ihex(const char * rec) {
+  uint8_t buf[CMDXFER_RECMAX];
+  int n= cmdxfer_hex2bytes(rec,buf,CMDXFER_RECMAX);
+  if( n<5 ) { cmd_printf_P(PSTR("ERROR: record must be hex digit pairs (max %X bytes)\r\n"),CMDXFER_RECMAX); return -1; }
+  if( n!=buf[0]+5 ) { cmd_printf_P(PSTR("ERROR: record length mismatch\r\n")); return -1; }
+  uint8_t sum= 0;
+  for( int i=0; i<n; i++ ) sum+= buf[i];
+  if( sum!=0 ) { cmd_printf_P(PSTR("ERROR: record checksum mismatch (expected %02X)\r\n"),(uint8_t)(buf[n-1]-sum)); return -1; }
+  switch( buf[3] ) {
+    case 0x00: cmdxfer_import_write( buf[1]<<8 | buf[2], buf+4, buf[0] ); return 0; // data
+    case 0x01: return 1; // end of file
+    case 0x02: // extended segment address
+    case 0x04: // extended linear address
+      if( buf[0]!=2 || buf[4]!=0 || buf[5]!=0 ) { cmd_printf_P(PSTR("ERROR: address beyond 64k\r\n")); return -1; }
+      return 0;
+    case 0x03: // start segment address
+    case 0x05: // start linear address
+      return 0; // ignored
+  }
+  cmd_printf_P(PSTR("ERROR: unsupported record type %02X\r\n"),buf[3]); 
+  return -1;
+}
+
+
+// Imports Motorola S-record `rec` (after the 'S'). Returns 1 for an end record, 0 for another valid record, -1 on error.
+static int cmdxfer_import_srec(const char * rec) {
+  uint8_t buf[CMDXFER_RECMAX];
+  char type= *rec++;
+  int n= cmdxfer_hex2bytes(rec,buf,CMDXFER_RECMAX);
+  if( n<4 ) { cmd_printf_P(PSTR("ERROR: record must be hex digit pairs (max %X bytes)\r\n"),CMDXFER_RECMAX); return -1; }
+  if( n!=buf[0]+1 ) { cmd_printf_P(PSTR("ERROR: record length mismatch\r\n")); return -1; }
+  uint8_t sum= 0;
+  for( int i=0; i<n; i++ ) sum+= buf[i];
+  if( sum!=0xFF ) { cmd_printf_P(PSTR("ERROR: record checksum mismatch (expected %02X)\r\n"),(uint8_t)(buf[n-1]+0xFF-sum)); return -1; }
+  switch( type ) {
+    case '0': return 0; // header, ignored
+    case '1': cmdxfer_import_write( buf[1]<<8 | buf[2], buf+3, buf[0]-3 ); return 0; // data
+    case '5': // record count, ignored
+    case '6': return 0;
+    case '9': return 1; // end (start address is ignored)
+  }
+  cmd_printf_P(PSTR("ERROR: unsupported record type S%c\r\n"),type); 
+  return -1;
+}
+
+
+// The streaming handler for the "import" command (one record per line)
+static void cmdxfer_import_stream(int argc, char * argv[]) {
+  int res= 0;
+  if( argc==0 ) { // no arguments toggles streaming mode
+    if( cmd_get_streamfunc()==0 ) cmd_set_streamfunc(cmdxfer_import_stream); else cmd_set_streamfunc(0);
+  } else if( argc>1 ) {
+    cmd_printf_P(PSTR("ERROR: record must not contain spaces\r\n")); res= -1;
+  } else if( argv[0][0]==':' ) {
+    res= cmdxfer_import_ihex(argv[0]+1);
+  } else if( argv[0][0]=='S' || argv[0][0]=='s' ) {
+    res= cmdxfer_import_srec(argv[0]+1);
+  } else {
+    cmd_printf_P(PSTR("ERROR: record must start with ':' (Intel HEX) or 'S' (S-record)\r\n")); res= -1;
+  }
+  if( res<0 ) cmdxfer_import_bad++;
+  if( res>0 ) {
+    cmd_printf_P(PSTR("INFO: imported %X bytes, %X bad records\r\n"),cmdxfer_import_num,cmdxfer_import_bad);
+    cmd_set_streamfunc(0); // an end record also ends streaming mode
+  }
+  // Set the streaming prompt (will only be shown in streaming mode)
+  char buf[10]; snprintf_P(buf,sizeof buf, PSTR("I:%04x> "),cmdxfer_import_addr); cmd_set_streamprompt(buf);
+}
+
+
+// The handler for the "import" command
+static void cmdxfer_import_main(int argc, char * argv[]) {
+  // import [<record>]
+  argc--; argv++; // remove 'import'
+  cmdxfer_import_num= 0;
+  cmdxfer_import_bad= 0;
+  cmdxfer_import_stream(argc,argv);
+}
+
+
+static const char cmdxfer_load_longhelp[] PROGMEM =
+  "SYNTAX: load <addr> <num>\r\n"
+  "- receives <num> bytes in binary frames, and writes them to memory at <addr>\r\n"
+  "NOTES:\r\n"
+  "- intended for a host driver (see test/cmd.py), not for a terminal\r\n"
+  "- frame is <seq> <len> <bytes> <crc-lo> <crc-hi>, with CRC-16/CCITT\r\n"
+  "- each frame is answered with 06 <seq> (ok) or 15 <seq> (resend from <seq>)\r\n"
+  "- <num> 0000 means 10000 (the full 64k)\r\n"
+  "- <addr> and <num> is 0000..FFFF, but physical memory is limited and mirrored\r\n"
+;
+
+
+static const char cmdxfer_save_longhelp[] PROGMEM =
+  "SYNTAX: save <addr> <num>\r\n"
+  "- reads <num> bytes from memory at <addr>, and sends them in binary frames\r\n"
+  "NOTES:\r\n"
+  "- intended for a host driver (see test/cmd.py), not for a terminal\r\n"
+  "- frame is <seq> <len> <bytes> <crc-lo> <crc-hi>, with CRC-16/CCITT\r\n"
+  "- each frame must be answered with 06 <seq> (ok) or 15 <seq> (resend from <seq>)\r\n"
+  "- <num> 0000 means 10000 (the full 64k)\r\n"
+  "- <addr> and <num> is 0000..FFFF, but physical memory is limited and mirrored\r\n"
+;
+
+
+static const char cmdxfer_import_longhelp[] PROGMEM =
+  "SYNTAX: import [<record>]\r\n"
+  "- checks Intel HEX or Motorola S-record <record>, and writes its data to memory\r\n"
+  "- if <record> is absent, starts streaming mode, one record per line\r\n"
+  "- streaming mode ends with an empty line, or with an end record\r\n"
+  "NOTES:\r\n"
+  "- Intel HEX: types 00 (data) and 01 (end); 02..05 only for the lower 64k\r\n"
+  "- S-record: S1 (data) and S9 (end); S0, S5 and S6 are ignored\r\n"
+  "- records with a bad length or checksum are rejected (and counted)\r\n"
+  "- see 'prog compile hex' and 'prog compile srec' for export\r\n"
+;
+
+
+// Note cmd_register needs all strings to be PROGMEM strings. For the short string we do that inline with PSTR.
+void cmdxfer_register(void) {
+  cmd_register(cmdxfer_load_main, PSTR("load"), PSTR("load memory from host (binary)"), cmdxfer_load_longhelp);
+  cmd_register(cmdxfer_import_main, PSTR("import"), PSTR("import HEX or S-records to memory"), cmdxfer_import_longhelp);
+  cmd_register(cmdxfer_save_main, PSTR("save"), PSTR("save memory to host (binary)"), cmdxfer_save_longhelp);
+}
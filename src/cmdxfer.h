@@ -0,0 +1,16 @@
+// cmdxfer.h - commands (load, save and import) for bulk transfer of memory
+#ifndef __CMDXFER_H__
+#define __CMDXFER_H__
+
+
+// The context is expected to implement
+#include <stdint.h>
+extern uint8_t mem_read(uint16_t addr);
+extern void    mem_write(uint16_t addr, uint8_t data);
+
+
+// This module implements three commands: load, save and import
+void cmdxfer_register(void);
+
+
+#endif
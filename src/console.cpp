@@ -0,0 +1,53 @@
+// console.cpp - memory mapped console device (buffered output, so that programs can print)
+
+
+#include <Arduino.h>
+#include "cpu.h"
+#include "console.h"
+
+
+void console_init(console_t * con, uint16_t addr, void (*out)(const uint8_t * buf, uint16_t len)) {
+  con->addr= addr;
+  con->out= out;
+  con->txlen= 0;
+  con->rxpos= 0;
+  con->rxlen= 0;
+  cpu_page_set(addr>>8, cpu_page_get(addr>>8) | CPU_PAGE_IO);
+}
+
+
+bool console_at(const console_t * con, uint16_t addr) {
+  return (uint16_t)(addr-con->addr) <= CONSOLE_STATUS;
+}
+
+
+uint8_t console_read(console_t * con, uint16_t addr) {
+  if( addr-con->addr==CONSOLE_STATUS ) return CONSOLE_TXRDY | (con->rxlen>0 ? CONSOLE_RXRDY : 0);
+  if( con->rxlen==0 ) return 0;
+  uint8_t data= con->rx[con->rxpos];
+  con->rxpos= (con->rxpos+1) % CONSOLE_RXSIZE;
+  con->rxlen--;
+  return data;
+}
+
+
+void console_write(console_t * con, uint16_t addr, uint8_t data) {
+  if( addr-con->addr!=CONSOLE_DATA ) return; // status is read only
+  if( con->txlen==CONSOLE_TXSIZE ) console_flush(con);
+  con->tx[con->txlen++]= data;
+}
+
+
+void console_flush(console_t * con) {
+  if( con->txlen==0 ) return;
+  if( con->out ) con->out(con->tx, con->txlen); else Serial.write(con->tx, con->txlen);
+  con->txlen= 0;
+}
+
+
+bool console_rx(console_t * con, uint8_t data) {
+  if( con->rxlen==CONSOLE_RXSIZE ) return false;
+  con->rx[(con->rxpos+con->rxlen) % CONSOLE_RXSIZE]= data;
+  con->rxlen++;
+  return true;
+}
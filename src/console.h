@@ -0,0 +1,53 @@
+// console.h - memory mapped console device (buffered output, so that programs can print)
+#ifndef __CONSOLE_H__
+#define __CONSOLE_H__
+
+
+#include <stdint.h>
+
+
+// The console has two registers: data (at `addr`) and status (at `addr+1`).
+// Writing data queues a byte for output. The queue is written out in blocks: when it is full, and
+// when the context calls console_flush() (e.g. between bursts of execution, or from loop()).
+// So a program can print at full emulation speed; the host does not wait on each byte.
+// Reading data takes the oldest received byte (0 when there is none); the context supplies received
+// bytes with console_rx(). console_init() marks the page of `addr` as I/O in the cpu page table, so
+// the monitor commands (read, dasm, regs) do not read it. The context routes accesses to the two
+// registers, from mem_read() and mem_write(), to console_read() and console_write().
+#define CONSOLE_DATA   0 // Register offset of data
+#define CONSOLE_STATUS 1 // Register offset of status (read only)
+
+
+#define CONSOLE_RXRDY  0x01 // Status bit: a received byte is available
+#define CONSOLE_TXRDY  0x02 // Status bit: a byte can be written (always set; a full queue is written out)
+
+
+#ifdef __AVR__
+#define CONSOLE_TXSIZE   32 // Size of the output queue
+#define CONSOLE_RXSIZE    4 // Size of the input queue
+#else
+#define CONSOLE_TXSIZE 4096
+#define CONSOLE_RXSIZE   64
+#endif
+
+
+typedef struct console_s {
+  uint16_t addr;                                  // Address of the data register
+  void (*out)(const uint8_t * buf, uint16_t len); // Writes out a block (Serial when 0)
+  uint8_t  tx[CONSOLE_TXSIZE];                    // Output queue
+  uint16_t txlen;
+  uint8_t  rx[CONSOLE_RXSIZE];                    // Input queue (ring)
+  uint8_t  rxpos;
+  uint8_t  rxlen;
+} console_t;
+
+
+void    console_init (console_t * con, uint16_t addr, void (*out)(const uint8_t * buf, uint16_t len)); // Initializes `con` at `addr`; `out` writes blocks (0 for Serial)
+bool    console_at   (const console_t * con, uint16_t addr); // Returns true when `addr` is one of the registers of `con`
+uint8_t console_read (console_t * con, uint16_t addr);               // Reads the register at `addr`
+void    console_write(console_t * con, uint16_t addr, uint8_t data); // Writes the register at `addr`
+void    console_flush(console_t * con);                              // Writes out the output queue
+bool    console_rx   (console_t * con, uint8_t data);                // Adds a received byte; returns false when the input queue is full
+
+
+#endif
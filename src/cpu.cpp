@@ -0,0 +1,716 @@
+// cpu.cpp - execution engine for the 6502 (interpreter driven by the isa tables)
+
+
+#include <Arduino.h>
+#include "isa.h"
+#include "cpu.h"
+#include "cpurec.h"
+#include "cputrace.h"
+#include "cpusched.h"
+#include "cpurecomp.h"
+
+
+// The flags that are evaluated lazily (the others, D, I and B, are always stored in `p`)
+#define CPU_FLAGS_LAZY (ISA_FLAG_N|ISA_FLAG_V|ISA_FLAG_Z|ISA_FLAG_C)
+// Bit 5 of the status register is not used; it reads as 1
+#define CPU_FLAG_1 0x20
+
+
+// Evaluates the lazy flags in `mask` and stores them in `cpu->p`
+static void cpu_flags(cpu_t * cpu, uint8_t mask) {
+  mask&= cpu->lazy;
+  if( mask==0 ) return;
+  uint8_t p= cpu->p & ~mask;
+  if( (mask & ISA_FLAG_N) && (cpu->lz_n & 0x80) ) p|= ISA_FLAG_N;
+  if( (mask & ISA_FLAG_V) && ((cpu->lz_v1^cpu->lz_vr) & (cpu->lz_v2^cpu->lz_vr) & 0x80) ) p|= ISA_FLAG_V;
+  if( (mask & ISA_FLAG_Z) && cpu->lz_z==0 ) p|= ISA_FLAG_Z;
+  if( (mask & ISA_FLAG_C) && (cpu->lz_c & 0x100) ) p|= ISA_FLAG_C;
+  cpu->p= p;
+  cpu->lazy&= ~mask;
+}
+
+
+uint8_t cpu_status(cpu_t * cpu) {
+  cpu_flags(cpu,CPU_FLAGS_LAZY);
+  return cpu->p | CPU_FLAG_1;
+}
+
+
+void cpu_status_set(cpu_t * cpu, uint8_t p) {
+  cpu->p= p | CPU_FLAG_1;
+  cpu->lazy= 0;
+}
+
+
+// While replaying, the interrupts come from the log, not from the context
+void cpu_irq(cpu_t * cpu, bool level) {
+  if( cpu->rec && cpurec_event(cpu, level ? CPUREC_EV_IRQ1 : CPUREC_EV_IRQ0) ) return;
+  cpu->irq= level;
+}
+
+
+void cpu_nmi(cpu_t * cpu) {
+  if( cpu->rec && cpurec_event(cpu, CPUREC_EV_NMI) ) return;
+  cpu->nmi= 1;
+}
+
+
+// The memory page table (attributes per page)
+static uint8_t cpu_pages[256];
+
+
+void cpu_page_set(uint8_t page, uint8_t attr) {
+  cpu_pages[page]= (cpu_pages[page] & (CPU_PAGE_BREAK|CPU_PAGE_WATCH|CPU_PAGE_CODE)) | (attr & ~(CPU_PAGE_BREAK|CPU_PAGE_WATCH|CPU_PAGE_CODE));
+}
+
+
+void cpu_page_code(uint8_t page, bool on) {
+  if( on ) cpu_pages[page]|= CPU_PAGE_CODE; else cpu_pages[page]&= ~CPU_PAGE_CODE;
+}
+
+
+uint8_t cpu_page_get(uint8_t page) {
+  return cpu_pages[page];
+}
+
+
+// Breakpoints: a bit map on targets with enough RAM, a list on AVR
+#if CPU_BREAK_NUM
+static uint16_t cpu_breaks[CPU_BREAK_NUM];
+static uint8_t  cpu_breaks_num;
+#else
+static uint8_t  cpu_breaks[0x10000/8];
+#endif
+
+
+bool cpu_break_get(uint16_t addr) {
+  if( !(cpu_pages[addr>>8] & CPU_PAGE_BREAK) ) return false;
+  #if CPU_BREAK_NUM
+  for( uint8_t i=0; i<cpu_breaks_num; i++ ) if( cpu_breaks[i]==addr ) return true;
+  return false;
+  #else
+  return cpu_breaks[addr/8] & (1<<(addr%8));
+  #endif
+}
+
+
+bool cpu_break_set(uint16_t addr, bool on) {
+  if( cpu_break_get(addr)==on ) return true;
+  uint8_t page= addr>>8;
+  bool inpage= false; // page has other breakpoints
+  #if CPU_BREAK_NUM
+  if( on ) {
+    if( cpu_breaks_num==CPU_BREAK_NUM ) return false;
+    cpu_breaks[cpu_breaks_num++]= addr;
+  } else {
+    for( uint8_t i=0; i<cpu_breaks_num; i++ ) if( cpu_breaks[i]==addr ) { cpu_breaks[i]= cpu_breaks[--cpu_breaks_num]; break; }
+  }
+  for( uint8_t i=0; i<cpu_breaks_num; i++ ) if( (cpu_breaks[i]>>8)==page ) inpage= true;
+  #else
+  if( on ) cpu_breaks[addr/8]|= 1<<(addr%8); else cpu_breaks[addr/8]&= ~(1<<(addr%8));
+  for( uint8_t i=0; i<256/8; i++ ) if( cpu_breaks[page*(256/8)+i] ) inpage= true;
+  #endif
+  if( inpage ) cpu_pages[page]|= CPU_PAGE_BREAK; else cpu_pages[page]&= ~CPU_PAGE_BREAK;
+  return true;
+}
+
+
+// Watchpoints: a list
+static uint16_t cpu_watches[CPU_WATCH_NUM];
+static uint8_t  cpu_watches_mode[CPU_WATCH_NUM];
+static uint8_t  cpu_watches_num;
+
+
+uint8_t cpu_watch_get(uint16_t addr) {
+  if( !(cpu_pages[addr>>8] & CPU_PAGE_WATCH) ) return 0;
+  for( uint8_t i=0; i<cpu_watches_num; i++ ) if( cpu_watches[i]==addr ) return cpu_watches_mode[i];
+  return 0;
+}
+
+
+bool cpu_watch_set(uint16_t addr, uint8_t mode) {
+  uint8_t i;
+  for( i=0; i<cpu_watches_num; i++ ) if( cpu_watches[i]==addr ) break;
+  if( i==cpu_watches_num ) {
+    if( mode==0 ) return true;
+    if( cpu_watches_num==CPU_WATCH_NUM ) return false;
+    cpu_watches[cpu_watches_num++]= addr;
+  }
+  cpu_watches_mode[i]= mode;
+  if( mode==0 ) { cpu_watches_num--; cpu_watches[i]= cpu_watches[cpu_watches_num]; cpu_watches_mode[i]= cpu_watches_mode[cpu_watches_num]; }
+  uint8_t page= addr>>8;
+  cpu_pages[page]&= ~CPU_PAGE_WATCH;
+  for( i=0; i<cpu_watches_num; i++ ) if( (cpu_watches[i]>>8)==page ) cpu_pages[page]|= CPU_PAGE_WATCH;
+  return true;
+}
+
+
+// Records a stop when `addr` is watched for an access of type `mode`
+static void cpu_watch_check(cpu_t * cpu, uint16_t addr, uint8_t mode) {
+  if( cpu_watch_get(addr) & mode ) { cpu->stop= CPU_STOP_WATCH; cpu->watch= addr; }
+}
+
+
+// Profiler: instruction counts followed by cycle totals, per bucket of CPU_PROF_BUCKET addresses.
+// Allocated when the profiler is started for the first time; on AVR the counters are 16 bits (and saturate).
+#ifdef __AVR__
+typedef uint16_t cpu_prof_t;
+#else
+typedef uint32_t cpu_prof_t;
+#endif
+#define CPU_PROF_NUM (0x10000L/CPU_PROF_BUCKET) // Number of buckets
+static cpu_prof_t * cpu_prof_data; // CPU_PROF_NUM counts, then CPU_PROF_NUM cycle totals
+static bool         cpu_prof_on;
+static uint8_t      cpu_prof_tick; // Instructions since the last sample
+#if CPU_PROF_PAIRS
+static uint32_t   * cpu_prof_pairs; // Count per pair of opcodes (first opcode in the high byte of the index)
+static uint16_t     cpu_prof_prev;  // Opcode of the previous instruction, CPU_PROF_NOPREV after an interrupt entry
+#define CPU_PROF_NOPREV 0x100
+#endif
+
+
+bool cpu_prof_start(void) {
+  if( cpu_prof_data==0 ) cpu_prof_data= (cpu_prof_t *)malloc(2*CPU_PROF_NUM*sizeof(cpu_prof_t));
+  if( cpu_prof_data==0 ) return false;
+  #if CPU_PROF_PAIRS
+  if( cpu_prof_pairs==0 ) cpu_prof_pairs= (uint32_t *)malloc(0x10000L*sizeof(uint32_t));
+  if( cpu_prof_pairs==0 ) return false;
+  memset(cpu_prof_pairs, 0, 0x10000L*sizeof(uint32_t));
+  cpu_prof_prev= CPU_PROF_NOPREV;
+  #endif
+  memset(cpu_prof_data, 0, 2*CPU_PROF_NUM*sizeof(cpu_prof_t));
+  cpu_prof_tick= 0;
+  cpu_prof_on= true;
+  return true;
+}
+
+
+void cpu_prof_stop(bool release) {
+  cpu_prof_on= false;
+  if( release ) { free(cpu_prof_data); cpu_prof_data= 0; }
+  #if CPU_PROF_PAIRS
+  if( release ) { free(cpu_prof_pairs); cpu_prof_pairs= 0; }
+  #endif
+}
+
+
+bool cpu_prof_active(void) {
+  return cpu_prof_on;
+}
+
+
+bool cpu_prof_get(uint16_t addr, uint32_t * count, uint32_t * cycles) {
+  if( cpu_prof_data==0 ) return false;
+  uint16_t b= addr/CPU_PROF_BUCKET;
+  *count= (uint32_t)cpu_prof_data[b]*CPU_PROF_SAMPLE;
+  *cycles= (uint32_t)cpu_prof_data[CPU_PROF_NUM+b]*CPU_PROF_SAMPLE;
+  return true;
+}
+
+
+bool cpu_prof_pair(uint8_t op1, uint8_t op2, uint32_t * count) {
+  #if CPU_PROF_PAIRS
+  if( cpu_prof_pairs==0 ) return false;
+  *count= cpu_prof_pairs[(op1<<8) | op2];
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+
+// Adds an instruction at `pc` with `opcode` that took `cycles` to the profile (only one in CPU_PROF_SAMPLE is added)
+static void cpu_prof_add(uint16_t pc, uint8_t opcode, uint8_t cycles) {
+  #if CPU_PROF_PAIRS
+  if( cpu_prof_prev!=CPU_PROF_NOPREV ) cpu_prof_pairs[(cpu_prof_prev<<8) | opcode]++;
+  cpu_prof_prev= opcode;
+  #endif
+  #if CPU_PROF_SAMPLE>1
+  if( ++cpu_prof_tick<CPU_PROF_SAMPLE ) return;
+  cpu_prof_tick= 0;
+  #endif
+  uint16_t b= pc/CPU_PROF_BUCKET;
+  cpu_prof_t * count= &cpu_prof_data[b];
+  cpu_prof_t * total= &cpu_prof_data[CPU_PROF_NUM+b];
+  if( *count!=(cpu_prof_t)~0 ) *count+= 1;
+  *total= *total>(cpu_prof_t)(~(cpu_prof_t)0-cycles) ? (cpu_prof_t)~0 : *total+cycles;
+}
+
+
+// An interrupt entry separates the instructions before and after it (they are not counted as a pair)
+static void cpu_prof_break(void) {
+  #if CPU_PROF_PAIRS
+  cpu_prof_prev= CPU_PROF_NOPREV;
+  #endif
+}
+
+
+// Reads `addr` (instruction bytes, pointers, stack); reads from I/O pages go via the record/replay log (if any)
+static uint8_t cpu_read(cpu_t * cpu, uint16_t addr) {
+  if( (cpu_pages[addr>>8] & CPU_PAGE_IO) && cpu->rec ) return cpurec_ioread(cpu, addr);
+  return mem_read(addr);
+}
+
+
+// Reads data at `addr` (the operand of an instruction); this is where read watchpoints are checked
+static uint8_t cpu_read_data(cpu_t * cpu, uint16_t addr) {
+  if( cpu_pages[addr>>8] & (CPU_PAGE_IO|CPU_PAGE_WATCH) ) {
+    cpu_watch_check(cpu, addr, CPU_WATCH_R);
+    return cpu_read(cpu,addr);
+  }
+  return mem_read(addr);
+}
+
+
+// Writes `data` to `addr`; this is where write watchpoints are checked, and where stores to cached code are detected
+static void cpu_write(cpu_t * cpu, uint16_t addr, uint8_t data) {
+  uint8_t attr= cpu_pages[addr>>8];
+  if( attr & (CPU_PAGE_WATCH|CPU_PAGE_CODE) ) {
+    if( attr & CPU_PAGE_WATCH ) cpu_watch_check(cpu, addr, CPU_WATCH_W);
+    mem_write(addr,data);
+    if( attr & CPU_PAGE_CODE ) cpurecomp_hit(addr);
+    return;
+  }
+  mem_write(addr,data);
+}
+
+
+// Reads a 16 bit little endian word from memory at `addr`
+static uint16_t cpu_read16(cpu_t * cpu, uint16_t addr) {
+  return cpu_read(cpu,addr) | (cpu_read(cpu,addr+1)<<8);
+}
+
+
+// Pushes `data` on the stack (page 1)
+static void cpu_push(cpu_t * cpu, uint8_t data) {
+  cpu_write(cpu, 0x0100|cpu->sp, data);
+  cpu->sp--;
+}
+
+
+// Pulls a byte from the stack (page 1)
+static uint8_t cpu_pull(cpu_t * cpu) {
+  cpu->sp++;
+  return cpu_read(cpu,0x0100|cpu->sp);
+}
+
+
+// Pushes pc and status, and jumps via `vector`; `brk` determines the B flag in the pushed status
+static void cpu_interrupt(cpu_t * cpu, uint16_t vector, bool brk) {
+  cpu_push(cpu, cpu->pc>>8);
+  cpu_push(cpu, cpu->pc&0xFF);
+  uint8_t p= cpu_status(cpu);
+  cpu_push(cpu, brk ? p|ISA_FLAG_B : p&~ISA_FLAG_B);
+  cpu->p|= ISA_FLAG_I;
+  cpu->pc= cpu_read16(cpu,vector);
+}
+
+
+// Binary add with carry of `m` to the accumulator, also used for SBC (with m inverted).
+// Only stores the operands and the result; N and Z are set by the caller from the accumulator.
+static void cpu_adc(cpu_t * cpu, uint8_t m) {
+  uint16_t s= cpu->a + m + (cpu->p & ISA_FLAG_C);
+  cpu->lz_c= s;
+  cpu->lz_v1= cpu->a;
+  cpu->lz_v2= m;
+  cpu->lz_vr= s;
+  cpu->lazy|= ISA_FLAG_C | ISA_FLAG_V;
+  cpu->a= s;
+}
+
+
+// Decimal mode ADC and SBC are table driven; they cost the same as binary mode.
+// The NMOS 6502 computes the flags in decimal mode as follows
+// - ADC: Z from the binary sum, N and V from the sum after the low nibble adjust, C from the decimal sum
+// - SBC: all flags as for the binary difference
+// The nibble adjust tables are used directly on AVR, and on other targets to fill a table with
+// the result and flags for every (carry, accumulator, operand) combination.
+
+
+// Low nibble adjust for ADC, indexed by (a&0x0F)+(m&0x0F)+c: the decimal digit plus 0x10 for a carry
+static const uint8_t cpu_dec_adc_lo[32] PROGMEM = {
+  0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x10,0x11,0x12,0x13,0x14,0x15,
+  0x16,0x17,0x18,0x19,0x1A,0x1B,0x1C,0x1D,0x1E,0x1F,0x10,0x11,0x12,0x13,0x14,0x15,
+};
+
+
+// Low nibble adjust for SBC, indexed by (a&0x0F)-(m&0x0F)+c-1+16: the decimal digit minus 0x10 for a borrow
+static const int8_t cpu_dec_sbc_lo[32] PROGMEM = {
+   -6, -5, -4, -3, -2, -1,-16,-15,-14,-13,-12,-11,-10, -9, -8, -7,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+};
+
+
+// Decimal add (`sub` false) or subtract (`sub` true) of `m` and carry `c` to/from `a`.
+// Returns the result in the high byte and the flags N, V, Z and C (as in the status register) in the low byte.
+static uint16_t cpu_dec_calc(uint8_t a, uint8_t m, uint8_t c, bool sub) {
+  uint8_t flags= 0;
+  int s;
+  if( sub ) {
+    s= (a&0xF0) - (m&0xF0) + (int8_t)pgm_read_byte(&cpu_dec_sbc_lo[(a&0x0F)-(m&0x0F)+c-1+16]);
+    if( s<0 ) s-= 0x60;
+    uint16_t b= a + (m^0xFF) + c; // binary difference for the flags
+    if( b & 0x80 ) flags|= ISA_FLAG_N;
+    if( (a^b) & (a^m) & 0x80 ) flags|= ISA_FLAG_V;
+    if( (uint8_t)b==0 ) flags|= ISA_FLAG_Z;
+    if( b & 0x100 ) flags|= ISA_FLAG_C;
+  } else {
+    uint8_t lo= pgm_read_byte(&cpu_dec_adc_lo[(a&0x0F)+(m&0x0F)+c]);
+    s= (a&0xF0) + (m&0xF0) + lo;
+    if( s & 0x80 ) flags|= ISA_FLAG_N;
+    if( (a^s) & (m^s) & 0x80 ) flags|= ISA_FLAG_V;
+    if( (uint8_t)(a+m+c)==0 ) flags|= ISA_FLAG_Z;
+    if( s>=0xA0 ) { s+= 0x60; flags|= ISA_FLAG_C; }
+  }
+  return ((uint8_t)s<<8) | flags;
+}
+
+
+#ifndef __AVR__
+// On targets with enough RAM, a table for all (carry, operation, accumulator, operand) combinations (512k bytes).
+// Returns the filled table, or 0 when there is not enough memory (then the nibble adjust tables are used).
+static uint16_t * cpu_dec_make(void) {
+  uint16_t * table= (uint16_t *)malloc(4*0x10000L*sizeof(uint16_t));
+  if( table==0 ) return 0;
+  for( uint32_t i=0; i<4*0x10000L; i++ ) table[i]= cpu_dec_calc(i>>8, i, (i>>16)&1, i>>17);
+  return table;
+}
+
+
+// Returns the decimal table, made on the first call. A function static is initialized exactly once, also when
+// threads (e.g. cpujobs workers) race, and the others wait until it is filled. The table is shared by all cpus,
+// so it is kept for the life of the program.
+static uint16_t * cpu_dec_table(void) {
+  static uint16_t * table= cpu_dec_make();
+  return table;
+}
+#endif
+
+
+uint16_t cpu_decimal(uint8_t a, uint8_t m, uint8_t c, bool sub) {
+  #ifndef __AVR__
+  uint16_t * table= cpu_dec_table();
+  if( table ) return table[ ((uint32_t)sub<<17) | ((uint32_t)c<<16) | (a<<8) | m ];
+  #endif
+  return cpu_dec_calc(a, m, c, sub);
+}
+
+
+// Decimal add (`sub` false) or subtract (`sub` true) of `m` to/from the accumulator.
+// Sets all lazy flags (they are stored in `p`, not lazy).
+static void cpu_dec(cpu_t * cpu, uint8_t m, bool sub) {
+  uint16_t rf= cpu_decimal(cpu->a, m, cpu->p & ISA_FLAG_C, sub);
+  cpu->a= rf>>8;
+  cpu->p= (cpu->p & ~CPU_FLAGS_LAZY) | (rf & 0xFF);
+  cpu->lazy= 0;
+}
+
+
+// The opcodes that start a pair in the fusion table (a bit per opcode), so that cpu_run() rejects most opcodes at once
+static uint8_t cpu_fuse_firsts[256/8];
+static bool    cpu_fuse_filled;
+
+
+// Fills cpu_fuse_firsts (once)
+static void cpu_fuse_init(void) {
+  if( cpu_fuse_filled ) return;
+  for( uint16_t op1=0; op1<256; op1++ )
+    for( uint16_t op2=0; op2<256; op2++ )
+      if( isa_opcode_fuse(op1,op2) ) cpu_fuse_firsts[op1/8]|= 1<<(op1%8);
+  cpu_fuse_filled= true;
+}
+
+
+void cpu_reset(cpu_t * cpu) {
+  #ifndef __AVR__
+  cpu_dec_table(); // make it now, rather than at the first decimal instruction
+  #endif
+  cpu_fuse_init();
+  cpu->a= 0;
+  cpu->x= 0;
+  cpu->y= 0;
+  cpu->sp= 0xFD;
+  cpu_status_set(cpu,ISA_FLAG_I);
+  cpu->irq= 0;
+  cpu->nmi= 0;
+  cpu->cycles= 0;
+  cpu->rec= 0;
+  cpu->trace= 0;
+  cpu->sched= 0;
+  cpu->stop= CPU_STOP_NONE;
+  cpu->pc= cpu_read16(cpu,0xFFFC);
+}
+
+
+uint8_t cpu_step(cpu_t * cpu) {
+  // A stop is reported once; stepping again resumes (also over the breakpoint at pc)
+  uint8_t resume= cpu->stop;
+  cpu->stop= CPU_STOP_NONE;
+
+  // Events of devices (a single compare when none is due)
+  if( cpu->sched && (int32_t)(cpu->cycles-cpu->sched->next)>=0 ) cpusched_run(cpu->sched,cpu);
+
+  // Interrupts (when replaying, first deliver the ones due from the log)
+  if( cpu->rec ) cpurec_due(cpu);
+  if( cpu->nmi ) {
+    cpu->nmi= 0;
+    cpu_interrupt(cpu,0xFFFA,false);
+    cpu_prof_break();
+    cpu->cycles+= 7;
+    return 7;
+  }
+  if( cpu->irq && !(cpu->p & ISA_FLAG_I) ) {
+    cpu_interrupt(cpu,0xFFFE,false);
+    cpu_prof_break();
+    cpu->cycles+= 7;
+    return 7;
+  }
+
+  // Decode
+  uint16_t pc= cpu->pc;
+  if( (cpu_pages[pc>>8] & CPU_PAGE_BREAK) && resume!=CPU_STOP_BREAK && cpu_break_get(pc) ) { cpu->stop= CPU_STOP_BREAK; return 0; }
+  uint8_t opcode= cpu_read(cpu,pc);
+  uint8_t iix= isa_opcode_iix(opcode);
+  if( iix==0 ) return 0; // opcode not in use
+  if( cpu->trace ) cputrace_put(cpu->trace,cpu,opcode);
+  uint8_t aix= isa_opcode_aix(opcode);
+
+  // Effective address (memory is only read for the operand bytes, not for the data itself)
+  uint16_t ea= 0;
+  uint16_t base= 0; // for the indexed modes: address before indexing (to detect page crossing)
+  switch( aix ) {
+    case ISA_AIX_IMP : break;
+    case ISA_AIX_ACC : break;
+    case ISA_AIX_IMM : ea= pc+1; break;
+    case ISA_AIX_ZPG : ea= cpu_read(cpu,pc+1); break;
+    case ISA_AIX_ZPX : ea= (uint8_t)(cpu_read(cpu,pc+1)+cpu->x); break;
+    case ISA_AIX_ZPY : ea= (uint8_t)(cpu_read(cpu,pc+1)+cpu->y); break;
+    case ISA_AIX_ABS : ea= cpu_read16(cpu,pc+1); break;
+    case ISA_AIX_ABX : base= cpu_read16(cpu,pc+1); ea= base+cpu->x; break;
+    case ISA_AIX_ABY : base= cpu_read16(cpu,pc+1); ea= base+cpu->y; break;
+    case ISA_AIX_ZXI : { uint8_t zp= cpu_read(cpu,pc+1)+cpu->x; ea= cpu_read(cpu,zp) | (cpu_read(cpu,(uint8_t)(zp+1))<<8); break; }
+    case ISA_AIX_ZIY : { uint8_t zp= cpu_read(cpu,pc+1); base= cpu_read(cpu,zp) | (cpu_read(cpu,(uint8_t)(zp+1))<<8); ea= base+cpu->y; break; }
+    case ISA_AIX_IND : { uint16_t ptr= cpu_read16(cpu,pc+1); ea= cpu_read(cpu,ptr) | (cpu_read(cpu,(ptr&0xFF00)|((ptr+1)&0x00FF))<<8); break; } // NMOS does not cross page
+    case ISA_AIX_REL : ea= pc+2+(int8_t)cpu_read(cpu,pc+1); break;
+  }
+  cpu->pc= pc + isa_opcode_bytes(opcode);
+
+  // Evaluate the lazy flags this instruction reads
+  uint8_t reads= isa_instruction_freads(iix);
+  if( reads & cpu->lazy ) cpu_flags(cpu,reads);
+
+  // Execute; most instructions set N and Z from `res` (as listed in isa_instruction_fwrites)
+  uint8_t nz= isa_instruction_fwrites(iix) & (ISA_FLAG_N|ISA_FLAG_Z);
+  uint8_t res= 0;
+  bool taken= false; // for branches
+  #define M    (aix==ISA_AIX_ACC ? cpu->a : cpu_read_data(cpu,ea))
+  #define W(v) do { if( aix==ISA_AIX_ACC ) cpu->a= (v); else cpu_write(cpu,ea,(v)); } while(0)
+  switch( iix ) {
+    case ISA_IIX_ADC : { uint8_t m= M; if( cpu->p & ISA_FLAG_D ) { cpu_dec(cpu,m,false); nz= 0; } else cpu_adc(cpu,m); res= cpu->a; break; }
+    case ISA_IIX_SBC : { uint8_t m= M; if( cpu->p & ISA_FLAG_D ) { cpu_dec(cpu,m,true); nz= 0; } else cpu_adc(cpu,m^0xFF); res= cpu->a; break; }
+    case ISA_IIX_AND : res= cpu->a&= M; break;
+    case ISA_IIX_ORA : res= cpu->a|= M; break;
+    case ISA_IIX_EOR : res= cpu->a^= M; break;
+    case ISA_IIX_ASL : { uint8_t m= M; cpu->lz_c= m<<1;                 res= m<<1;                              cpu->lazy|= ISA_FLAG_C; W(res); break; }
+    case ISA_IIX_LSR : { uint8_t m= M; cpu->lz_c= (m&1)<<8;             res= m>>1;                              cpu->lazy|= ISA_FLAG_C; W(res); break; }
+    case ISA_IIX_ROL : { uint8_t m= M; cpu->lz_c= m<<1;                 res= (m<<1) | (cpu->p&ISA_FLAG_C);      cpu->lazy|= ISA_FLAG_C; W(res); break; }
+    case ISA_IIX_ROR : { uint8_t m= M; cpu->lz_c= (m&1)<<8;             res= (m>>1) | ((cpu->p&ISA_FLAG_C)<<7); cpu->lazy|= ISA_FLAG_C; W(res); break; }
+    case ISA_IIX_BIT : { uint8_t m= M; cpu->lz_z= cpu->a & m; cpu->lz_n= m; cpu->lz_v1= cpu->lz_v2= (m<<1)&0x80; cpu->lz_vr= 0; cpu->lazy|= ISA_FLAG_N|ISA_FLAG_V|ISA_FLAG_Z; nz= 0; break; }
+    case ISA_IIX_CMP : cpu->lz_c= cpu->a + (M^0xFF) + 1; res= cpu->lz_c; cpu->lazy|= ISA_FLAG_C; break;
+    case ISA_IIX_CPX : cpu->lz_c= cpu->x + (M^0xFF) + 1; res= cpu->lz_c; cpu->lazy|= ISA_FLAG_C; break;
+    case ISA_IIX_CPY : cpu->lz_c= cpu->y + (M^0xFF) + 1; res= cpu->lz_c; cpu->lazy|= ISA_FLAG_C; break;
+    case ISA_IIX_DEC : res= cpu_read_data(cpu,ea)-1; cpu_write(cpu,ea,res); break;
+    case ISA_IIX_INC : res= cpu_read_data(cpu,ea)+1; cpu_write(cpu,ea,res); break;
+    case ISA_IIX_DEX : res= --cpu->x; break;
+    case ISA_IIX_DEY : res= --cpu->y; break;
+    case ISA_IIX_INX : res= ++cpu->x; break;
+    case ISA_IIX_INY : res= ++cpu->y; break;
+    case ISA_IIX_LDA : res= cpu->a= M; break;
+    case ISA_IIX_LDX : res= cpu->x= M; break;
+    case ISA_IIX_LDY : res= cpu->y= M; break;
+    case ISA_IIX_STA : cpu_write(cpu,ea,cpu->a); break;
+    case ISA_IIX_STX : cpu_write(cpu,ea,cpu->x); break;
+    case ISA_IIX_STY : cpu_write(cpu,ea,cpu->y); break;
+    case ISA_IIX_TAX : res= cpu->x= cpu->a; break;
+    case ISA_IIX_TAY : res= cpu->y= cpu->a; break;
+    case ISA_IIX_TSX : res= cpu->x= cpu->sp; break;
+    case ISA_IIX_TXA : res= cpu->a= cpu->x; break;
+    case ISA_IIX_TYA : res= cpu->a= cpu->y; break;
+    case ISA_IIX_TXS : cpu->sp= cpu->x; break;
+    case ISA_IIX_PHA : cpu_push(cpu,cpu->a); break;
+    case ISA_IIX_PHP : cpu_push(cpu,cpu->p|ISA_FLAG_B|CPU_FLAG_1); break; // all flags were evaluated (freads)
+    case ISA_IIX_PLA : res= cpu->a= cpu_pull(cpu); break;
+    case ISA_IIX_PLP : cpu_status_set(cpu,cpu_pull(cpu)&~ISA_FLAG_B); nz= 0; break;
+    case ISA_IIX_CLC : cpu->p&= ~ISA_FLAG_C; cpu->lazy&= ~ISA_FLAG_C; break;
+    case ISA_IIX_SEC : cpu->p|=  ISA_FLAG_C; cpu->lazy&= ~ISA_FLAG_C; break;
+    case ISA_IIX_CLV : cpu->p&= ~ISA_FLAG_V; cpu->lazy&= ~ISA_FLAG_V; break;
+    case ISA_IIX_CLD : cpu->p&= ~ISA_FLAG_D; break;
+    case ISA_IIX_SED : cpu->p|=  ISA_FLAG_D; break;
+    case ISA_IIX_CLI : cpu->p&= ~ISA_FLAG_I; break;
+    case ISA_IIX_SEI : cpu->p|=  ISA_FLAG_I; break;
+    case ISA_IIX_BCC : taken= !(cpu->p & ISA_FLAG_C); break;
+    case ISA_IIX_BCS : taken=  (cpu->p & ISA_FLAG_C); break;
+    case ISA_IIX_BNE : taken= !(cpu->p & ISA_FLAG_Z); break;
+    case ISA_IIX_BEQ : taken=  (cpu->p & ISA_FLAG_Z); break;
+    case ISA_IIX_BPL : taken= !(cpu->p & ISA_FLAG_N); break;
+    case ISA_IIX_BMI : taken=  (cpu->p & ISA_FLAG_N); break;
+    case ISA_IIX_BVC : taken= !(cpu->p & ISA_FLAG_V); break;
+    case ISA_IIX_BVS : taken=  (cpu->p & ISA_FLAG_V); break;
+    case ISA_IIX_JMP : cpu->pc= ea; break;
+    case ISA_IIX_JSR : cpu_push(cpu,(cpu->pc-1)>>8); cpu_push(cpu,(cpu->pc-1)&0xFF); cpu->pc= ea; break;
+    case ISA_IIX_RTS : { uint8_t lo= cpu_pull(cpu); cpu->pc= (lo | (cpu_pull(cpu)<<8)) + 1; break; }
+    case ISA_IIX_RTI : { cpu_status_set(cpu,cpu_pull(cpu)&~ISA_FLAG_B); uint8_t lo= cpu_pull(cpu); cpu->pc= lo | (cpu_pull(cpu)<<8); nz= 0; break; }
+    case ISA_IIX_BRK : cpu->pc++; cpu_interrupt(cpu,0xFFFE,true); break; // BRK has a padding byte
+    case ISA_IIX_NOP : break;
+  }
+  #undef M
+  #undef W
+  if( nz ) { cpu->lz_n= res; cpu->lz_z= res; cpu->lazy|= nz; }
+  if( taken ) cpu->pc= ea;
+  // Page crossings (when reading with an indexed mode) and taken branches cost extra cycles
+  uint8_t cycles= isa_cycles_exact(opcode,pc,base,ea,taken);
+  if( cpu_prof_on ) cpu_prof_add(pc,opcode,cycles);
+  cpu->cycles+= cycles;
+  return cycles;
+}
+
+
+// Returns the register that instruction `iix` loads, stores, counts or compares (A, X or Y)
+static uint8_t * cpu_fused_reg(cpu_t * cpu, uint8_t iix) {
+  switch( iix ) {
+    case ISA_IIX_LDX : case ISA_IIX_STX : case ISA_IIX_INX : case ISA_IIX_DEX : case ISA_IIX_CPX : return &cpu->x;
+    case ISA_IIX_LDY : case ISA_IIX_STY : case ISA_IIX_INY : case ISA_IIX_DEY : case ISA_IIX_CPY : return &cpu->y;
+  }
+  return &cpu->a;
+}
+
+
+// Returns the operand of the instruction at `pc` with `opcode` (the fused classes only have IMM, ZPG and ABS)
+static uint8_t cpu_fused_operand(cpu_t * cpu, uint16_t pc, uint8_t opcode) {
+  switch( isa_opcode_aix(opcode) ) {
+    case ISA_AIX_IMM : return mem_read(pc+1);
+    case ISA_AIX_ZPG : return cpu_read_data(cpu,mem_read(pc+1));
+  }
+  return cpu_read_data(cpu,mem_read(pc+1) | (mem_read(pc+2)<<8));
+}
+
+
+// Returns true when the instruction at `pc` with `opcode` reads its operand from an I/O page (a read may change
+// the interrupt lines, e.g. a device that raises its IRQ, so it can not be the first instruction of a pair)
+static bool cpu_fused_io(uint16_t pc, uint8_t opcode) {
+  switch( isa_opcode_aix(opcode) ) {
+    case ISA_AIX_IMM : return false;
+    case ISA_AIX_ZPG : return cpu_pages[0] & CPU_PAGE_IO;
+  }
+  return cpu_pages[mem_read(pc+2)] & CPU_PAGE_IO;
+}
+
+
+// Executes the branch at `pc` with `opcode` given whether it is `taken`; returns its cycles
+static uint8_t cpu_fused_branch(cpu_t * cpu, uint16_t pc, uint8_t opcode, bool taken) {
+  uint16_t ea= pc+2+(int8_t)mem_read(pc+1);
+  if( taken ) cpu->pc= ea;
+  return isa_cycles_exact(opcode,pc,0,ea,taken);
+}
+
+
+// Returns whether the branch with instruction index `iix` is taken, given the result `res` of a count or compare
+static bool cpu_fused_taken(uint8_t iix, uint16_t res) {
+  switch( iix ) {
+    case ISA_IIX_BNE : return (uint8_t)res!=0;
+    case ISA_IIX_BEQ : return (uint8_t)res==0;
+    case ISA_IIX_BPL : return !(res & 0x80);
+    case ISA_IIX_BMI : return res & 0x80;
+    case ISA_IIX_BCC : return !(res & 0x100);
+  }
+  return res & 0x100; // BCS
+}
+
+
+// Executes the pair at pc, opcodes `op1` and `op2`, of class `fuse` (ISA_FUSE_xxx) in one step; returns its cycles.
+// Each handler has the effect of cpu_step() on the two instructions (including the lazy flags).
+// Like there, a device sees the cycle count at the start of the instruction that accesses it; so the count
+// is advanced over op1 before op2 runs (op1 only accesses memory in ISA_FUSE_CMPBRA).
+static uint8_t cpu_fused(cpu_t * cpu, uint8_t fuse, uint8_t op1, uint8_t op2) {
+  uint16_t pc1= cpu->pc;
+  uint16_t pc2= pc1 + isa_opcode_bytes(op1);
+  uint8_t  iix1= isa_opcode_iix(op1);
+  uint8_t  iix2= isa_opcode_iix(op2);
+  uint8_t  cycles1= isa_opcode_cycles(op1);
+  uint8_t  cycles= cycles1 + isa_opcode_cycles(op2);
+  cpu->pc= pc2 + isa_opcode_bytes(op2);
+  if( fuse!=ISA_FUSE_CMPBRA ) cpu->cycles+= cycles1;
+  switch( fuse ) {
+    case ISA_FUSE_LDST : { // LDA/LDX/LDY #imm, then STA/STX/STY zpg or abs
+      uint8_t m= mem_read(pc1+1);
+      *cpu_fused_reg(cpu,iix1)= m;
+      cpu->lz_n= m; cpu->lz_z= m; cpu->lazy|= ISA_FLAG_N|ISA_FLAG_Z;
+      uint16_t ea= isa_opcode_aix(op2)==ISA_AIX_ZPG ? mem_read(pc2+1) : mem_read(pc2+1) | (mem_read(pc2+2)<<8);
+      cpu_write(cpu,ea,*cpu_fused_reg(cpu,iix2));
+      break;
+    }
+    case ISA_FUSE_CARRY : { // CLC or SEC, then ADC or SBC
+      cpu->p= iix1==ISA_IIX_SEC ? cpu->p|ISA_FLAG_C : cpu->p&~ISA_FLAG_C;
+      cpu->lazy&= ~ISA_FLAG_C;
+      uint8_t m= cpu_fused_operand(cpu,pc2,op2);
+      bool sub= iix2==ISA_IIX_SBC;
+      if( cpu->p & ISA_FLAG_D ) { cpu_dec(cpu,m,sub); break; }
+      cpu_adc(cpu,sub ? m^0xFF : m);
+      cpu->lz_n= cpu->a; cpu->lz_z= cpu->a; cpu->lazy|= ISA_FLAG_N|ISA_FLAG_Z;
+      break;
+    }
+    case ISA_FUSE_INCBRA : { // INX/INY/DEX/DEY, then BNE/BEQ/BPL/BMI
+      uint8_t * r= cpu_fused_reg(cpu,iix1);
+      uint8_t res= iix1==ISA_IIX_INX || iix1==ISA_IIX_INY ? ++*r : --*r;
+      cpu->lz_n= res; cpu->lz_z= res; cpu->lazy|= ISA_FLAG_N|ISA_FLAG_Z;
+      cycles= isa_opcode_cycles(op1) + cpu_fused_branch(cpu,pc2,op2,cpu_fused_taken(iix2,res));
+      break;
+    }
+    case ISA_FUSE_INCCMP : { // INX/INY/DEX/DEY, then CMP/CPX/CPY (which sets the flags the count set)
+      uint8_t * r= cpu_fused_reg(cpu,iix1);
+      if( iix1==ISA_IIX_INX || iix1==ISA_IIX_INY ) ++*r; else --*r;
+      uint16_t res= *cpu_fused_reg(cpu,iix2) + (cpu_fused_operand(cpu,pc2,op2)^0xFF) + 1;
+      cpu->lz_c= res; cpu->lz_n= res; cpu->lz_z= res; cpu->lazy|= ISA_FLAG_N|ISA_FLAG_Z|ISA_FLAG_C;
+      break;
+    }
+    case ISA_FUSE_CMPBRA : { // CMP/CPX/CPY, then BNE/BEQ/BCC/BCS/BPL/BMI
+      uint16_t res= *cpu_fused_reg(cpu,iix1) + (cpu_fused_operand(cpu,pc1,op1)^0xFF) + 1;
+      cpu->lz_c= res; cpu->lz_n= res; cpu->lz_z= res; cpu->lazy|= ISA_FLAG_N|ISA_FLAG_Z|ISA_FLAG_C;
+      cpu->cycles+= cycles1;
+      if( cpu->stop!=CPU_STOP_NONE ) { cpu->pc= pc2; cycles= isa_opcode_cycles(op1); break; } // the compare hit a watchpoint
+      cycles= isa_opcode_cycles(op1) + cpu_fused_branch(cpu,pc2,op2,cpu_fused_taken(iix2,res));
+      break;
+    }
+  }
+  cpu->cycles+= cycles-cycles1; // op1 was counted above
+  return cycles;
+}
+
+
+bool cpu_run(cpu_t * cpu, uint32_t end) {
+  // Pairs are only fused when nothing needs to see the instructions one by one
+  bool fuse= cpu->rec==0 && cpu->trace==0 && !cpu_prof_on;
+  while( (int32_t)(cpu->cycles-end)<0 ) {
+    uint16_t pc= cpu->pc;
+    uint8_t  op1= mem_read(pc);
+    if( fuse && (cpu_fuse_firsts[op1/8] & (1<<(op1%8))) ) {
+      uint16_t pc2= pc + isa_opcode_bytes(op1);
+      uint8_t  cls= isa_opcode_fuse(op1,mem_read(pc2));
+      // The checks cpu_step() does before each of the two instructions must pass (the first instruction of a
+      // pair does not change the I flag or the scheduler, and has fixed cycles; only a compare reads memory, and
+      // it is not fused when that is I/O, since the read may change the interrupt lines)
+      uint32_t mid= cpu->cycles + isa_opcode_cycles(op1);
+      if( cls && (int32_t)(mid-end)<0 && !(cpu->sched && (int32_t)(mid-cpu->sched->next)>=0)
+          && !cpu->nmi && !(cpu->irq && !(cpu->p & ISA_FLAG_I))
+          && !((cpu_pages[pc>>8] | cpu_pages[pc2>>8]) & CPU_PAGE_BREAK)
+          && !(cls==ISA_FUSE_CMPBRA && cpu_fused_io(pc,op1)) ) {
+        cpu->stop= CPU_STOP_NONE;
+        cpu_fused(cpu,cls,op1,mem_read(pc2));
+        if( cpu->stop!=CPU_STOP_NONE ) return false;
+        continue;
+      }
+    }
+    if( cpu_step(cpu)==0 || cpu->stop!=CPU_STOP_NONE ) return false;
+  }
+  return true;
+}
@@ -0,0 +1,119 @@
+// cpu.h - execution engine for the 6502 (interpreter driven by the isa tables)
+#ifndef __CPU_H__
+#define __CPU_H__
+
+
+// The context is expected to implement
+#include <stdint.h>
+extern uint8_t mem_read(uint16_t addr);
+extern void    mem_write(uint16_t addr, uint8_t data);
+
+
+// The flags N, V, Z and C are evaluated lazily.
+// An instruction that writes them only stores its result (and operands); the flag is derived from that
+// when an instruction reads it (a branch, PHP, BRK, ADC) or an interrupt pushes the status register.
+// The generated table isa_instruction_freads() tells which flags an instruction reads.
+// The `lazy` field records which flags are currently held in the lz_xxx fields instead of in `p`.
+typedef struct cpu_s {
+  uint16_t pc;     // Program counter
+  uint8_t  a;      // Accumulator
+  uint8_t  x;      // Index register X
+  uint8_t  y;      // Index register Y
+  uint8_t  sp;     // Stack pointer (stack is in page 1)
+  uint8_t  p;      // Status register; for flags in `lazy` the bit in `p` is stale
+  uint8_t  lazy;   // Flags (ISA_FLAG_xxx) that must be derived from the lz_xxx fields
+  uint8_t  lz_n;   // N is bit 7 of lz_n
+  uint8_t  lz_z;   // Z is set when lz_z is 0
+  uint16_t lz_c;   // C is bit 8 of lz_c
+  uint8_t  lz_v1;  // V is bit 7 of (lz_v1^lz_vr)&(lz_v2^lz_vr) - signed overflow of lz_v1+lz_v2
+  uint8_t  lz_v2;
+  uint8_t  lz_vr;
+  uint8_t  irq;    // Level of the IRQ line (serviced when I flag is clear)
+  uint8_t  nmi;    // Pending NMI (edge)
+  uint32_t cycles; // Number of cycles executed since reset
+  struct cpurec_s * rec; // Record or replay log (see cpurec.h), 0 if none
+  struct cputrace_s * trace; // Trace ring (see cputrace.h), 0 if none
+  struct cpusched_s * sched; // Event scheduler (see cpusched.h), 0 if none
+  uint8_t  stop;   // Why the last cpu_step stopped (CPU_STOP_xxx)
+  uint16_t watch;  // The watched address that was accessed (for CPU_STOP_WATCH)
+} cpu_t;
+
+
+// The memory page table has attributes for each page of 256 bytes.
+// Reads from an I/O page are nondeterministic (a device supplies the value); they can be recorded (see cpurec.h).
+// Breakpoints and watchpoints also have a page attribute, so that the cpu only needs to test that attribute.
+// The attributes CPU_PAGE_BREAK and CPU_PAGE_WATCH are maintained by cpu_break_set() and cpu_watch_set().
+// A page with code that is cached in decoded form (the recompiled blocks, see cpurecomp.h) has CPU_PAGE_CODE,
+// maintained via cpu_page_code(); the stores of cpu_step() to such a page go to cpurecomp_hit() as well.
+#define CPU_PAGE_IO    0x01 // Page is I/O
+#define CPU_PAGE_BREAK 0x02 // Page has a breakpoint
+#define CPU_PAGE_WATCH 0x04 // Page has a watchpoint
+#define CPU_PAGE_CODE  0x08 // Page has cached code
+
+
+// On a breakpoint, cpu_step returns 0 before executing the instruction; the next cpu_step executes it.
+// On a watchpoint, cpu_step completes the instruction that accessed the watched address.
+#define CPU_STOP_NONE  0 // No breakpoint or watchpoint hit
+#define CPU_STOP_BREAK 1 // pc is at a breakpoint
+#define CPU_STOP_WATCH 2 // The last instruction accessed watched address `watch`
+
+
+#define CPU_WATCH_R    0x01 // Watch reads (of data, not instruction fetches)
+#define CPU_WATCH_W    0x02 // Watch writes
+#ifdef __AVR__
+#define CPU_BREAK_NUM  8    // Max number of breakpoints (a list; elsewhere a 64k bit map)
+#else
+#define CPU_BREAK_NUM  0
+#endif
+#define CPU_WATCH_NUM  4    // Max number of watchpoints
+
+
+// The profiler counts the executed instructions and their cycles per address (interrupt entries are not counted).
+// On AVR there is no room for that: a bucket is a page, and only one in CPU_PROF_SAMPLE instructions is counted.
+// cpu_prof_get() scales the samples back, so on AVR the counts are estimates.
+#ifdef __AVR__
+#define CPU_PROF_BUCKET 256 // Addresses per profiler bucket
+#define CPU_PROF_SAMPLE  16 // Profiler counts one in CPU_PROF_SAMPLE instructions
+#else
+#define CPU_PROF_BUCKET   1
+#define CPU_PROF_SAMPLE   1
+#endif
+// The profiler also counts pairs of opcodes executed in sequence (for the fusion table, see cpu_run());
+// that takes 256k bytes, so not on AVR.
+#ifdef __AVR__
+#define CPU_PROF_PAIRS    0
+#else
+#define CPU_PROF_PAIRS    1
+#endif
+
+
+void     cpu_reset     (cpu_t * cpu);            // Resets the cpu; pc is loaded from the reset vector at FFFC
+uint8_t  cpu_step      (cpu_t * cpu);            // Executes one instruction (or interrupt entry); returns its cycles, 0 for an opcode not in use (pc is not advanced)
+bool     cpu_run       (cpu_t * cpu, uint32_t end); // Steps until cpu->cycles reaches `end`, fusing pairs (see below); returns false when a step stopped (see cpu->stop)
+uint8_t  cpu_status    (cpu_t * cpu);            // Returns the status register (all lazy flags evaluated)
+void     cpu_status_set(cpu_t * cpu, uint8_t p); // Sets the status register (no flags lazy)
+void     cpu_irq       (cpu_t * cpu, bool level);// Sets the level of the IRQ line
+void     cpu_nmi       (cpu_t * cpu);            // Signals an NMI (edge)
+uint16_t cpu_decimal   (uint8_t a, uint8_t m, uint8_t c, bool sub); // Decimal ADC (SBC when `sub`) of `a` and `m` with carry `c`; returns result<<8 | flags N, V, Z and C
+void     cpu_page_set  (uint8_t page, uint8_t attr); // Sets the attributes (CPU_PAGE_xxx) of memory page `page` (addresses page*256 to page*256+255)
+uint8_t  cpu_page_get  (uint8_t page);   // Returns the attributes (CPU_PAGE_xxx) of memory page `page`
+void     cpu_page_code (uint8_t page, bool on); // Sets (or clears) attribute CPU_PAGE_CODE of memory page `page`
+bool     cpu_break_set (uint16_t addr, bool on);      // Sets (or clears) a breakpoint at `addr`; returns false when there is no room
+bool     cpu_break_get (uint16_t addr);               // Returns true when there is a breakpoint at `addr`
+bool     cpu_watch_set (uint16_t addr, uint8_t mode); // Sets the watch mode (CPU_WATCH_xxx, 0 to clear) of `addr`; returns false when there is no room
+uint8_t  cpu_watch_get (uint16_t addr);               // Returns the watch mode (CPU_WATCH_xxx) of `addr`
+bool     cpu_prof_start (void);        // Clears and starts the profiler; returns false when there is not enough memory
+void     cpu_prof_stop  (bool release); // Stops the profiler; the profile is kept, unless `release` (which frees its memory)
+bool     cpu_prof_active(void);        // Returns true when the profiler is running
+bool     cpu_prof_get   (uint16_t addr, uint32_t * count, uint32_t * cycles); // Gets instructions and cycles of the bucket with `addr`; returns false when there is no profile
+bool     cpu_prof_pair  (uint8_t op1, uint8_t op2, uint32_t * count); // Gets how often `op2` followed `op1`; returns false when there is no (pair) profile
+
+
+// cpu_run() executes the opcode pairs of the fusion table (isa_opcode_fuse(), generated by isa6502.py from
+// the pair counts of the profiler) in one step, by a handler per class of pair (e.g. DEX followed by BNE).
+// It only does so when none of the checks cpu_step() does before the second instruction could trigger: no
+// scheduler event due, no interrupt pending, no breakpoint in the page, no compare reading an I/O page, and no
+// record log, trace ring or profiler. So the cycles, flags and stops are exactly those of two cpu_step() calls.
+
+
+#endif
@@ -0,0 +1,326 @@
+// cpubatch.cpp - runs many independent 6502 instances in lockstep (host only, each instance has 64k memory)
+
+
+#include <Arduino.h>
+#include "isa.h"
+#include "cpu.h"
+#include "cpubatch.h"
+
+
+#ifdef __AVR__
+
+
+// An AVR does not have the memory for even one instance
+bool cpubatch_run(cpubatch_state_t * states, uint8_t * mem, uint16_t n, uint32_t budget) {
+  (void)states; (void)mem; (void)n; (void)budget;
+  return false;
+}
+
+
+#else
+
+
+// Per step, at most this many groups are formed; the remaining instances are stepped one by one
+#define CPUBATCH_GROUPS 4
+
+
+// The run state of an instance
+#define CPUBATCH_RUNNING 0 // Still executing
+#define CPUBATCH_STOPPED 1 // Used its cycle budget
+#define CPUBATCH_HALTED  2 // Reached an opcode not in use
+
+
+// The registers of all instances (structure of arrays), plus work arrays for one group
+typedef struct cpubatch_s {
+  uint16_t   n;
+  uint8_t  * mem;
+  uint16_t * pc;
+  uint8_t  * a;
+  uint8_t  * x;
+  uint8_t  * y;
+  uint8_t  * sp;
+  uint8_t  * p;
+  uint32_t * cycles;
+  uint32_t * steps;
+  uint8_t  * run;   // CPUBATCH_xxx
+  uint8_t  * done;  // Instance executed in the current step
+  uint16_t * lanes; // The instances in the group
+  uint16_t * ea;    // Effective address, per group member
+  uint8_t  * m;     // Operand, per group member
+  uint8_t  * cyc;   // Cycles of the instruction, per group member
+  uint16_t * gpc;   // The registers of the group members (gathered from the arrays above, and scattered back)
+  uint8_t  * ga;
+  uint8_t  * gx;
+  uint8_t  * gy;
+  uint8_t  * gs;
+  uint8_t  * gp;
+} cpubatch_t;
+
+
+// Memory access of instance `lane`
+#define RD(lane,addr)      (b->mem[((uint32_t)(lane)<<16) | (uint16_t)(addr)])
+#define WR(lane,addr,data) (b->mem[((uint32_t)(lane)<<16) | (uint16_t)(addr)]= (data))
+// Sets N and Z in status register `p` from result `r`
+#define NZ(p,r)            ((p)= ((p) & ~(ISA_FLAG_N|ISA_FLAG_Z)) | ((r) & ISA_FLAG_N) | ((r) ? 0 : ISA_FLAG_Z))
+
+
+// Executes the instruction at pc (with opcode `opcode`) for the `cnt` instances in b->lanes
+static void cpubatch_exec(cpubatch_t * b, uint16_t cnt, uint8_t opcode) {
+  uint16_t * lanes= b->lanes;
+  uint16_t * ea= b->ea;
+  uint8_t  * m= b->m;
+  uint8_t  * cyc= b->cyc;
+  uint16_t * pc= b->gpc;
+  uint8_t  * ra= b->ga;
+  uint8_t  * rx= b->gx;
+  uint8_t  * ry= b->gy;
+  uint8_t  * rs= b->gs;
+  uint8_t  * rp= b->gp;
+  uint8_t iix= isa_opcode_iix(opcode);
+  uint8_t aix= isa_opcode_aix(opcode);
+  uint8_t bytes= isa_opcode_bytes(opcode);
+
+  // Gather the registers of the group, so that the loops below run over contiguous arrays
+  for( uint16_t k=0; k<cnt; k++ ) {
+    uint16_t l= lanes[k];
+    pc[k]= b->pc[l]; ra[k]= b->a[l]; rx[k]= b->x[l]; ry[k]= b->y[l]; rs[k]= b->sp[l]; rp[k]= b->p[l];
+  }
+
+  // Effective address (the same decoding as cpu_step, but for all members of the group)
+  for( uint16_t k=0; k<cnt; k++ ) {
+    uint16_t l= lanes[k];
+    uint16_t at= pc[k];
+    uint16_t base= 0;
+    switch( aix ) {
+      case ISA_AIX_IMP : ea[k]= 0; break;
+      case ISA_AIX_ACC : ea[k]= 0; break;
+      case ISA_AIX_IMM : ea[k]= at+1; break;
+      case ISA_AIX_ZPG : ea[k]= RD(l,at+1); break;
+      case ISA_AIX_ZPX : ea[k]= (uint8_t)(RD(l,at+1)+rx[k]); break;
+      case ISA_AIX_ZPY : ea[k]= (uint8_t)(RD(l,at+1)+ry[k]); break;
+      case ISA_AIX_ABS : ea[k]= RD(l,at+1) | (RD(l,at+2)<<8); break;
+      case ISA_AIX_ABX : base= RD(l,at+1) | (RD(l,at+2)<<8); ea[k]= base+rx[k]; break;
+      case ISA_AIX_ABY : base= RD(l,at+1) | (RD(l,at+2)<<8); ea[k]= base+ry[k]; break;
+      case ISA_AIX_ZXI : { uint8_t zp= RD(l,at+1)+rx[k]; ea[k]= RD(l,zp) | (RD(l,(uint8_t)(zp+1))<<8); break; }
+      case ISA_AIX_ZIY : { uint8_t zp= RD(l,at+1); base= RD(l,zp) | (RD(l,(uint8_t)(zp+1))<<8); ea[k]= base+ry[k]; break; }
+      case ISA_AIX_IND : { uint16_t ptr= RD(l,at+1) | (RD(l,at+2)<<8); ea[k]= RD(l,ptr) | (RD(l,(ptr&0xFF00)|((ptr+1)&0x00FF))<<8); break; } // NMOS does not cross page
+      case ISA_AIX_REL : ea[k]= at+2+(int8_t)RD(l,at+1); break;
+    }
+    cyc[k]= isa_cycles_exact(opcode,at,base,ea[k],false); // a taken branch is corrected below
+    pc[k]= at+bytes;
+  }
+
+  // Fetch the operand for the instructions that read one
+  switch( iix ) {
+    case ISA_IIX_ADC : case ISA_IIX_SBC : case ISA_IIX_AND : case ISA_IIX_ORA : case ISA_IIX_EOR :
+    case ISA_IIX_ASL : case ISA_IIX_LSR : case ISA_IIX_ROL : case ISA_IIX_ROR : case ISA_IIX_BIT :
+    case ISA_IIX_CMP : case ISA_IIX_CPX : case ISA_IIX_CPY : case ISA_IIX_DEC : case ISA_IIX_INC :
+    case ISA_IIX_LDA : case ISA_IIX_LDX : case ISA_IIX_LDY :
+      if( aix==ISA_AIX_ACC ) for( uint16_t k=0; k<cnt; k++ ) m[k]= ra[k];
+      else                   for( uint16_t k=0; k<cnt; k++ ) m[k]= RD(lanes[k],ea[k]);
+      break;
+  }
+
+  // Execute; the loops without memory access (most ALU operations) are plain loops over the group arrays
+  #define EACH for( uint16_t k=0; k<cnt; k++ )
+  #define PUSH(k,v) do { WR(lanes[k],0x0100|rs[k],(v)); rs[k]--; } while(0)
+  #define PULL(k) (rs[k]++, RD(lanes[k],0x0100|rs[k]))
+  switch( iix ) {
+    case ISA_IIX_ADC : // fall through
+    case ISA_IIX_SBC : EACH {
+      uint8_t c= rp[k] & ISA_FLAG_C;
+      if( rp[k] & ISA_FLAG_D ) {
+        uint16_t rf= cpu_decimal(ra[k], m[k], c, iix==ISA_IIX_SBC);
+        ra[k]= rf>>8;
+        rp[k]= (rp[k] & ~(ISA_FLAG_N|ISA_FLAG_V|ISA_FLAG_Z|ISA_FLAG_C)) | (rf & 0xFF);
+      } else {
+        uint8_t v= iix==ISA_IIX_SBC ? m[k]^0xFF : m[k];
+        uint16_t s= ra[k] + v + c;
+        uint8_t ovf= (ra[k]^s) & (v^s) & 0x80 ? ISA_FLAG_V : 0;
+        rp[k]= (rp[k] & ~(ISA_FLAG_V|ISA_FLAG_C)) | ovf | (s>>8);
+        ra[k]= s;
+        NZ(rp[k],ra[k]);
+      }
+    } break;
+    case ISA_IIX_AND : EACH { ra[k]&= m[k]; NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_ORA : EACH { ra[k]|= m[k]; NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_EOR : EACH { ra[k]^= m[k]; NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_ASL : EACH { uint8_t r= m[k]<<1;                           rp[k]= (rp[k]&~ISA_FLAG_C) | (m[k]>>7); NZ(rp[k],r); m[k]= r; } break;
+    case ISA_IIX_LSR : EACH { uint8_t r= m[k]>>1;                           rp[k]= (rp[k]&~ISA_FLAG_C) | (m[k]&1);  NZ(rp[k],r); m[k]= r; } break;
+    case ISA_IIX_ROL : EACH { uint8_t r= (m[k]<<1) | (rp[k]&ISA_FLAG_C);      rp[k]= (rp[k]&~ISA_FLAG_C) | (m[k]>>7); NZ(rp[k],r); m[k]= r; } break;
+    case ISA_IIX_ROR : EACH { uint8_t r= (m[k]>>1) | ((rp[k]&ISA_FLAG_C)<<7); rp[k]= (rp[k]&~ISA_FLAG_C) | (m[k]&1);  NZ(rp[k],r); m[k]= r; } break;
+    case ISA_IIX_BIT : EACH { rp[k]= (rp[k] & ~(ISA_FLAG_N|ISA_FLAG_V|ISA_FLAG_Z)) | (m[k] & (ISA_FLAG_N|ISA_FLAG_V)) | ((ra[k]&m[k]) ? 0 : ISA_FLAG_Z); } break;
+    case ISA_IIX_CMP : EACH { uint16_t s= ra[k] + (m[k]^0xFF) + 1; rp[k]= (rp[k]&~ISA_FLAG_C) | (s>>8); NZ(rp[k],(uint8_t)s); } break;
+    case ISA_IIX_CPX : EACH { uint16_t s= rx[k] + (m[k]^0xFF) + 1; rp[k]= (rp[k]&~ISA_FLAG_C) | (s>>8); NZ(rp[k],(uint8_t)s); } break;
+    case ISA_IIX_CPY : EACH { uint16_t s= ry[k] + (m[k]^0xFF) + 1; rp[k]= (rp[k]&~ISA_FLAG_C) | (s>>8); NZ(rp[k],(uint8_t)s); } break;
+    case ISA_IIX_DEC : EACH { m[k]--; NZ(rp[k],m[k]); } break;
+    case ISA_IIX_INC : EACH { m[k]++; NZ(rp[k],m[k]); } break;
+    case ISA_IIX_DEX : EACH { rx[k]--; NZ(rp[k],rx[k]); } break;
+    case ISA_IIX_DEY : EACH { ry[k]--; NZ(rp[k],ry[k]); } break;
+    case ISA_IIX_INX : EACH { rx[k]++; NZ(rp[k],rx[k]); } break;
+    case ISA_IIX_INY : EACH { ry[k]++; NZ(rp[k],ry[k]); } break;
+    case ISA_IIX_LDA : EACH { ra[k]= m[k]; NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_LDX : EACH { rx[k]= m[k]; NZ(rp[k],rx[k]); } break;
+    case ISA_IIX_LDY : EACH { ry[k]= m[k]; NZ(rp[k],ry[k]); } break;
+    case ISA_IIX_STA : EACH { WR(lanes[k],ea[k],ra[k]); } break;
+    case ISA_IIX_STX : EACH { WR(lanes[k],ea[k],rx[k]); } break;
+    case ISA_IIX_STY : EACH { WR(lanes[k],ea[k],ry[k]); } break;
+    case ISA_IIX_TAX : EACH { rx[k]= ra[k]; NZ(rp[k],rx[k]); } break;
+    case ISA_IIX_TAY : EACH { ry[k]= ra[k]; NZ(rp[k],ry[k]); } break;
+    case ISA_IIX_TSX : EACH { rx[k]= rs[k]; NZ(rp[k],rx[k]); } break;
+    case ISA_IIX_TXA : EACH { ra[k]= rx[k]; NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_TYA : EACH { ra[k]= ry[k]; NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_TXS : EACH { rs[k]= rx[k]; } break;
+    case ISA_IIX_PHA : EACH { PUSH(k,ra[k]); } break;
+    case ISA_IIX_PHP : EACH { PUSH(k,rp[k]|ISA_FLAG_B|0x20); } break;
+    case ISA_IIX_PLA : EACH { ra[k]= PULL(k); NZ(rp[k],ra[k]); } break;
+    case ISA_IIX_PLP : EACH { rp[k]= (PULL(k)&~ISA_FLAG_B) | 0x20; } break;
+    case ISA_IIX_CLC : EACH { rp[k]&= ~ISA_FLAG_C; } break;
+    case ISA_IIX_SEC : EACH { rp[k]|=  ISA_FLAG_C; } break;
+    case ISA_IIX_CLV : EACH { rp[k]&= ~ISA_FLAG_V; } break;
+    case ISA_IIX_CLD : EACH { rp[k]&= ~ISA_FLAG_D; } break;
+    case ISA_IIX_SED : EACH { rp[k]|=  ISA_FLAG_D; } break;
+    case ISA_IIX_CLI : EACH { rp[k]&= ~ISA_FLAG_I; } break;
+    case ISA_IIX_SEI : EACH { rp[k]|=  ISA_FLAG_I; } break;
+    case ISA_IIX_BCC : case ISA_IIX_BCS : case ISA_IIX_BNE : case ISA_IIX_BEQ :
+    case ISA_IIX_BPL : case ISA_IIX_BMI : case ISA_IIX_BVC : case ISA_IIX_BVS : {
+      // Opcodes 10, 30, .., F0: bits 7-6 select the flag (N, V, C, Z), bit 5 the value to branch on
+      static const uint8_t flag[4] = { ISA_FLAG_N, ISA_FLAG_V, ISA_FLAG_C, ISA_FLAG_Z };
+      uint8_t mask= flag[opcode>>6];
+      uint8_t want= opcode & 0x20 ? mask : 0;
+      EACH {
+        if( (rp[k] & mask)==want ) {
+          cyc[k]= isa_cycles_exact(opcode,pc[k]-2,0,ea[k],true);
+          pc[k]= ea[k];
+        }
+      }
+    } break;
+    case ISA_IIX_JMP : EACH { pc[k]= ea[k]; } break;
+    case ISA_IIX_JSR : EACH { PUSH(k,(pc[k]-1)>>8); PUSH(k,(pc[k]-1)&0xFF); pc[k]= ea[k]; } break;
+    case ISA_IIX_RTS : EACH { uint8_t lo= PULL(k); pc[k]= (lo | (PULL(k)<<8)) + 1; } break;
+    case ISA_IIX_RTI : EACH { rp[k]= (PULL(k)&~ISA_FLAG_B) | 0x20; uint8_t lo= PULL(k); pc[k]= lo | (PULL(k)<<8); } break;
+    case ISA_IIX_BRK : EACH { uint16_t ret= pc[k]+1; PUSH(k,ret>>8); PUSH(k,ret&0xFF); PUSH(k,rp[k]|ISA_FLAG_B|0x20); rp[k]|= ISA_FLAG_I; pc[k]= RD(lanes[k],0xFFFE) | (RD(lanes[k],0xFFFF)<<8); } break;
+    case ISA_IIX_NOP : break;
+  }
+
+  // Write back the read-modify-write results
+  switch( iix ) {
+    case ISA_IIX_ASL : case ISA_IIX_LSR : case ISA_IIX_ROL : case ISA_IIX_ROR : case ISA_IIX_DEC : case ISA_IIX_INC :
+      if( aix==ISA_AIX_ACC ) EACH { ra[k]= m[k]; }
+      else                   EACH { WR(lanes[k],ea[k],m[k]); }
+      break;
+  }
+  #undef EACH
+  #undef PUSH
+  #undef PULL
+
+  // Scatter the registers back
+  for( uint16_t k=0; k<cnt; k++ ) {
+    uint16_t l= lanes[k];
+    b->pc[l]= pc[k]; b->a[l]= ra[k]; b->x[l]= rx[k]; b->y[l]= ry[k]; b->sp[l]= rs[k]; b->p[l]= rp[k];
+    b->cycles[l]+= cyc[k]; b->steps[l]++;
+  }
+}
+
+
+// Returns true when instance `lane` can execute its next instruction (with opcode `*opcode`)
+static bool cpubatch_ready(cpubatch_t * b, uint16_t lane, uint32_t budget, uint8_t * opcode) {
+  if( b->run[lane]!=CPUBATCH_RUNNING ) return false;
+  if( b->cycles[lane]>=budget ) { b->run[lane]= CPUBATCH_STOPPED; return false; }
+  *opcode= RD(lane,b->pc[lane]);
+  if( isa_opcode_iix(*opcode)==0 ) { b->run[lane]= CPUBATCH_HALTED; return false; }
+  return true;
+}
+
+
+bool cpubatch_run(cpubatch_state_t * states, uint8_t * mem, uint16_t n, uint32_t budget) {
+  if( n==0 ) return true;
+  cpubatch_t batch;
+  cpubatch_t * b= &batch;
+  // One allocation for all arrays (16 bit and 32 bit arrays first, for alignment)
+  uint8_t * block= (uint8_t *)malloc( (uint32_t)n * (2*sizeof(uint32_t) + 4*sizeof(uint16_t) + 14*sizeof(uint8_t)) );
+  if( block==0 ) return false;
+  b->n= n;
+  b->mem= mem;
+  b->cycles= (uint32_t *)block;                block+= n*sizeof(uint32_t);
+  b->steps= (uint32_t *)block;                 block+= n*sizeof(uint32_t);
+  b->pc= (uint16_t *)block;                    block+= n*sizeof(uint16_t);
+  b->lanes= (uint16_t *)block;                 block+= n*sizeof(uint16_t);
+  b->ea= (uint16_t *)block;                    block+= n*sizeof(uint16_t);
+  b->gpc= (uint16_t *)block;                   block+= n*sizeof(uint16_t);
+  b->a= block;                                 block+= n;
+  b->x= block;                                 block+= n;
+  b->y= block;                                 block+= n;
+  b->sp= block;                                block+= n;
+  b->p= block;                                 block+= n;
+  b->run= block;                               block+= n;
+  b->done= block;                              block+= n;
+  b->m= block;                                 block+= n;
+  b->cyc= block;                               block+= n;
+  b->ga= block;                                block+= n;
+  b->gx= block;                                block+= n;
+  b->gy= block;                                block+= n;
+  b->gs= block;                                block+= n;
+  b->gp= block;                                block+= n;
+
+  for( uint16_t l=0; l<n; l++ ) {
+    b->pc[l]= states[l].pc;
+    b->a[l]= states[l].a;
+    b->x[l]= states[l].x;
+    b->y[l]= states[l].y;
+    b->sp[l]= states[l].sp;
+    b->p[l]= states[l].p | 0x20;
+    b->cycles[l]= states[l].cycles;
+    b->steps[l]= states[l].steps;
+    b->run[l]= CPUBATCH_RUNNING;
+  }
+
+  // Each step executes one instruction for every running instance
+  bool running= true;
+  while( running ) {
+    running= false;
+    for( uint16_t l=0; l<n; l++ ) b->done[l]= 0;
+    // Group the instances on program counter (and opcode, memories may differ)
+    uint16_t first= 0;
+    for( uint8_t g=0; g<CPUBATCH_GROUPS; g++ ) {
+      uint8_t opcode= 0;
+      while( first<n && (b->done[first] || !cpubatch_ready(b,first,budget,&opcode)) ) first++;
+      if( first==n ) break;
+      uint16_t cnt= 0;
+      uint16_t pc= b->pc[first];
+      for( uint16_t l=first; l<n; l++ ) {
+        uint8_t op;
+        if( b->done[l] || b->pc[l]!=pc || !cpubatch_ready(b,l,budget,&op) || op!=opcode ) continue;
+        b->lanes[cnt++]= l;
+        b->done[l]= 1;
+      }
+      cpubatch_exec(b,cnt,opcode);
+      running= true;
+    }
+    // The instances that diverged from the groups
+    for( uint16_t l=first; l<n; l++ ) {
+      uint8_t opcode;
+      if( b->done[l] || !cpubatch_ready(b,l,budget,&opcode) ) continue;
+      b->lanes[0]= l;
+      cpubatch_exec(b,1,opcode);
+      running= true;
+    }
+  }
+
+  for( uint16_t l=0; l<n; l++ ) {
+    states[l].pc= b->pc[l];
+    states[l].a= b->a[l];
+    states[l].x= b->x[l];
+    states[l].y= b->y[l];
+    states[l].sp= b->sp[l];
+    states[l].p= b->p[l];
+    states[l].cycles= b->cycles[l];
+    states[l].steps= b->steps[l];
+    states[l].halted= b->run[l]==CPUBATCH_HALTED;
+  }
+  free(b->cycles);
+  return true;
+}
+
+
+#endif
@@ -0,0 +1,35 @@
+// cpubatch.h - runs many independent 6502 instances in lockstep (host only, each instance has 64k memory)
+#ifndef __CPUBATCH_H__
+#define __CPUBATCH_H__
+
+
+#include <stdint.h>
+
+
+// The state of one instance, as passed to and returned from cpubatch_run()
+typedef struct cpubatch_state_s {
+  uint16_t pc;     // Program counter
+  uint8_t  a;      // Accumulator
+  uint8_t  x;      // Index register X
+  uint8_t  y;      // Index register Y
+  uint8_t  sp;     // Stack pointer (stack is in page 1)
+  uint8_t  p;      // Status register
+  uint8_t  halted; // Set when the instance stopped on an opcode not in use (pc points to it)
+  uint32_t cycles; // Number of cycles executed
+  uint32_t steps;  // Number of instructions executed
+} cpubatch_state_t;
+
+
+// The registers of all instances are stored as arrays (structure of arrays).
+// Per step, the instances are grouped on program counter. The instances in a group execute the same
+// instruction, so it is decoded once. The registers of the group are gathered in contiguous arrays, the
+// operation is a loop over those (the compiler vectorizes the ones without memory access), and scattered back.
+// Instances that diverged from the larger groups are stepped one by one.
+// The memory of instance i is mem[i*0x10000 ... i*0x10000+0xFFFF] (so mem must be n*64k bytes).
+// Every instance runs until it reaches an opcode not in use, or until it has used `budget` cycles.
+// Returns false when there is not enough memory for the register arrays (states are then unchanged).
+// This engine has no interrupts and no I/O; it is intended for running a ROM against many input vectors.
+bool cpubatch_run(cpubatch_state_t * states, uint8_t * mem, uint16_t n, uint32_t budget);
+
+
+#endif
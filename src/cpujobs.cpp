@@ -0,0 +1,138 @@
+// cpujobs.cpp - runs independent emulation jobs on all cores of a PC (sequentially on other targets)
+
+
+#include <Arduino.h>
+#include "cpubatch.h"
+#include "cpujobs.h"
+
+
+// Threads are only used on a PC; Arduino cores do not all have std::thread
+#if defined(__linux__) || defined(_WIN32) || defined(__APPLE__)
+#define CPUJOBS_THREADS 1
+#include <thread>
+#include <mutex>
+#else
+#define CPUJOBS_THREADS 0
+#endif
+
+
+// Runs `job`, using `mem` (64k) as its memory; returns false when there is not enough memory
+static bool cpujobs_one(cpujobs_job_t * job, uint8_t * mem) {
+  memset(mem, 0, 0x10000L);
+  uint16_t size= job->size;
+  if( (uint32_t)job->addr+size > 0x10000L ) size= 0x10000L-job->addr;
+  memcpy(mem+job->addr, job->image, size);
+  cpubatch_state_t * st= &job->result;
+  st->pc= job->entry;
+  st->a= 0;
+  st->x= 0;
+  st->y= 0;
+  st->sp= 0xFD;
+  st->p= 0x04; // I flag, as after reset
+  st->halted= 0;
+  st->cycles= 0;
+  st->steps= 0;
+  if( !cpubatch_run(st, mem, 1, job->budget) ) return false;
+  if( job->mem ) memcpy(job->mem, mem, 0x10000L);
+  return true;
+}
+
+
+#if CPUJOBS_THREADS
+
+
+// A deque of job indices; the owner takes from the bottom, thieves from the top
+typedef struct cpujobs_deque_s {
+  std::mutex lock;
+  uint16_t * jobs;
+  uint16_t   top;
+  uint16_t   bottom;
+} cpujobs_deque_t;
+
+
+// Takes a job from the bottom of `dq`; returns false when it is empty
+static bool cpujobs_pop(cpujobs_deque_t * dq, uint16_t * job) {
+  std::lock_guard<std::mutex> guard(dq->lock);
+  if( dq->top==dq->bottom ) return false;
+  *job= dq->jobs[--dq->bottom];
+  return true;
+}
+
+
+// Takes a job from the top of `dq`; returns false when it is empty
+static bool cpujobs_steal(cpujobs_deque_t * dq, uint16_t * job) {
+  std::lock_guard<std::mutex> guard(dq->lock);
+  if( dq->top==dq->bottom ) return false;
+  *job= dq->jobs[dq->top++];
+  return true;
+}
+
+
+// Worker `w` runs the jobs of its own deque, then steals from the others until all are empty.
+// No jobs are added while running, so when every deque is empty the worker is done.
+static void cpujobs_worker(cpujobs_job_t * jobs, cpujobs_deque_t * deques, uint8_t threads, uint8_t w, bool * ok) {
+  uint8_t * mem= (uint8_t *)malloc(0x10000L);
+  if( mem==0 ) { *ok= false; return; } // the other workers steal this worker's jobs
+  uint16_t job;
+  while( true ) {
+    bool found= cpujobs_pop(&deques[w],&job);
+    for( uint8_t i=1; !found && i<threads; i++ ) found= cpujobs_steal(&deques[(w+i)%threads],&job);
+    if( !found ) break;
+    if( !cpujobs_one(&jobs[job],mem) ) *ok= false;
+  }
+  free(mem);
+}
+
+
+bool cpujobs_run(cpujobs_job_t * jobs, uint16_t n, uint8_t threads) {
+  if( threads==0 ) {
+    unsigned cores= std::thread::hardware_concurrency();
+    threads= cores==0 ? 1 : cores>255 ? 255 : cores;
+  }
+  if( threads>n ) threads= n;
+  if( threads==0 ) return true;
+  // Deal the jobs round robin over the deques
+  uint16_t * indices= (uint16_t *)malloc(n*sizeof(uint16_t));
+  cpujobs_deque_t * deques= new cpujobs_deque_t[threads];
+  bool * oks= new bool[threads];
+  if( indices==0 ) { delete[] deques; delete[] oks; return false; }
+  uint16_t pos= 0;
+  for( uint8_t w=0; w<threads; w++ ) {
+    deques[w].jobs= indices+pos;
+    deques[w].top= 0;
+    for( uint16_t j=w; j<n; j+=threads ) indices[pos++]= j;
+    deques[w].bottom= indices+pos-deques[w].jobs;
+    oks[w]= true;
+  }
+  std::thread * workers= new std::thread[threads];
+  for( uint8_t w=0; w<threads; w++ ) workers[w]= std::thread(cpujobs_worker, jobs, deques, threads, w, &oks[w]);
+  bool ok= true;
+  for( uint8_t w=0; w<threads; w++ ) { workers[w].join(); ok= ok && oks[w]; }
+  delete[] workers;
+  delete[] oks;
+  delete[] deques;
+  free(indices);
+  return ok;
+}
+
+
+#else
+
+
+bool cpujobs_run(cpujobs_job_t * jobs, uint16_t n, uint8_t threads) {
+  (void)threads; // one by one
+  #ifdef __AVR__
+  (void)jobs; (void)n;
+  return false; // An AVR does not have the memory for even one job
+  #else
+  uint8_t * mem= (uint8_t *)malloc(0x10000L);
+  if( mem==0 ) return false;
+  bool ok= true;
+  for( uint16_t j=0; j<n; j++ ) if( !cpujobs_one(&jobs[j],mem) ) ok= false;
+  free(mem);
+  return ok;
+  #endif
+}
+
+
+#endif
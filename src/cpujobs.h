@@ -0,0 +1,29 @@
+// cpujobs.h - runs independent emulation jobs on all cores of a PC (sequentially on other targets)
+#ifndef __CPUJOBS_H__
+#define __CPUJOBS_H__
+
+
+#include <stdint.h>
+#include "cpubatch.h"
+
+
+// A job: an image, an entry point and a cycle budget; `result` is filled in by cpujobs_run()
+typedef struct cpujobs_job_s {
+  const uint8_t *  image;  // Bytes to load in (zeroed) memory at `addr` (e.g. the output of `prog compile`)
+  uint16_t         addr;   // Load address of the image
+  uint16_t         size;   // Number of bytes in the image
+  uint16_t         entry;  // Initial program counter
+  uint32_t         budget; // Maximum number of cycles to run
+  uint8_t *        mem;    // Optional (0 if not needed): receives the final 64k memory
+  cpubatch_state_t result; // Final registers, cycle and instruction counts; halted when the job reached an opcode not in use
+} cpujobs_job_t;
+
+
+// Runs the `n` jobs, each in its own 64k memory. On a PC the jobs are distributed over `threads` worker
+// threads (0 means one per core), each with its own memory. Every worker has a deque of jobs; when that
+// is empty it steals from the other end of another worker's deque. On other targets the jobs run one by one.
+// Returns false when there is not enough memory.
+bool cpujobs_run(cpujobs_job_t * jobs, uint16_t n, uint8_t threads);
+
+
+#endif
@@ -0,0 +1,75 @@
+// cpupace.cpp - paces the cpu to a real-time clock (or measures its speed when unthrottled)
+
+
+#include <Arduino.h>
+#include "cpupace.h"
+#ifdef __linux__
+#include <time.h>
+#endif
+
+
+uint32_t cpupace_us(void) {
+  #ifdef __linux__
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)ts.tv_sec*1000000UL + ts.tv_nsec/1000;
+  #else
+  return micros();
+  #endif
+}
+
+
+// Sleeps (PC) or busy-waits `us` microseconds
+static void cpupace_sleep(uint32_t us) {
+  #ifdef __linux__
+  struct timespec ts;
+  ts.tv_sec= us/1000000UL;
+  ts.tv_nsec= (us%1000000UL)*1000;
+  clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, 0);
+  #else
+  uint32_t t0= micros();
+  while( micros()-t0 < us ) ;
+  #endif
+}
+
+
+void cpupace_init(cpupace_t * pace, uint32_t hz, bool throttle) {
+  pace->hz= hz;
+  pace->throttle= throttle && hz>0; // a clock of 0 Hz is not paced to
+}
+
+
+void cpupace_start(cpupace_t * pace, const cpu_t * cpu) {
+  pace->ref_cyc= pace->start_cyc= cpu->cycles;
+  pace->ref_us= pace->start_us= cpupace_us();
+}
+
+
+int32_t cpupace_ahead(cpupace_t * pace, const cpu_t * cpu) {
+  if( pace->hz==0 ) return 0;
+  uint32_t cyc= cpu->cycles - pace->ref_cyc;
+  // Keep the reference point within a second of the cpu (moving it whole seconds keeps it exact)
+  while( cyc>=pace->hz ) { pace->ref_cyc+= pace->hz; pace->ref_us+= 1000000UL; cyc-= pace->hz; }
+  uint32_t at= pace->ref_us + (uint32_t)((uint64_t)cyc*1000000UL/pace->hz); // when the cpu should be at its cycle count
+  int32_t ahead= (int32_t)(at - cpupace_us());
+  if( ahead < -(int32_t)CPUPACE_SLACK ) { // too far behind: do not catch up
+    pace->ref_cyc= cpu->cycles;
+    pace->ref_us= at-ahead; // now
+    ahead= 0;
+  }
+  return ahead;
+}
+
+
+void cpupace_wait(cpupace_t * pace, const cpu_t * cpu) {
+  if( !pace->throttle ) return;
+  int32_t ahead= cpupace_ahead(pace, cpu);
+  if( ahead>0 ) cpupace_sleep(ahead);
+}
+
+
+uint32_t cpupace_ratio(cpupace_t * pace, const cpu_t * cpu) {
+  uint32_t us= cpupace_us() - pace->start_us;
+  if( us==0 || pace->hz==0 ) return 0;
+  return (uint64_t)(cpu->cycles - pace->start_cyc) * 100000000ULL / ((uint64_t)us * pace->hz);
+}
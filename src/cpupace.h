@@ -0,0 +1,38 @@
+// cpupace.h - paces the cpu to a real-time clock (or measures its speed when unthrottled)
+#ifndef __CPUPACE_H__
+#define __CPUPACE_H__
+
+
+#include <stdint.h>
+#include "cpu.h"
+
+
+// The cpu runs in bursts (of e.g. 1 ms worth of cycles); after each burst the caller calls cpupace_wait().
+// That waits until the wall clock reaches the time at which the cpu, running at `hz`, would have reached
+// its current cycle count. That time is computed from a fixed reference point (cycle count and time at
+// the start), not from the previous burst. So the error does not accumulate: the jitter stays within a
+// burst. When the cpu falls behind more than CPUPACE_SLACK microseconds (e.g. the host was busy), the
+// reference point is moved: the lost time is not made up with a long run at full speed.
+// Waiting sleeps on a PC (clock_nanosleep) and busy-waits on micros() elsewhere.
+#define CPUPACE_SLACK 100000UL // Max lag in us before the cpu stops catching up
+
+
+typedef struct cpupace_s {
+  uint32_t hz;        // The clock to pace to (or to compare with, when unthrottled), in cycles per second
+  bool     throttle;  // Wait for the wall clock (false: run at full speed, only measure)
+  uint32_t ref_cyc;   // Reference point: a cycle count of the cpu ..
+  uint32_t ref_us;    // .. and the time (us) the cpu should be there
+  uint32_t start_cyc; // Cycle count at cpupace_start (for cpupace_ratio)
+  uint32_t start_us;  // Time at cpupace_start
+} cpupace_t;
+
+
+void     cpupace_init (cpupace_t * pace, uint32_t hz, bool throttle); // Configures `pace` for a clock of `hz` (e.g. 1000000 or 1789773; 0 is never throttled)
+void     cpupace_start(cpupace_t * pace, const cpu_t * cpu);          // Starts pacing `cpu` (call before the first burst)
+int32_t  cpupace_ahead(cpupace_t * pace, const cpu_t * cpu);          // Returns how many us `cpu` is ahead of the wall clock (negative when behind)
+void     cpupace_wait (cpupace_t * pace, const cpu_t * cpu);          // Waits until the wall clock caught up with `cpu` (returns at once when unthrottled)
+uint32_t cpupace_ratio(cpupace_t * pace, const cpu_t * cpu);          // Returns the achieved speed since cpupace_start in percent of `hz` (measured over at most an hour)
+uint32_t cpupace_us   (void);                                         // Returns the time in us (wraps after 71 minutes)
+
+
+#endif
@@ -0,0 +1,130 @@
+// cpurec.cpp - deterministic record and replay of cpu execution
+
+
+#include <Arduino.h>
+#include "snap.h"
+#include "cpurec.h"
+
+
+// Appends `data` to the log; stops the recording when the log is full
+static bool cpurec_add(cpurec_t * rec, uint8_t data) {
+  if( rec->len==rec->size ) { rec->mode= CPUREC_FULL; return false; }
+  rec->log[rec->len++]= data;
+  return true;
+}
+
+
+// Replay: decodes the event at rec->pos (if any) into rec->next; ends the replay at the end of the log
+static void cpurec_peek(cpurec_t * rec) {
+  if( rec->pos==rec->len ) { rec->mode= CPUREC_OFF; return; }
+  if( (rec->log[rec->pos] & 0x80)==0 ) return; // I/O run
+  uint32_t delta= 0;
+  uint16_t pos= rec->pos+1;
+  for( uint8_t shift=0; pos<rec->len; shift+=7 ) {
+    uint8_t b= rec->log[pos++];
+    delta|= (uint32_t)(b&0x7F)<<shift;
+    if( (b&0x80)==0 ) break;
+  }
+  rec->next= rec->last+delta;
+}
+
+
+uint8_t cpurec_record(cpurec_t * rec, cpu_t * cpu, uint8_t * log, uint16_t size) {
+  cpu->rec= rec;
+  uint8_t res= snap_take(cpu);
+  if( res!=SNAP_OK ) { cpu->rec= 0; return res; }
+  rec->mode= CPUREC_RECORD;
+  rec->log= log;
+  rec->size= size;
+  rec->len= 0;
+  rec->pos= 0;
+  rec->last= cpu->cycles;
+  rec->irq= cpu->irq;
+  return SNAP_OK;
+}
+
+
+uint8_t cpurec_replay(cpurec_t * rec, cpu_t * cpu) {
+  uint8_t res= snap_restore(cpu);
+  if( res!=SNAP_OK ) return res;
+  cpu->rec= rec;
+  rec->mode= CPUREC_REPLAY;
+  rec->pos= 0;
+  rec->run= 0;
+  rec->last= cpu->cycles;
+  cpurec_peek(rec);
+  return SNAP_OK;
+}
+
+
+void cpurec_stop(cpurec_t * rec, cpu_t * cpu) {
+  if( rec->mode!=CPUREC_FULL && rec->mode!=CPUREC_DESYNC ) rec->mode= CPUREC_OFF;
+  cpu->rec= 0;
+}
+
+
+uint8_t cpurec_ioread(cpu_t * cpu, uint16_t addr) {
+  cpurec_t * rec= cpu->rec;
+  if( rec->mode==CPUREC_RECORD ) {
+    uint8_t data= mem_read(addr);
+    // Extend the last run of I/O values when it is the last item and not full
+    if( rec->pos<rec->len && rec->log[rec->pos]<0x7F ) {
+      if( cpurec_add(rec,data) ) rec->log[rec->pos]++;
+    } else {
+      rec->pos= rec->len;
+      if( cpurec_add(rec,0x00) && !cpurec_add(rec,data) ) rec->len= rec->pos;
+    }
+    return data;
+  }
+  if( rec->mode==CPUREC_REPLAY ) {
+    if( rec->run==0 ) {
+      // Execution must be at an I/O run; an event first means it went different from the recording
+      if( rec->log[rec->pos] & 0x80 ) { rec->mode= CPUREC_DESYNC; return mem_read(addr); }
+      rec->run= rec->log[rec->pos++]+1;
+    }
+    uint8_t data= rec->log[rec->pos++];
+    if( --rec->run==0 ) cpurec_peek(rec);
+    return data;
+  }
+  return mem_read(addr);
+}
+
+
+bool cpurec_event(cpu_t * cpu, uint8_t ev) {
+  (void)ev;
+  // When recording, the event is logged by cpurec_due(), before the next instruction
+  return cpu->rec->mode==CPUREC_REPLAY;
+}
+
+
+// Record: logs event `ev` at the current cycle
+static void cpurec_log(cpu_t * cpu, uint8_t ev) {
+  cpurec_t * rec= cpu->rec;
+  uint16_t len= rec->len;
+  uint32_t delta= cpu->cycles-rec->last;
+  bool ok= cpurec_add(rec,0x80|ev);
+  while( ok && delta>=0x80 ) { ok= cpurec_add(rec,(delta&0x7F)|0x80); delta>>=7; }
+  if( ok ) ok= cpurec_add(rec,delta);
+  if( !ok ) { rec->len= len; return; } // log full; the event itself is not lost
+  rec->last= cpu->cycles;
+  rec->pos= rec->len; // no I/O run to extend
+}
+
+
+void cpurec_due(cpu_t * cpu) {
+  cpurec_t * rec= cpu->rec;
+  if( rec->mode==CPUREC_RECORD ) {
+    // The lines as this instruction sees them; changes back and forth during the previous one are not seen
+    if( cpu->irq!=rec->irq ) { cpurec_log(cpu, cpu->irq ? CPUREC_EV_IRQ1 : CPUREC_EV_IRQ0); rec->irq= cpu->irq; }
+    if( cpu->nmi ) cpurec_log(cpu, CPUREC_EV_NMI); // taken right after, so logged once
+    return;
+  }
+  while( rec->mode==CPUREC_REPLAY && rec->run==0 && (rec->log[rec->pos] & 0x80) && rec->next<=cpu->cycles ) {
+    uint8_t ev= rec->log[rec->pos] & 0x7F;
+    if( ev==CPUREC_EV_NMI ) cpu->nmi= 1; else cpu->irq= ev;
+    rec->last= rec->next;
+    do rec->pos++; while( rec->log[rec->pos] & 0x80 ); // skip header and LEB128 delta
+    rec->pos++;
+    cpurec_peek(rec);
+  }
+}
@@ -0,0 +1,56 @@
+// cpurec.h - deterministic record and replay of cpu execution
+#ifndef __CPUREC_H__
+#define __CPUREC_H__
+
+
+#include <stdint.h>
+#include "cpu.h"
+
+
+// Execution is deterministic except for reads from I/O pages (see CPU_PAGE_IO) and interrupts.
+// Recording logs only those: the values read from I/O pages, and the cycle at which the IRQ line changes
+// or an NMI arrives. Replay starts from the snapshot taken at the start of the recording (see snap.h),
+// feeds the I/O reads from the log, and raises the interrupts at the logged cycles.
+// An interrupt is logged at the start of the instruction that sees it first (cpu_step checks the lines 
+// before each instruction). So one raised by a device during an instruction (e.g. a write to the VIA IER)
+// is logged with the cycle at the end of that instruction, not its start.
+// The log is a sequence of items
+//  - 00..7F <n+1 bytes>: run of n+1 values read from I/O pages
+//  - 80+ev <delta>: event `ev` (CPUREC_EV_xxx), delta is the number of cycles since the previous event (LEB128)
+#define CPUREC_EV_IRQ0  0 // IRQ line went low
+#define CPUREC_EV_IRQ1  1 // IRQ line went high
+#define CPUREC_EV_NMI   2 // NMI
+
+
+#define CPUREC_OFF      0 // Not recording or replaying (also: replay reached end of log)
+#define CPUREC_RECORD   1 // Recording
+#define CPUREC_REPLAY   2 // Replaying
+#define CPUREC_FULL     3 // Recording stopped, log full
+#define CPUREC_DESYNC   4 // Replay stopped, execution differs from log
+
+
+typedef struct cpurec_s {
+  uint8_t  mode;   // CPUREC_xxx
+  uint8_t * log;   // The log
+  uint16_t size;   // Size of the log buffer
+  uint16_t len;    // Bytes in the log
+  uint16_t pos;    // Replay: position of next item; record: position of header of last I/O run (or len if none)
+  uint8_t  run;    // Replay: I/O values left in current run
+  uint32_t last;   // Cycle of last event
+  uint32_t next;   // Replay: cycle of next event (if log[pos] is an event)
+  uint8_t  irq;    // Record: level of the IRQ line last logged
+} cpurec_t;
+
+
+uint8_t cpurec_record(cpurec_t * rec, cpu_t * cpu, uint8_t * log, uint16_t size); // Takes a snapshot and starts recording; returns a SNAP_xxx code
+uint8_t cpurec_replay(cpurec_t * rec, cpu_t * cpu); // Restores the snapshot, and starts replaying the log; returns a SNAP_xxx code
+void    cpurec_stop  (cpurec_t * rec, cpu_t * cpu); // Stops recording or replaying (the log is kept for a replay)
+
+
+// Called by the cpu
+uint8_t cpurec_ioread(cpu_t * cpu, uint16_t addr); // Read from an I/O page
+bool    cpurec_event (cpu_t * cpu, uint8_t ev);    // Interrupt `ev` (CPUREC_EV_xxx) from the context; returns true when it must be ignored (replay)
+void    cpurec_due   (cpu_t * cpu);                // Before each instruction: logs the interrupts raised since the previous one (record), or delivers the ones due (replay)
+
+
+#endif
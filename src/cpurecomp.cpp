@@ -0,0 +1,169 @@
+// cpurecomp.cpp - runs programs that recomp6502.py recompiled to C++ (host only), with the interpreter as fall back
+
+
+#include <Arduino.h>
+#include "isa.h"
+#include "cpu.h"
+#include "cpusched.h"
+#include "cpurecomp.h"
+
+
+uint8_t cpurecomp_pages[256]; // Not static, cpurecomp_write() is inline
+bool    cpurecomp_chain;
+
+
+#ifdef __AVR__
+
+
+// An AVR does not have the memory for the block map (and the generated code would not fit in flash)
+bool cpurecomp_init(const cpurecomp_block_t * blocks, uint16_t n) {
+  (void)blocks;
+  (void)n;
+  return false;
+}
+
+
+bool cpurecomp_hit(uint16_t addr) {
+  (void)addr;
+  return false;
+}
+
+
+uint16_t cpurecomp_dropped(void) {
+  return 0;
+}
+
+
+#else
+
+
+static const cpurecomp_block_t * cpurecomp_blocks;
+static uint16_t                  cpurecomp_num;
+static uint16_t                * cpurecomp_map; // For each address: 1+index of the block starting there, 0 if none
+static uint16_t                  cpurecomp_drops;
+static uint8_t                   cpurecomp_stores[256]; // Stores to a page with code (until it has a bit map)
+static uint8_t                 * cpurecomp_bytes[256];  // For a hot page: a bit per byte that is code of a block, 0 if none
+
+
+// Sets (or clears) that `page` has code, here and in the cpu page table
+static void cpurecomp_page(uint8_t page, bool code) {
+  if( code ) cpurecomp_pages[page]|= CPURECOMP_PAGE_CODE; else cpurecomp_pages[page]&= ~CPURECOMP_PAGE_CODE;
+  cpu_page_code(page, code);
+}
+
+
+// Determines (from the blocks still in use) whether `page` has code, and fills its bit map (if any)
+static void cpurecomp_scan(uint8_t page) {
+  uint8_t * bytes= cpurecomp_bytes[page];
+  if( bytes ) memset(bytes, 0, 256/8);
+  bool code= false;
+  for( uint16_t i=0; i<cpurecomp_num; i++ ) {
+    const cpurecomp_block_t * b= &cpurecomp_blocks[i];
+    if( cpurecomp_map[b->addr]!=i+1 ) continue;
+    for( uint16_t j=0; j<b->size; j++ ) {
+      uint16_t addr= b->addr+j;
+      if( (addr>>8)!=page ) continue;
+      code= true;
+      if( bytes ) bytes[(addr&0xFF)/8]|= 1<<(addr%8);
+    }
+  }
+  cpurecomp_page(page, code);
+}
+
+
+bool cpurecomp_init(const cpurecomp_block_t * blocks, uint16_t n) {
+  if( cpurecomp_map==0 ) cpurecomp_map= (uint16_t *)malloc(0x10000L*sizeof(uint16_t));
+  if( cpurecomp_map==0 ) return false;
+  memset(cpurecomp_map, 0, 0x10000L*sizeof(uint16_t));
+  for( uint16_t page=0; page<256; page++ ) {
+    free(cpurecomp_bytes[page]);
+    cpurecomp_bytes[page]= 0;
+    cpurecomp_stores[page]= 0;
+    cpurecomp_pages[page]= 0;
+    cpu_page_code(page, false);
+  }
+  cpurecomp_blocks= blocks;
+  cpurecomp_num= n;
+  cpurecomp_drops= 0;
+  for( uint16_t i=0; i<n; i++ ) {
+    const cpurecomp_block_t * b= &blocks[i];
+    bool same= true;
+    for( uint16_t j=0; j<b->size && same; j++ ) same= mem_read(b->addr+j)==b->code[j];
+    if( !same ) continue;
+    cpurecomp_map[b->addr]= i+1;
+    for( uint32_t page=b->addr>>8; page<=(uint32_t)(b->addr+b->size-1)>>8; page++ ) cpurecomp_page(page&0xFF, true);
+  }
+  return true;
+}
+
+
+bool cpurecomp_hit(uint16_t addr) {
+  uint8_t page= addr>>8;
+  bool hit= cpurecomp_pages[page] & CPURECOMP_PAGE_IO;
+  if( !(cpurecomp_pages[page] & CPURECOMP_PAGE_CODE) ) return hit;
+  uint8_t * bytes= cpurecomp_bytes[page];
+  if( bytes==0 && ++cpurecomp_stores[page]==CPURECOMP_HOT ) {
+    bytes= cpurecomp_bytes[page]= (uint8_t *)malloc(256/8);
+    if( bytes ) cpurecomp_scan(page); else cpurecomp_stores[page]= 0; // Retry later
+  }
+  if( bytes && !(bytes[(addr&0xFF)/8] & (1<<(addr%8))) ) return hit;
+  // Self-modifying code is rare, so a linear search suffices
+  for( uint16_t i=0; i<cpurecomp_num; i++ ) {
+    const cpurecomp_block_t * b= &cpurecomp_blocks[i];
+    if( (uint16_t)(addr-b->addr)<b->size && cpurecomp_map[b->addr]==i+1 ) {
+      cpurecomp_map[b->addr]= 0;
+      cpurecomp_drops++;
+      cpurecomp_chain= false; // The generated code does not know which blocks are dropped
+      hit= true;
+      for( uint32_t p=b->addr>>8; p<=(uint32_t)(b->addr+b->size-1)>>8; p++ ) cpurecomp_scan(p&0xFF);
+    }
+  }
+  return hit;
+}
+
+
+uint16_t cpurecomp_dropped(void) {
+  return cpurecomp_drops;
+}
+
+
+#endif
+
+
+bool cpurecomp_run(cpu_t * cpu, uint32_t cycles) {
+  uint32_t stop= cpu->cycles+cycles;
+  // Blocks do not record, trace, profile or check watchpoints
+  bool blocks= cpu->rec==0 && cpu->trace==0 && !cpu_prof_active();
+  for( uint16_t page=0; page<256; page++ ) {
+    uint8_t attr= cpu_page_get(page);
+    if( attr & CPU_PAGE_WATCH ) blocks= false;
+    cpurecomp_pages[page]&= CPURECOMP_PAGE_CODE;
+    if( attr & CPU_PAGE_IO ) cpurecomp_pages[page]|= CPURECOMP_PAGE_IO;
+    if( attr & CPU_PAGE_BREAK ) cpurecomp_pages[page]|= CPURECOMP_PAGE_BREAK;
+  }
+  // A block only jumps to the next one when no block is dropped and there are no breakpoints in the code
+  cpurecomp_chain= blocks;
+  for( uint16_t page=0; page<256; page++ ) if( (cpurecomp_pages[page] & CPURECOMP_PAGE_CODE) && (cpurecomp_pages[page] & CPURECOMP_PAGE_BREAK) ) cpurecomp_chain= false;
+  #ifndef __AVR__
+  if( cpurecomp_drops ) cpurecomp_chain= false;
+  #endif
+  while( (int32_t)(cpu->cycles-stop)<0 ) {
+    #ifndef __AVR__
+    uint16_t ix= blocks && cpurecomp_map ? cpurecomp_map[cpu->pc] : 0;
+    if( ix ) {
+      const cpurecomp_block_t * b= &cpurecomp_blocks[ix-1];
+      uint32_t end= stop;
+      if( cpu->sched && (int32_t)(cpu->sched->next-end)<0 ) end= cpu->sched->next;
+      bool irq= cpu->nmi || (cpu->irq && !(cpu->p & ISA_FLAG_I)); // I is never lazy
+      bool brk= (cpurecomp_pages[b->addr>>8] | cpurecomp_pages[(uint16_t)(b->addr+b->size-1)>>8]) & CPURECOMP_PAGE_BREAK;
+      if( !irq && !brk && (int32_t)(end-cpu->cycles)>=(int32_t)b->maxcycles ) {
+        cpu->stop= CPU_STOP_NONE;
+        b->func(cpu,end);
+        continue;
+      }
+    }
+    #endif
+    if( cpu_step(cpu)==0 || cpu->stop!=CPU_STOP_NONE ) return false;
+  }
+  return true;
+}
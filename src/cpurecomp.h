@@ -0,0 +1,65 @@
+// cpurecomp.h - runs programs that recomp6502.py recompiled to C++ (host only), with the interpreter as fall back
+#ifndef __CPURECOMP_H__
+#define __CPURECOMP_H__
+
+
+// The context is expected to implement
+#include <stdint.h>
+#include "cpu.h"
+extern uint8_t mem_read(uint16_t addr);
+extern void    mem_write(uint16_t addr, uint8_t data);
+
+
+// recomp6502.py finds the basic blocks of a memory image (e.g. a compiled `prog` program) and emits a
+// C++ file with the code of each block. The code holds the registers in locals, keeps N and Z as the last
+// result (so they are only evaluated when the status is pushed or the code returns), and adds the exact
+// cycles (including page crossings and taken branches). Before an access that may hit I/O (not zero page or
+// stack), the code stores the cycle count in `cpu`, so a device sees the same count as with cpu_step().
+// The blocks are labels in one function, so a block jumps (or returns) to the next block without leaving
+// C++, as long as `cpurecomp_chain` is set and the `maxcycles` of the next block fit before `end`. The
+// function is entered with cpu->pc at the start of a block, and returns with cpu->pc at the next block, or
+// at an instruction that the interpreter executes (e.g. an indirect jump, RTI or BRK, or the instruction
+// after CLI or PLP, since an IRQ may be pending).
+typedef void (*cpurecomp_func_t)(cpu_t * cpu, uint32_t end);
+extern bool cpurecomp_chain; // Set by cpurecomp_run()
+
+
+// A block, as listed by the generated file (sorted on address)
+typedef struct cpurecomp_block_s {
+  uint16_t         addr;      // Address of the first instruction
+  uint16_t         size;      // Number of bytes in the block
+  uint16_t         maxcycles; // Worst case cycles of one pass through the block
+  const uint8_t *  code;      // The bytes the block was recompiled from (`size` bytes)
+  cpurecomp_func_t func;
+} cpurecomp_block_t;
+
+
+// Blocks store via cpurecomp_write(). When the store hits a page with code, the blocks containing the
+// address are dropped (self-modifying code runs in the interpreter from then on). When the store hits
+// a page with I/O, a device may have raised an interrupt. In both cases the block ends after the store.
+// The pages with code also have CPU_PAGE_CODE in the cpu page table, so the stores of the interpreter are
+// checked too. A page that sees CPURECOMP_HOT stores (typically variables next to the code) gets a bit map
+// of the bytes that are code, so that from then on, only a store to one of those bytes searches the blocks.
+// When the last block of a page is dropped, the page no longer has code.
+#define CPURECOMP_PAGE_CODE  0x01 // Page has recompiled code
+#define CPURECOMP_PAGE_IO    0x02 // Page is I/O (copied from the cpu page table by cpurecomp_run)
+#define CPURECOMP_PAGE_BREAK 0x04 // Page has a breakpoint (copied from the cpu page table by cpurecomp_run)
+#define CPURECOMP_HOT        8    // Stores to a page with code before it gets a bit map
+extern uint8_t cpurecomp_pages[256];
+bool cpurecomp_hit(uint16_t addr); // Drops the blocks containing `addr`; returns true when the block must end
+static inline bool cpurecomp_write(uint16_t addr, uint8_t data) { mem_write(addr,data); return cpurecomp_pages[addr>>8] && cpurecomp_hit(addr); }
+
+
+// Installs the `n` blocks; a block whose code differs from memory is not used. Returns false when there is
+// not enough memory (or on AVR, which has no recompiled blocks).
+// Runs `cpu` for (at least) `cycles` cycles, executing blocks where possible and cpu_step() elsewhere.
+// The interpreter does all the work while the cpu has a record log or trace ring, the profiler runs, or there
+// are watchpoints. The interpreter also executes blocks with a breakpoint, and runs when an interrupt is
+// pending or a scheduler event is due within the block. Returns false when cpu_step() stopped (an opcode
+// not in use or a breakpoint; see cpu->stop), true when the cycles are used.
+bool     cpurecomp_init   (const cpurecomp_block_t * blocks, uint16_t n);
+bool     cpurecomp_run    (cpu_t * cpu, uint32_t cycles);
+uint16_t cpurecomp_dropped(void); // Returns the number of blocks dropped because their code was written
+
+
+#endif
@@ -0,0 +1,154 @@
+// cpusched.cpp - event scheduler on the cpu cycle counter (hierarchical timing wheel)
+
+
+#include <Arduino.h>
+#include "cpusched.h"
+
+
+#define CPUSCHED_MASK  (CPUSCHED_SLOTS-1)
+#define CPUSCHED_SPAN  (1UL<<(CPUSCHED_BITS*CPUSCHED_LEVELS)) // Cycles covered by the wheel
+#define CPUSCHED_IDLE  0x40000000UL // Without events, wake up now and then, so that `now` stays close to the cycle counter
+
+// Cycle comparison that survives the wrap of the 32 bit cycle counter
+#define CPUSCHED_BEFORE(t1,t2) ((int32_t)((t1)-(t2))<0)
+
+
+// Links `ev` in at the head of `*list`
+static void cpusched_link(cpusched_event_t ** list, cpusched_event_t * ev) {
+  ev->next= *list;
+  if( ev->next ) ev->next->pprev= &ev->next;
+  ev->pprev= list;
+  *list= ev;
+}
+
+
+// Unlinks `ev` from its list
+static void cpusched_unlink(cpusched_event_t * ev) {
+  *ev->pprev= ev->next;
+  if( ev->next ) ev->next->pprev= ev->pprev;
+  ev->pprev= 0;
+}
+
+
+// Puts `ev` in the slot for its cycle; returns the cycle at which that slot needs attention
+static uint32_t cpusched_add(cpusched_t * sched, cpusched_event_t * ev) {
+  uint32_t delta= ev->when - sched->now;
+  if( (int32_t)delta<=0 ) { // due: level 0, in the slot for `now`
+    cpusched_link(&sched->slots[0][sched->now&CPUSCHED_MASK], ev);
+    return sched->now;
+  }
+  for( uint8_t level=0; level<CPUSCHED_LEVELS; level++ ) {
+    uint8_t shift= CPUSCHED_BITS*level;
+    if( delta < ((uint32_t)CPUSCHED_SLOTS<<shift) ) {
+      cpusched_link(&sched->slots[level][(ev->when>>shift)&CPUSCHED_MASK], ev);
+      return ev->when & ~((1UL<<shift)-1); // level 0: the cycle itself, else the start of the slot
+    }
+  }
+  cpusched_link(&sched->overflow, ev);
+  return (sched->now & ~(CPUSCHED_SPAN-1)) + CPUSCHED_SPAN;
+}
+
+
+// Returns true when no event is in the wheel (the overflow list is not checked)
+static bool cpusched_empty(cpusched_t * sched) {
+  for( uint8_t level=0; level<CPUSCHED_LEVELS; level++ ) {
+    for( uint16_t k=0; k<CPUSCHED_SLOTS; k++ ) if( sched->slots[level][k] ) return false;
+  }
+  return true;
+}
+
+
+// Computes the first cycle after `now` at which an event fires or a slot must cascade
+static uint32_t cpusched_next(cpusched_t * sched) {
+  uint32_t next= sched->now + CPUSCHED_IDLE;
+  // Level 0 holds the events of the next CPUSCHED_SLOTS cycles
+  for( uint16_t k=0; k<CPUSCHED_SLOTS; k++ ) {
+    if( sched->slots[0][(sched->now+k)&CPUSCHED_MASK] ) { next= sched->now+k; break; }
+  }
+  // The higher levels cascade at the start of their next non-empty slot
+  for( uint8_t level=1; level<CPUSCHED_LEVELS; level++ ) {
+    uint8_t shift= CPUSCHED_BITS*level;
+    uint32_t base= sched->now>>shift;
+    for( uint16_t k=1; k<=CPUSCHED_SLOTS; k++ ) {
+      if( sched->slots[level][(base+k)&CPUSCHED_MASK] ) {
+        uint32_t at= (base+k)<<shift;
+        if( CPUSCHED_BEFORE(at,next) ) next= at;
+        break;
+      }
+    }
+  }
+  if( sched->overflow ) {
+    uint32_t at= (sched->now & ~(CPUSCHED_SPAN-1)) + CPUSCHED_SPAN;
+    if( CPUSCHED_BEFORE(at,next) ) next= at;
+  }
+  return next;
+}
+
+
+void cpusched_init(cpusched_t * sched, uint32_t now) {
+  memset(sched, 0, sizeof *sched);
+  sched->now= now;
+  sched->next= now + CPUSCHED_IDLE;
+}
+
+
+void cpusched_post(cpusched_t * sched, cpusched_event_t * ev, uint32_t when) {
+  if( ev->pprev ) cpusched_unlink(ev);
+  ev->when= when;
+  uint32_t at= cpusched_add(sched, ev);
+  if( CPUSCHED_BEFORE(at,sched->next) ) sched->next= at;
+}
+
+
+void cpusched_cancel(cpusched_t * sched, cpusched_event_t * ev) {
+  // `next` is not recomputed; at worst cpusched_run() is called once without work
+  (void)sched;
+  if( ev->pprev ) cpusched_unlink(ev);
+}
+
+
+bool cpusched_posted(const cpusched_event_t * ev) {
+  return ev->pprev!=0;
+}
+
+
+void cpusched_run(cpusched_t * sched, cpu_t * cpu) {
+  while( !CPUSCHED_BEFORE(cpu->cycles,sched->next) ) {
+    // No event and no cascade lies between `now` and `next`, so we can jump
+    uint32_t now= sched->next;
+    sched->now= now;
+    // Cascade, from the highest level down, the slots that start at `now`
+    if( (now & (CPUSCHED_SPAN-1))==0 ) {
+      // `now` may lag far behind (up to CPUSCHED_IDLE) when an event is posted; with an empty wheel, jump
+      // to the rotation of the first overflow event (but not past the cycle counter) instead of one per pass
+      if( sched->overflow && cpusched_empty(sched) ) {
+        uint32_t to= cpu->cycles;
+        for( cpusched_event_t * ev= sched->overflow; ev; ev= ev->next ) if( CPUSCHED_BEFORE(ev->when,to) ) to= ev->when;
+        to&= ~(CPUSCHED_SPAN-1);
+        if( CPUSCHED_BEFORE(now,to) ) { now= to; sched->now= now; }
+      }
+      cpusched_event_t * list= sched->overflow;
+      sched->overflow= 0;
+      while( list ) { cpusched_event_t * ev= list; list= ev->next; cpusched_add(sched,ev); }
+    }
+    for( uint8_t level=CPUSCHED_LEVELS-1; level>0; level-- ) {
+      uint8_t shift= CPUSCHED_BITS*level;
+      if( now & ((1UL<<shift)-1) ) continue;
+      cpusched_event_t ** slot= &sched->slots[level][(now>>shift)&CPUSCHED_MASK];
+      cpusched_event_t * list= *slot;
+      *slot= 0;
+      while( list ) { cpusched_event_t * ev= list; list= ev->next; cpusched_add(sched,ev); }
+    }
+    // Fire the events of `now`; the slot is detached first, so that handlers can post (also in this slot)
+    cpusched_event_t ** slot= &sched->slots[0][now&CPUSCHED_MASK];
+    cpusched_event_t * list= *slot;
+    *slot= 0;
+    if( list ) list->pprev= &list;
+    while( list ) {
+      cpusched_event_t * ev= list;
+      cpusched_unlink(ev);
+      ev->func(cpu, ev);
+    }
+    sched->next= cpusched_next(sched);
+  }
+}
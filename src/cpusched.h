@@ -0,0 +1,56 @@
+// cpusched.h - event scheduler on the cpu cycle counter (hierarchical timing wheel)
+#ifndef __CPUSCHED_H__
+#define __CPUSCHED_H__
+
+
+#include <stdint.h>
+#include "cpu.h"
+
+
+// Devices post events that fire at a given cycle (e.g. a timer that raises an IRQ).
+// The scheduler keeps `next`, the first cycle at which it has work. cpu_step compares cpu->cycles with
+// `next` before each instruction, and only when that has passed, it calls cpusched_run(). So the cost per
+// instruction is one compare, independent of the number of devices or events.
+//
+// The events are kept in a hierarchical timing wheel. Level 0 has a slot per cycle for the next
+// CPUSCHED_SLOTS cycles, level 1 a slot per CPUSCHED_SLOTS cycles, and so on. When the cycle counter
+// reaches the start of a slot at a higher level, the events of that slot are moved down (cascaded).
+// Posting and cancelling an event take constant time. Events further away than the highest level
+// are kept in an overflow list, which is re-examined once per rotation of the highest level.
+// Delays must be less than 2^31 cycles.
+#ifdef __AVR__
+#define CPUSCHED_BITS    4 // Slots per level is 2^CPUSCHED_BITS
+#define CPUSCHED_LEVELS  3 // Number of levels (so the wheel spans 2^12 cycles)
+#else
+#define CPUSCHED_BITS    8
+#define CPUSCHED_LEVELS  3 // The wheel spans 2^24 cycles
+#endif
+#define CPUSCHED_SLOTS   (1<<CPUSCHED_BITS)
+
+
+// An event; the device owns the memory, the scheduler links it in its lists
+typedef struct cpusched_event_s {
+  uint32_t when; // Cycle at which the event fires
+  void (*func)(cpu_t * cpu, struct cpusched_event_s * ev); // Called when the event fires (may post events, also `ev` again)
+  void *   arg;  // For use by the device
+  struct cpusched_event_s *  next;  // Next event in the same slot
+  struct cpusched_event_s ** pprev; // The pointer that points to this event; 0 when not posted
+} cpusched_event_t;
+
+
+typedef struct cpusched_s {
+  uint32_t           now;  // Cycle up to which the events have been processed
+  uint32_t           next; // First cycle at which an event fires or a slot cascades
+  cpusched_event_t * slots[CPUSCHED_LEVELS][CPUSCHED_SLOTS];
+  cpusched_event_t * overflow;
+} cpusched_t;
+
+
+void cpusched_init  (cpusched_t * sched, uint32_t now);                        // Initializes `sched` (no events) at cycle `now` (e.g. cpu->cycles)
+void cpusched_post  (cpusched_t * sched, cpusched_event_t * ev, uint32_t when); // Posts `ev` to fire at cycle `when` (moves it when already posted)
+void cpusched_cancel(cpusched_t * sched, cpusched_event_t * ev);                // Cancels `ev` (if posted)
+bool cpusched_posted(const cpusched_event_t * ev);                             // Returns true when `ev` is posted and has not fired yet
+void cpusched_run   (cpusched_t * sched, cpu_t * cpu);                         // Fires all events up to cpu->cycles (called by cpu_step when cpu->sched is set)
+
+
+#endif
@@ -0,0 +1,126 @@
+// cputrace.cpp - instruction trace of the cpu via a lock-free ring buffer
+
+
+#include <Arduino.h>
+#include "isa.h"
+#include "cputrace.h"
+#if CPUTRACE_THREADS
+#include <stdio.h>
+#include <thread>
+#endif
+
+
+// On a PC the indices are atomics: the producer publishes an entry with a release store of `head`,
+// the consumer sees it with an acquire load (and vice versa for `tail`).
+// Elsewhere producer and consumer run on the same core, so volatile suffices.
+#if CPUTRACE_THREADS
+#define CPUTRACE_LOAD(i)     (i).load(std::memory_order_acquire)
+#define CPUTRACE_OWN(i)      (i).load(std::memory_order_relaxed)
+#define CPUTRACE_STORE(i,v)  (i).store((v),std::memory_order_release)
+#else
+#define CPUTRACE_LOAD(i)     (i)
+#define CPUTRACE_OWN(i)      (i)
+#define CPUTRACE_STORE(i,v)  ((i)= (v))
+#endif
+
+
+void cputrace_init(cputrace_t * tr, cputrace_entry_t * ring, uint16_t num) {
+  tr->ring= ring;
+  tr->mask= num-1;
+  CPUTRACE_STORE(tr->head,0);
+  CPUTRACE_STORE(tr->tail,0);
+  tr->lost= 0;
+}
+
+
+void cputrace_put(cputrace_t * tr, cpu_t * cpu, uint8_t opcode) {
+  uint16_t head= CPUTRACE_OWN(tr->head);
+  if( ((head+1)&tr->mask)==CPUTRACE_LOAD(tr->tail) ) { tr->lost++; return; } // full (one slot is kept free)
+  cputrace_entry_t * e= &tr->ring[head];
+  uint16_t pc= cpu->pc;
+  uint8_t bytes= isa_opcode_bytes(opcode);
+  e->cycles= cpu->cycles;
+  e->pc= pc;
+  e->opcode= opcode;
+  e->op1= bytes>1 && !(cpu_page_get((pc+1)>>8)&CPU_PAGE_IO) ? mem_read(pc+1) : 0;
+  e->op2= bytes>2 && !(cpu_page_get((pc+2)>>8)&CPU_PAGE_IO) ? mem_read(pc+2) : 0;
+  e->a= cpu->a;
+  e->x= cpu->x;
+  e->y= cpu->y;
+  e->p= cpu->p;
+  e->sp= cpu->sp;
+  e->lazy= cpu->lazy;
+  e->lz_n= cpu->lz_n;
+  e->lz_z= cpu->lz_z;
+  e->lz_v1= cpu->lz_v1;
+  e->lz_v2= cpu->lz_v2;
+  e->lz_vr= cpu->lz_vr;
+  e->lz_c= cpu->lz_c;
+  CPUTRACE_STORE(tr->head,(head+1)&tr->mask);
+}
+
+
+bool cputrace_get(cputrace_t * tr, cputrace_entry_t * entry) {
+  uint16_t tail= CPUTRACE_OWN(tr->tail);
+  if( tail==CPUTRACE_LOAD(tr->head) ) return false;
+  *entry= tr->ring[tail];
+  CPUTRACE_STORE(tr->tail,(tail+1)&tr->mask);
+  return true;
+}
+
+
+// The lazy flags are evaluated here, when the entry is printed, so that the cpu does not pay for it
+uint8_t cputrace_status(const cputrace_entry_t * entry) {
+  cpu_t cpu;
+  cpu.p= entry->p;
+  cpu.lazy= entry->lazy;
+  cpu.lz_n= entry->lz_n;
+  cpu.lz_z= entry->lz_z;
+  cpu.lz_v1= entry->lz_v1;
+  cpu.lz_v2= entry->lz_v2;
+  cpu.lz_vr= entry->lz_vr;
+  cpu.lz_c= entry->lz_c;
+  return cpu_status(&cpu);
+}
+
+
+#if CPUTRACE_THREADS
+
+
+static std::thread       cputrace_thread;
+static std::atomic<bool> cputrace_stop;
+
+
+// The drain thread: writes the entries to `file` in blocks, until stopped and the ring is empty
+static void cputrace_writer(cputrace_t * tr, FILE * file) {
+  cputrace_entry_t buf[64];
+  while( true ) {
+    bool stop= cputrace_stop.load(); // read before draining, so no entry is left behind after the last pass
+    uint16_t num= 0;
+    while( num<64 && cputrace_get(tr,&buf[num]) ) num++;
+    if( num>0 ) fwrite(buf, sizeof buf[0], num, file);
+    else if( stop ) break;
+    else std::this_thread::yield();
+  }
+  fclose(file);
+}
+
+
+bool cputrace_file_start(cputrace_t * tr, const char * path) {
+  if( cputrace_thread.joinable() ) return false;
+  FILE * file= fopen(path,"wb");
+  if( file==0 ) return false;
+  cputrace_stop= false;
+  cputrace_thread= std::thread(cputrace_writer, tr, file);
+  return true;
+}
+
+
+void cputrace_file_stop(void) {
+  if( !cputrace_thread.joinable() ) return;
+  cputrace_stop= true;
+  cputrace_thread.join();
+}
+
+
+#endif
@@ -0,0 +1,69 @@
+// cputrace.h - instruction trace of the cpu via a lock-free ring buffer
+#ifndef __CPUTRACE_H__
+#define __CPUTRACE_H__
+
+
+#include <stdint.h>
+#include "cpu.h"
+
+
+// On a PC the ring is drained by a separate thread; elsewhere it is drained in idle time (e.g. from loop())
+#if defined(__linux__) || defined(_WIN32) || defined(__APPLE__)
+#define CPUTRACE_THREADS 1
+#include <atomic>
+typedef std::atomic<uint16_t> cputrace_index_t;
+#else
+#define CPUTRACE_THREADS 0
+typedef volatile uint16_t cputrace_index_t;
+#endif
+
+
+// One trace entry: the state before the instruction executes.
+// The operand bytes are stored, so the entry can be disassembled later (also when the code has changed since).
+// For an instruction on an I/O page, the operand bytes are not stored (reading them could have side effects).
+// The status register is stored as the cpu has it (with the lazy flags not evaluated); cputrace_status() computes it.
+typedef struct cputrace_entry_s {
+  uint32_t cycles; // Cycle count before the instruction
+  uint16_t pc;     // Address of the instruction
+  uint8_t  opcode; // Opcode of the instruction
+  uint8_t  op1;    // Operand bytes (when the instruction has them)
+  uint8_t  op2;
+  uint8_t  a;      // Registers
+  uint8_t  x;
+  uint8_t  y;
+  uint8_t  p;      // Status register; for flags in `lazy` the bit in `p` is stale (see cpu_t)
+  uint8_t  sp;
+  uint8_t  lazy;   // The lazy flags state of the cpu (see cpu_t)
+  uint8_t  lz_n;
+  uint8_t  lz_z;
+  uint8_t  lz_v1;
+  uint8_t  lz_v2;
+  uint8_t  lz_vr;
+  uint16_t lz_c;
+} cputrace_entry_t;
+
+
+// A single-producer single-consumer ring. The cpu is the producer: it only writes `head`, the drain
+// is the consumer: it only writes `tail`. So there are no locks, and the cpu never waits: when the
+// ring is full, the entry is dropped (and counted in `lost`).
+typedef struct cputrace_s {
+  cputrace_entry_t * ring; // The entries
+  uint16_t           mask; // Number of entries minus 1 (number of entries is a power of two)
+  cputrace_index_t   head; // Next entry to write (producer)
+  cputrace_index_t   tail; // Next entry to read (consumer)
+  uint32_t           lost; // Number of dropped entries
+} cputrace_t;
+
+
+// The entries are printed by the command layer (see cmdrun_trace_drain() in cmdrun.h)
+void     cputrace_init  (cputrace_t * tr, cputrace_entry_t * ring, uint16_t num); // Initializes `tr` with `ring` of `num` (a power of two) entries
+void     cputrace_put   (cputrace_t * tr, cpu_t * cpu, uint8_t opcode);           // Adds the instruction at cpu->pc (called by cpu_step when cpu->trace is set)
+bool     cputrace_get   (cputrace_t * tr, cputrace_entry_t * entry);              // Takes the oldest entry; returns false when the ring is empty
+uint8_t  cputrace_status(const cputrace_entry_t * entry);                         // Returns the status register of `entry` (all lazy flags evaluated)
+#if CPUTRACE_THREADS
+bool     cputrace_file_start(cputrace_t * tr, const char * path);                 // Starts a thread that writes the entries (binary) to file `path`; returns false on failure
+void     cputrace_file_stop (void);                                               // Stops that thread, after it wrote the entries still in the ring
+#endif
+
+
+#endif
@@ -1,5 +1,5 @@
 // isa.cpp - 6502 instruction set architecture
-// This file is generated by isa6502.py V7 on 2020-07-19 13:10:49
+// This file is generated by isa6502.py V7 on 2026-10-18 11:39:32
 
 
 #include <Arduino.h>
@@ -494,6 +494,8 @@ typedef struct isa_instruction_s {
   const char * const help;
   const char * const flags;
   const uint8_t opcodes[14]; // for each addrmode, the opcode
+  const uint8_t fwrites; // flags (ISA_FLAG_xxx) written by the instruction, derived from `flags`
+  const uint8_t freads; // flags (ISA_FLAG_xxx) read by the instruction
 } isa_instruction_t;
 
 // Opcode 0xBB is not in use in the 6502. We use it in instructions.opcodes to signal the addrmode does not exist for that instruction
@@ -501,63 +503,63 @@ typedef struct isa_instruction_s {
 
 // The table storing all attributes of instructions (in PROGMEM)
 const isa_instruction_t isa_instructions[] PROGMEM = {
-  /* 0*/ { ISA_IIX_0Ei_iname, ISA_IIX_0Ei_desc, ISA_IIX_0Ei_help, ISA_IIX_0Ei_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /* 1*/ { ISA_IIX_ADC_iname, ISA_IIX_ADC_desc, ISA_IIX_ADC_help, ISA_IIX_ADC_flags, {0xbb,0x6d,0x7d,0x79,0xbb,0x69,0xbb,0xbb,0xbb,0x71,0x65,0x75,0xbb,0x61} },
-  /* 2*/ { ISA_IIX_AND_iname, ISA_IIX_AND_desc, ISA_IIX_AND_help, ISA_IIX_AND_flags, {0xbb,0x2d,0x3d,0x39,0xbb,0x29,0xbb,0xbb,0xbb,0x31,0x25,0x35,0xbb,0x21} },
-  /* 3*/ { ISA_IIX_ASL_iname, ISA_IIX_ASL_desc, ISA_IIX_ASL_help, ISA_IIX_ASL_flags, {0xbb,0x0e,0x1e,0xbb,0x0a,0xbb,0xbb,0xbb,0xbb,0xbb,0x06,0x16,0xbb,0xbb} },
-  /* 4*/ { ISA_IIX_BCC_iname, ISA_IIX_BCC_desc, ISA_IIX_BCC_help, ISA_IIX_BCC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x90,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /* 5*/ { ISA_IIX_BCS_iname, ISA_IIX_BCS_desc, ISA_IIX_BCS_help, ISA_IIX_BCS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xb0,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /* 6*/ { ISA_IIX_BEQ_iname, ISA_IIX_BEQ_desc, ISA_IIX_BEQ_help, ISA_IIX_BEQ_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xf0,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /* 7*/ { ISA_IIX_BIT_iname, ISA_IIX_BIT_desc, ISA_IIX_BIT_help, ISA_IIX_BIT_flags, {0xbb,0x2c,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x24,0xbb,0xbb,0xbb} },
-  /* 8*/ { ISA_IIX_BMI_iname, ISA_IIX_BMI_desc, ISA_IIX_BMI_help, ISA_IIX_BMI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x30,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /* 9*/ { ISA_IIX_BNE_iname, ISA_IIX_BNE_desc, ISA_IIX_BNE_help, ISA_IIX_BNE_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xd0,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*10*/ { ISA_IIX_BPL_iname, ISA_IIX_BPL_desc, ISA_IIX_BPL_help, ISA_IIX_BPL_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x10,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*11*/ { ISA_IIX_BRK_iname, ISA_IIX_BRK_desc, ISA_IIX_BRK_help, ISA_IIX_BRK_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x00,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*12*/ { ISA_IIX_BVC_iname, ISA_IIX_BVC_desc, ISA_IIX_BVC_help, ISA_IIX_BVC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x50,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*13*/ { ISA_IIX_BVS_iname, ISA_IIX_BVS_desc, ISA_IIX_BVS_help, ISA_IIX_BVS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x70,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*14*/ { ISA_IIX_CLC_iname, ISA_IIX_CLC_desc, ISA_IIX_CLC_help, ISA_IIX_CLC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x18,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*15*/ { ISA_IIX_CLD_iname, ISA_IIX_CLD_desc, ISA_IIX_CLD_help, ISA_IIX_CLD_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xd8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*16*/ { ISA_IIX_CLI_iname, ISA_IIX_CLI_desc, ISA_IIX_CLI_help, ISA_IIX_CLI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x58,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*17*/ { ISA_IIX_CLV_iname, ISA_IIX_CLV_desc, ISA_IIX_CLV_help, ISA_IIX_CLV_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xb8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*18*/ { ISA_IIX_CMP_iname, ISA_IIX_CMP_desc, ISA_IIX_CMP_help, ISA_IIX_CMP_flags, {0xbb,0xcd,0xdd,0xd9,0xbb,0xc9,0xbb,0xbb,0xbb,0xd1,0xc5,0xd5,0xbb,0xc1} },
-  /*19*/ { ISA_IIX_CPX_iname, ISA_IIX_CPX_desc, ISA_IIX_CPX_help, ISA_IIX_CPX_flags, {0xbb,0xec,0xbb,0xbb,0xbb,0xe0,0xbb,0xbb,0xbb,0xbb,0xe4,0xbb,0xbb,0xbb} },
-  /*20*/ { ISA_IIX_CPY_iname, ISA_IIX_CPY_desc, ISA_IIX_CPY_help, ISA_IIX_CPY_flags, {0xbb,0xcc,0xbb,0xbb,0xbb,0xc0,0xbb,0xbb,0xbb,0xbb,0xc4,0xbb,0xbb,0xbb} },
-  /*21*/ { ISA_IIX_DEC_iname, ISA_IIX_DEC_desc, ISA_IIX_DEC_help, ISA_IIX_DEC_flags, {0xbb,0xce,0xde,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xc6,0xd6,0xbb,0xbb} },
-  /*22*/ { ISA_IIX_DEX_iname, ISA_IIX_DEX_desc, ISA_IIX_DEX_help, ISA_IIX_DEX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xca,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*23*/ { ISA_IIX_DEY_iname, ISA_IIX_DEY_desc, ISA_IIX_DEY_help, ISA_IIX_DEY_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x88,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*24*/ { ISA_IIX_EOR_iname, ISA_IIX_EOR_desc, ISA_IIX_EOR_help, ISA_IIX_EOR_flags, {0xbb,0x4d,0x5d,0x59,0xbb,0x49,0xbb,0xbb,0xbb,0x51,0x45,0x55,0xbb,0x41} },
-  /*25*/ { ISA_IIX_INC_iname, ISA_IIX_INC_desc, ISA_IIX_INC_help, ISA_IIX_INC_flags, {0xbb,0xee,0xfe,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xe6,0xf6,0xbb,0xbb} },
-  /*26*/ { ISA_IIX_INX_iname, ISA_IIX_INX_desc, ISA_IIX_INX_help, ISA_IIX_INX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xe8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*27*/ { ISA_IIX_INY_iname, ISA_IIX_INY_desc, ISA_IIX_INY_help, ISA_IIX_INY_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xc8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*28*/ { ISA_IIX_JMP_iname, ISA_IIX_JMP_desc, ISA_IIX_JMP_help, ISA_IIX_JMP_flags, {0xbb,0x4c,0xbb,0xbb,0xbb,0xbb,0xbb,0x6c,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*29*/ { ISA_IIX_JSR_iname, ISA_IIX_JSR_desc, ISA_IIX_JSR_help, ISA_IIX_JSR_flags, {0xbb,0x20,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*30*/ { ISA_IIX_LDA_iname, ISA_IIX_LDA_desc, ISA_IIX_LDA_help, ISA_IIX_LDA_flags, {0xbb,0xad,0xbd,0xb9,0xbb,0xa9,0xbb,0xbb,0xbb,0xb1,0xa5,0xb5,0xbb,0xa1} },
-  /*31*/ { ISA_IIX_LDX_iname, ISA_IIX_LDX_desc, ISA_IIX_LDX_help, ISA_IIX_LDX_flags, {0xbb,0xae,0xbb,0xbe,0xbb,0xa2,0xbb,0xbb,0xbb,0xbb,0xa6,0xbb,0xb6,0xbb} },
-  /*32*/ { ISA_IIX_LDY_iname, ISA_IIX_LDY_desc, ISA_IIX_LDY_help, ISA_IIX_LDY_flags, {0xbb,0xac,0xbc,0xbb,0xbb,0xa0,0xbb,0xbb,0xbb,0xbb,0xa4,0xb4,0xbb,0xbb} },
-  /*33*/ { ISA_IIX_LSR_iname, ISA_IIX_LSR_desc, ISA_IIX_LSR_help, ISA_IIX_LSR_flags, {0xbb,0x4e,0x5e,0xbb,0x4a,0xbb,0xbb,0xbb,0xbb,0xbb,0x46,0x56,0xbb,0xbb} },
-  /*34*/ { ISA_IIX_NOP_iname, ISA_IIX_NOP_desc, ISA_IIX_NOP_help, ISA_IIX_NOP_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xea,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*35*/ { ISA_IIX_ORA_iname, ISA_IIX_ORA_desc, ISA_IIX_ORA_help, ISA_IIX_ORA_flags, {0xbb,0x0d,0x1d,0x19,0xbb,0x09,0xbb,0xbb,0xbb,0x11,0x05,0x15,0xbb,0x01} },
-  /*36*/ { ISA_IIX_PHA_iname, ISA_IIX_PHA_desc, ISA_IIX_PHA_help, ISA_IIX_PHA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x48,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*37*/ { ISA_IIX_PHP_iname, ISA_IIX_PHP_desc, ISA_IIX_PHP_help, ISA_IIX_PHP_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x08,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*38*/ { ISA_IIX_PLA_iname, ISA_IIX_PLA_desc, ISA_IIX_PLA_help, ISA_IIX_PLA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x68,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*39*/ { ISA_IIX_PLP_iname, ISA_IIX_PLP_desc, ISA_IIX_PLP_help, ISA_IIX_PLP_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x28,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*40*/ { ISA_IIX_ROL_iname, ISA_IIX_ROL_desc, ISA_IIX_ROL_help, ISA_IIX_ROL_flags, {0xbb,0x2e,0x3e,0xbb,0x2a,0xbb,0xbb,0xbb,0xbb,0xbb,0x26,0x36,0xbb,0xbb} },
-  /*41*/ { ISA_IIX_ROR_iname, ISA_IIX_ROR_desc, ISA_IIX_ROR_help, ISA_IIX_ROR_flags, {0xbb,0x6e,0x7e,0xbb,0x6a,0xbb,0xbb,0xbb,0xbb,0xbb,0x66,0x76,0xbb,0xbb} },
-  /*42*/ { ISA_IIX_RTI_iname, ISA_IIX_RTI_desc, ISA_IIX_RTI_help, ISA_IIX_RTI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x40,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*43*/ { ISA_IIX_RTS_iname, ISA_IIX_RTS_desc, ISA_IIX_RTS_help, ISA_IIX_RTS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x60,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*44*/ { ISA_IIX_SBC_iname, ISA_IIX_SBC_desc, ISA_IIX_SBC_help, ISA_IIX_SBC_flags, {0xbb,0xed,0xfd,0xf9,0xbb,0xe9,0xbb,0xbb,0xbb,0xf1,0xe5,0xf5,0xbb,0xe1} },
-  /*45*/ { ISA_IIX_SEC_iname, ISA_IIX_SEC_desc, ISA_IIX_SEC_help, ISA_IIX_SEC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x38,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*46*/ { ISA_IIX_SED_iname, ISA_IIX_SED_desc, ISA_IIX_SED_help, ISA_IIX_SED_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xf8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*47*/ { ISA_IIX_SEI_iname, ISA_IIX_SEI_desc, ISA_IIX_SEI_help, ISA_IIX_SEI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x78,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*48*/ { ISA_IIX_STA_iname, ISA_IIX_STA_desc, ISA_IIX_STA_help, ISA_IIX_STA_flags, {0xbb,0x8d,0x9d,0x99,0xbb,0xbb,0xbb,0xbb,0xbb,0x91,0x85,0x95,0xbb,0x81} },
-  /*49*/ { ISA_IIX_STX_iname, ISA_IIX_STX_desc, ISA_IIX_STX_help, ISA_IIX_STX_flags, {0xbb,0x8e,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x86,0xbb,0x96,0xbb} },
-  /*50*/ { ISA_IIX_STY_iname, ISA_IIX_STY_desc, ISA_IIX_STY_help, ISA_IIX_STY_flags, {0xbb,0x8c,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x84,0x94,0xbb,0xbb} },
-  /*51*/ { ISA_IIX_TAX_iname, ISA_IIX_TAX_desc, ISA_IIX_TAX_help, ISA_IIX_TAX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xaa,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*52*/ { ISA_IIX_TAY_iname, ISA_IIX_TAY_desc, ISA_IIX_TAY_help, ISA_IIX_TAY_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xa8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*53*/ { ISA_IIX_TSX_iname, ISA_IIX_TSX_desc, ISA_IIX_TSX_help, ISA_IIX_TSX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xba,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*54*/ { ISA_IIX_TXA_iname, ISA_IIX_TXA_desc, ISA_IIX_TXA_help, ISA_IIX_TXA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x8a,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*55*/ { ISA_IIX_TXS_iname, ISA_IIX_TXS_desc, ISA_IIX_TXS_help, ISA_IIX_TXS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x9a,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
-  /*56*/ { ISA_IIX_TYA_iname, ISA_IIX_TYA_desc, ISA_IIX_TYA_help, ISA_IIX_TYA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x98,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb} },
+  /* 0*/ { ISA_IIX_0Ei_iname, ISA_IIX_0Ei_desc, ISA_IIX_0Ei_help, ISA_IIX_0Ei_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /* 1*/ { ISA_IIX_ADC_iname, ISA_IIX_ADC_desc, ISA_IIX_ADC_help, ISA_IIX_ADC_flags, {0xbb,0x6d,0x7d,0x79,0xbb,0x69,0xbb,0xbb,0xbb,0x71,0x65,0x75,0xbb,0x61}, 0xc3, 0x09 },
+  /* 2*/ { ISA_IIX_AND_iname, ISA_IIX_AND_desc, ISA_IIX_AND_help, ISA_IIX_AND_flags, {0xbb,0x2d,0x3d,0x39,0xbb,0x29,0xbb,0xbb,0xbb,0x31,0x25,0x35,0xbb,0x21}, 0x82, 0x00 },
+  /* 3*/ { ISA_IIX_ASL_iname, ISA_IIX_ASL_desc, ISA_IIX_ASL_help, ISA_IIX_ASL_flags, {0xbb,0x0e,0x1e,0xbb,0x0a,0xbb,0xbb,0xbb,0xbb,0xbb,0x06,0x16,0xbb,0xbb}, 0x83, 0x00 },
+  /* 4*/ { ISA_IIX_BCC_iname, ISA_IIX_BCC_desc, ISA_IIX_BCC_help, ISA_IIX_BCC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x90,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x01 },
+  /* 5*/ { ISA_IIX_BCS_iname, ISA_IIX_BCS_desc, ISA_IIX_BCS_help, ISA_IIX_BCS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xb0,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x01 },
+  /* 6*/ { ISA_IIX_BEQ_iname, ISA_IIX_BEQ_desc, ISA_IIX_BEQ_help, ISA_IIX_BEQ_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xf0,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x02 },
+  /* 7*/ { ISA_IIX_BIT_iname, ISA_IIX_BIT_desc, ISA_IIX_BIT_help, ISA_IIX_BIT_flags, {0xbb,0x2c,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x24,0xbb,0xbb,0xbb}, 0xc2, 0x00 },
+  /* 8*/ { ISA_IIX_BMI_iname, ISA_IIX_BMI_desc, ISA_IIX_BMI_help, ISA_IIX_BMI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x30,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x80 },
+  /* 9*/ { ISA_IIX_BNE_iname, ISA_IIX_BNE_desc, ISA_IIX_BNE_help, ISA_IIX_BNE_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xd0,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x02 },
+  /*10*/ { ISA_IIX_BPL_iname, ISA_IIX_BPL_desc, ISA_IIX_BPL_help, ISA_IIX_BPL_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x10,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x80 },
+  /*11*/ { ISA_IIX_BRK_iname, ISA_IIX_BRK_desc, ISA_IIX_BRK_help, ISA_IIX_BRK_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x00,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x14, 0xcf },
+  /*12*/ { ISA_IIX_BVC_iname, ISA_IIX_BVC_desc, ISA_IIX_BVC_help, ISA_IIX_BVC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x50,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x40 },
+  /*13*/ { ISA_IIX_BVS_iname, ISA_IIX_BVS_desc, ISA_IIX_BVS_help, ISA_IIX_BVS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x70,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x40 },
+  /*14*/ { ISA_IIX_CLC_iname, ISA_IIX_CLC_desc, ISA_IIX_CLC_help, ISA_IIX_CLC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x18,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x01, 0x00 },
+  /*15*/ { ISA_IIX_CLD_iname, ISA_IIX_CLD_desc, ISA_IIX_CLD_help, ISA_IIX_CLD_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xd8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x08, 0x00 },
+  /*16*/ { ISA_IIX_CLI_iname, ISA_IIX_CLI_desc, ISA_IIX_CLI_help, ISA_IIX_CLI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x58,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x04, 0x00 },
+  /*17*/ { ISA_IIX_CLV_iname, ISA_IIX_CLV_desc, ISA_IIX_CLV_help, ISA_IIX_CLV_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xb8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x40, 0x00 },
+  /*18*/ { ISA_IIX_CMP_iname, ISA_IIX_CMP_desc, ISA_IIX_CMP_help, ISA_IIX_CMP_flags, {0xbb,0xcd,0xdd,0xd9,0xbb,0xc9,0xbb,0xbb,0xbb,0xd1,0xc5,0xd5,0xbb,0xc1}, 0x83, 0x00 },
+  /*19*/ { ISA_IIX_CPX_iname, ISA_IIX_CPX_desc, ISA_IIX_CPX_help, ISA_IIX_CPX_flags, {0xbb,0xec,0xbb,0xbb,0xbb,0xe0,0xbb,0xbb,0xbb,0xbb,0xe4,0xbb,0xbb,0xbb}, 0x83, 0x00 },
+  /*20*/ { ISA_IIX_CPY_iname, ISA_IIX_CPY_desc, ISA_IIX_CPY_help, ISA_IIX_CPY_flags, {0xbb,0xcc,0xbb,0xbb,0xbb,0xc0,0xbb,0xbb,0xbb,0xbb,0xc4,0xbb,0xbb,0xbb}, 0x83, 0x00 },
+  /*21*/ { ISA_IIX_DEC_iname, ISA_IIX_DEC_desc, ISA_IIX_DEC_help, ISA_IIX_DEC_flags, {0xbb,0xce,0xde,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xc6,0xd6,0xbb,0xbb}, 0x82, 0x00 },
+  /*22*/ { ISA_IIX_DEX_iname, ISA_IIX_DEX_desc, ISA_IIX_DEX_help, ISA_IIX_DEX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xca,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*23*/ { ISA_IIX_DEY_iname, ISA_IIX_DEY_desc, ISA_IIX_DEY_help, ISA_IIX_DEY_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x88,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*24*/ { ISA_IIX_EOR_iname, ISA_IIX_EOR_desc, ISA_IIX_EOR_help, ISA_IIX_EOR_flags, {0xbb,0x4d,0x5d,0x59,0xbb,0x49,0xbb,0xbb,0xbb,0x51,0x45,0x55,0xbb,0x41}, 0x82, 0x00 },
+  /*25*/ { ISA_IIX_INC_iname, ISA_IIX_INC_desc, ISA_IIX_INC_help, ISA_IIX_INC_flags, {0xbb,0xee,0xfe,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xe6,0xf6,0xbb,0xbb}, 0x82, 0x00 },
+  /*26*/ { ISA_IIX_INX_iname, ISA_IIX_INX_desc, ISA_IIX_INX_help, ISA_IIX_INX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xe8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*27*/ { ISA_IIX_INY_iname, ISA_IIX_INY_desc, ISA_IIX_INY_help, ISA_IIX_INY_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xc8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*28*/ { ISA_IIX_JMP_iname, ISA_IIX_JMP_desc, ISA_IIX_JMP_help, ISA_IIX_JMP_flags, {0xbb,0x4c,0xbb,0xbb,0xbb,0xbb,0xbb,0x6c,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /*29*/ { ISA_IIX_JSR_iname, ISA_IIX_JSR_desc, ISA_IIX_JSR_help, ISA_IIX_JSR_flags, {0xbb,0x20,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /*30*/ { ISA_IIX_LDA_iname, ISA_IIX_LDA_desc, ISA_IIX_LDA_help, ISA_IIX_LDA_flags, {0xbb,0xad,0xbd,0xb9,0xbb,0xa9,0xbb,0xbb,0xbb,0xb1,0xa5,0xb5,0xbb,0xa1}, 0x82, 0x00 },
+  /*31*/ { ISA_IIX_LDX_iname, ISA_IIX_LDX_desc, ISA_IIX_LDX_help, ISA_IIX_LDX_flags, {0xbb,0xae,0xbb,0xbe,0xbb,0xa2,0xbb,0xbb,0xbb,0xbb,0xa6,0xbb,0xb6,0xbb}, 0x82, 0x00 },
+  /*32*/ { ISA_IIX_LDY_iname, ISA_IIX_LDY_desc, ISA_IIX_LDY_help, ISA_IIX_LDY_flags, {0xbb,0xac,0xbc,0xbb,0xbb,0xa0,0xbb,0xbb,0xbb,0xbb,0xa4,0xb4,0xbb,0xbb}, 0x82, 0x00 },
+  /*33*/ { ISA_IIX_LSR_iname, ISA_IIX_LSR_desc, ISA_IIX_LSR_help, ISA_IIX_LSR_flags, {0xbb,0x4e,0x5e,0xbb,0x4a,0xbb,0xbb,0xbb,0xbb,0xbb,0x46,0x56,0xbb,0xbb}, 0x83, 0x00 },
+  /*34*/ { ISA_IIX_NOP_iname, ISA_IIX_NOP_desc, ISA_IIX_NOP_help, ISA_IIX_NOP_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xea,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /*35*/ { ISA_IIX_ORA_iname, ISA_IIX_ORA_desc, ISA_IIX_ORA_help, ISA_IIX_ORA_flags, {0xbb,0x0d,0x1d,0x19,0xbb,0x09,0xbb,0xbb,0xbb,0x11,0x05,0x15,0xbb,0x01}, 0x82, 0x00 },
+  /*36*/ { ISA_IIX_PHA_iname, ISA_IIX_PHA_desc, ISA_IIX_PHA_help, ISA_IIX_PHA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x48,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /*37*/ { ISA_IIX_PHP_iname, ISA_IIX_PHP_desc, ISA_IIX_PHP_help, ISA_IIX_PHP_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x08,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0xcf },
+  /*38*/ { ISA_IIX_PLA_iname, ISA_IIX_PLA_desc, ISA_IIX_PLA_help, ISA_IIX_PLA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x68,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*39*/ { ISA_IIX_PLP_iname, ISA_IIX_PLP_desc, ISA_IIX_PLP_help, ISA_IIX_PLP_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x28,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0xcf, 0x00 },
+  /*40*/ { ISA_IIX_ROL_iname, ISA_IIX_ROL_desc, ISA_IIX_ROL_help, ISA_IIX_ROL_flags, {0xbb,0x2e,0x3e,0xbb,0x2a,0xbb,0xbb,0xbb,0xbb,0xbb,0x26,0x36,0xbb,0xbb}, 0x83, 0x01 },
+  /*41*/ { ISA_IIX_ROR_iname, ISA_IIX_ROR_desc, ISA_IIX_ROR_help, ISA_IIX_ROR_flags, {0xbb,0x6e,0x7e,0xbb,0x6a,0xbb,0xbb,0xbb,0xbb,0xbb,0x66,0x76,0xbb,0xbb}, 0x83, 0x01 },
+  /*42*/ { ISA_IIX_RTI_iname, ISA_IIX_RTI_desc, ISA_IIX_RTI_help, ISA_IIX_RTI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x40,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0xcf, 0x00 },
+  /*43*/ { ISA_IIX_RTS_iname, ISA_IIX_RTS_desc, ISA_IIX_RTS_help, ISA_IIX_RTS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x60,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /*44*/ { ISA_IIX_SBC_iname, ISA_IIX_SBC_desc, ISA_IIX_SBC_help, ISA_IIX_SBC_flags, {0xbb,0xed,0xfd,0xf9,0xbb,0xe9,0xbb,0xbb,0xbb,0xf1,0xe5,0xf5,0xbb,0xe1}, 0xc3, 0x09 },
+  /*45*/ { ISA_IIX_SEC_iname, ISA_IIX_SEC_desc, ISA_IIX_SEC_help, ISA_IIX_SEC_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x38,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x01, 0x00 },
+  /*46*/ { ISA_IIX_SED_iname, ISA_IIX_SED_desc, ISA_IIX_SED_help, ISA_IIX_SED_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xf8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x08, 0x00 },
+  /*47*/ { ISA_IIX_SEI_iname, ISA_IIX_SEI_desc, ISA_IIX_SEI_help, ISA_IIX_SEI_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x78,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x04, 0x00 },
+  /*48*/ { ISA_IIX_STA_iname, ISA_IIX_STA_desc, ISA_IIX_STA_help, ISA_IIX_STA_flags, {0xbb,0x8d,0x9d,0x99,0xbb,0xbb,0xbb,0xbb,0xbb,0x91,0x85,0x95,0xbb,0x81}, 0x00, 0x00 },
+  /*49*/ { ISA_IIX_STX_iname, ISA_IIX_STX_desc, ISA_IIX_STX_help, ISA_IIX_STX_flags, {0xbb,0x8e,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x86,0xbb,0x96,0xbb}, 0x00, 0x00 },
+  /*50*/ { ISA_IIX_STY_iname, ISA_IIX_STY_desc, ISA_IIX_STY_help, ISA_IIX_STY_flags, {0xbb,0x8c,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x84,0x94,0xbb,0xbb}, 0x00, 0x00 },
+  /*51*/ { ISA_IIX_TAX_iname, ISA_IIX_TAX_desc, ISA_IIX_TAX_help, ISA_IIX_TAX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xaa,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*52*/ { ISA_IIX_TAY_iname, ISA_IIX_TAY_desc, ISA_IIX_TAY_help, ISA_IIX_TAY_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xa8,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*53*/ { ISA_IIX_TSX_iname, ISA_IIX_TSX_desc, ISA_IIX_TSX_help, ISA_IIX_TSX_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xba,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*54*/ { ISA_IIX_TXA_iname, ISA_IIX_TXA_desc, ISA_IIX_TXA_help, ISA_IIX_TXA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x8a,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
+  /*55*/ { ISA_IIX_TXS_iname, ISA_IIX_TXS_desc, ISA_IIX_TXS_help, ISA_IIX_TXS_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x9a,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x00, 0x00 },
+  /*56*/ { ISA_IIX_TYA_iname, ISA_IIX_TYA_desc, ISA_IIX_TYA_help, ISA_IIX_TYA_flags, {0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0x98,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb,0xbb}, 0x82, 0x00 },
 };
 
 const char *  isa_instruction_iname  ( int iix )          { return (const char *)pgm_read_word(&isa_instructions[iix].iname ); }
@@ -565,6 +567,8 @@ const char *  isa_instruction_desc   ( int iix )          { return (const char *
 const char *  isa_instruction_help   ( int iix )          { return (const char *)pgm_read_word(&isa_instructions[iix].help  ); }
 const char *  isa_instruction_flags  ( int iix )          { return (const char *)pgm_read_word(&isa_instructions[iix].flags ); }
 uint8_t       isa_instruction_opcodes( int iix, int aix ) { return (uint8_t     )pgm_read_byte(&isa_instructions[iix].opcodes[aix] ); }
+uint8_t       isa_instruction_fwrites( int iix )          { return (uint8_t     )pgm_read_byte(&isa_instructions[iix].fwrites ); }
+uint8_t       isa_instruction_freads ( int iix )          { return (uint8_t     )pgm_read_byte(&isa_instructions[iix].freads  ); }
 
 // Prints the addressing mode name (eg ABS) associated with `aix` to `str`. 
 // This function writes at most `size` bytes to `str`.
@@ -883,4 +887,125 @@ uint8_t isa_opcode_aix    ( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&is
 uint8_t isa_opcode_cycles ( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&isa_opcodes[opcode].cycles ); }
 uint8_t isa_opcode_xcycles( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&isa_opcodes[opcode].xcycles); }
 
+// The length (in bytes) of the instruction for each opcode; 0 for opcodes not in use.
+// This duplicates isa_addrmode_bytes(isa_opcode_aix(opcode)), but with a single lookup, for scanning memory.
+const uint8_t isa_opcode_lens[] PROGMEM = {
+  /*00*/ 1, 2, 0, 0, 0, 2, 2, 0, 1, 2, 1, 0, 0, 3, 3, 0,
+  /*10*/ 2, 2, 0, 0, 0, 2, 2, 0, 1, 3, 0, 0, 0, 3, 3, 0,
+  /*20*/ 3, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
+  /*30*/ 2, 2, 0, 0, 0, 2, 2, 0, 1, 3, 0, 0, 0, 3, 3, 0,
+  /*40*/ 1, 2, 0, 0, 0, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
+  /*50*/ 2, 2, 0, 0, 0, 2, 2, 0, 1, 3, 0, 0, 0, 3, 3, 0,
+  /*60*/ 1, 2, 0, 0, 0, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
+  /*70*/ 2, 2, 0, 0, 0, 2, 2, 0, 1, 3, 0, 0, 0, 3, 3, 0,
+  /*80*/ 0, 2, 0, 0, 2, 2, 2, 0, 1, 0, 1, 0, 3, 3, 3, 0,
+  /*90*/ 2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 0, 3, 0, 0,
+  /*a0*/ 2, 2, 2, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
+  /*b0*/ 2, 2, 0, 0, 2, 2, 2, 0, 1, 3, 1, 0, 3, 3, 3, 0,
+  /*c0*/ 2, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
+  /*d0*/ 2, 2, 0, 0, 0, 2, 2, 0, 1, 3, 0, 0, 0, 3, 3, 0,
+  /*e0*/ 2, 2, 0, 0, 2, 2, 2, 0, 1, 2, 1, 0, 3, 3, 3, 0,
+  /*f0*/ 2, 2, 0, 0, 0, 2, 2, 0, 1, 3, 0, 0, 0, 3, 3, 0,
+};
+
+uint8_t isa_opcode_bytes  ( uint8_t opcode ) { return (uint8_t)pgm_read_byte(&isa_opcode_lens[opcode]); }
+
+// The cycles of an instruction depend on where it is and what it accesses (datasheet footnotes 1 and 2):
+// - reading with ABX, ABY or ZIY costs one more when indexing crosses a page (the high byte of the address
+//   needs fixing); writing (and read-modify-write) always takes that cycle, so their xcycles is 0
+// - a taken branch costs one more, and another one when it lands in another page than the next instruction
+uint8_t isa_cycles_exact( uint8_t opcode, uint16_t pc, uint16_t base, uint16_t ea, bool taken ) {
+  uint8_t cycles= pgm_read_byte(&isa_opcodes[opcode].cycles);
+  switch( pgm_read_byte(&isa_opcodes[opcode].aix) ) {
+    case ISA_AIX_ABX : case ISA_AIX_ABY : case ISA_AIX_ZIY :
+      if( (base^ea)&0xFF00 ) cycles+= pgm_read_byte(&isa_opcodes[opcode].xcycles);
+      break;
+    case ISA_AIX_REL :
+      if( taken ) cycles+= (((uint16_t)(pc+2)^ea)&0xFF00) ? 2 : 1;
+      break;
+  }
+  return cycles;
+}
+
+
+// SCANNING ####################################################
+
+
+// Fills lens[i] with the length of the instruction that would start at buf[i], for all i in 0..n-1.
+// An opcode not in use gets length 0 (a walker should step over it as 1 byte).
+void isa_scan_lengths( const uint8_t * buf, uint16_t n, uint8_t * lens ) {
+  while( n-- > 0 ) *lens++= pgm_read_byte(&isa_opcode_lens[*buf++]);
+}
+
+// Returns the most likely offset (0, 1 or 2) of the first instruction boundary in the `n` bytes of `buf`.
+// The three instruction chains (starting at offset 0, 1 and 2) are walked in lockstep, each collecting penalties:
+// 4 for an opcode not in use, 4 for an instruction sticking out of `buf`, and 1 for BRK (00 is more likely data).
+// Chains typically merge within a few instructions; once all three are at the same position the walk stops,
+// because the rest would add the same penalties to all. The chain with the lowest penalty wins (ties: lowest offset).
+uint8_t isa_scan_resync( const uint8_t * buf, uint16_t n ) {
+  uint16_t pos[3];
+  uint16_t penalty[3]= {0,0,0};
+  for( uint8_t c=0; c<3; c++ ) pos[c]= c<n ? c : n;
+  while( 1 ) {
+    // Step the chain that is behind the most
+    uint8_t c= 0;
+    if( pos[1]<pos[c] ) c= 1;
+    if( pos[2]<pos[c] ) c= 2;
+    if( pos[c]>=n ) break;
+    if( pos[0]==pos[1] && pos[1]==pos[2] ) break;
+    uint8_t opcode= buf[pos[c]];
+    uint8_t len= pgm_read_byte(&isa_opcode_lens[opcode]);
+    if( len==0 ) { penalty[c]+= 4; len= 1; } else if( opcode==0x00 ) penalty[c]+= 1;
+    if( pos[c]+len>n ) penalty[c]+= 4;
+    pos[c]+= len;
+  }
+  uint8_t best= 0;
+  for( uint8_t c=1; c<3; c++ ) if( penalty[c]<penalty[best] ) best= c;
+  return best;
+}
+
+
+// FUSION ######################################################
+
+
+// The pairs of opcodes that cpu_run() executes in one step (the default pairs of isa6502.py).
+// The bit map has a bit per opcode that starts a pair; the list of pairs is sorted.
+const uint8_t isa_fuse_firsts[] PROGMEM = {
+  0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
+  0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+const uint16_t isa_fuse_pairs[] PROGMEM = {
+  0x1865, // CLC.IMP ADC.ZPG
+  0x1869, // CLC.IMP ADC.IMM
+  0x186D, // CLC.IMP ADC.ABS
+  0xA98D, // LDA.IMM STA.ABS
+  0xC8C0, // INY.IMP CPY.IMM
+  0xC8C4, // INY.IMP CPY.ZPG
+  0xC8CC, // INY.IMP CPY.ABS
+  0xCAD0, // DEX.IMP BNE.REL
+};
+const uint8_t isa_fuse_classes[] PROGMEM = {
+  ISA_FUSE_CARRY,
+  ISA_FUSE_CARRY,
+  ISA_FUSE_CARRY,
+  ISA_FUSE_LDST,
+  ISA_FUSE_INCCMP,
+  ISA_FUSE_INCCMP,
+  ISA_FUSE_INCCMP,
+  ISA_FUSE_INCBRA,
+};
+#define ISA_FUSE_NUM 8
+
+uint8_t isa_opcode_fuse( uint8_t op1, uint8_t op2 ) {
+  if( !(pgm_read_byte(&isa_fuse_firsts[op1>>3]) & (1<<(op1&7))) ) return 0;
+  uint16_t pair= (op1<<8) | op2;
+  for( uint8_t i=0; i<ISA_FUSE_NUM; i++ ) {
+    uint16_t p= pgm_read_word(&isa_fuse_pairs[i]);
+    if( p>=pair ) return p==pair ? pgm_read_byte(&isa_fuse_classes[i]) : 0;
+  }
+  return 0;
+}
+
 
@@ -1,5 +1,5 @@
 // isa.h - 6502 instruction set architecture
-// This file is generated by isa6502.py V7 on 2020-07-19 13:10:50
+// This file is generated by isa6502.py V7 on 2026-10-18 11:39:32
 #ifndef __ISA_H__
 #define __ISA_H__
 
@@ -130,11 +130,22 @@
 // Opcode 0xBB is not in use in the 6502. We use it in instruction.opcodes to signal the addrmode does not exist for that instruction
 #define ISA_OPCODE_INVALID 0xBB
 
+// The flags in the (program) status register; bit masks for isa_instruction_fwrites() and isa_instruction_freads()
+#define ISA_FLAG_N 0x80
+#define ISA_FLAG_V 0x40
+#define ISA_FLAG_B 0x10
+#define ISA_FLAG_D 0x08
+#define ISA_FLAG_I 0x04
+#define ISA_FLAG_Z 0x02
+#define ISA_FLAG_C 0x01
+
 /*PROGMEM*/ const char * isa_instruction_iname  ( int iix );          // The instruction name (e.g. LDA)
 /*PROGMEM*/ const char * isa_instruction_desc   ( int iix );          // The description of the instruction
 /*PROGMEM*/ const char * isa_instruction_help   ( int iix );          // The detailed description of the instruction
 /*PROGMEM*/ const char * isa_instruction_flags  ( int iix );          // The (program status) flags the instruction updates
             uint8_t      isa_instruction_opcodes( int iix, int aix ); // For each addrmode, the actual opcode
+            uint8_t      isa_instruction_fwrites( int iix );          // The flags (ISA_FLAG_xxx mask) the instruction writes (uppercase letters in flags)
+            uint8_t      isa_instruction_freads ( int iix );          // The flags (ISA_FLAG_xxx mask) the instruction reads (so they must be valid)
             int          isa_snprint_iname      (char * str, int size, int minlen, int iix); // Prints the instruction name (eg LDA) associated with `iix` to `str`.
             int          isa_instruction_find   (const char * iname); // Returns iix for `iname` or 0 if not found
 
@@ -148,6 +159,30 @@ uint8_t isa_opcode_iix    ( uint8_t opcode ); // Index into isa_instruction_xxx[
 uint8_t isa_opcode_aix    ( uint8_t opcode ); // Index into isa_addrmode_xxx[]
 uint8_t isa_opcode_cycles ( uint8_t opcode ); // The (minimal) number of cycles to execute this instruction variant (0..)
 uint8_t isa_opcode_xcycles( uint8_t opcode ); // The worst case additional number of cycles to execute this instruction variant (0..)
+uint8_t isa_opcode_bytes  ( uint8_t opcode ); // Number of bytes of the instruction (1..3), 0 for opcodes not in use (single table lookup)
+
+// The exact number of cycles of instruction `opcode` at `pc`, with effective address `ea`. For the indexed modes (ABX, ABY,
+// ZIY) `base` is the address before indexing, for a branch `ea` is the target and `taken` tells whether the branch is taken.
+uint8_t isa_cycles_exact  ( uint8_t opcode, uint16_t pc, uint16_t base, uint16_t ea, bool taken );
+
+
+// Fusion =============================================================
+// Pairs of opcodes that the execution engine executes in one step (see cpu_run), by class of pair
+
+#define ISA_FUSE_LDST   1 // LDA.IMM LDX.IMM LDY.IMM followed by STA.ZPG STA.ABS STX.ZPG STX.ABS STY.ZPG STY.ABS
+#define ISA_FUSE_CARRY  2 // CLC SEC followed by ADC.IMM ADC.ZPG ADC.ABS SBC.IMM SBC.ZPG SBC.ABS
+#define ISA_FUSE_INCBRA 3 // INX INY DEX DEY followed by BNE BEQ BPL BMI
+#define ISA_FUSE_INCCMP 4 // INX INY DEX DEY followed by CMP.IMM CMP.ZPG CMP.ABS CPX.IMM CPX.ZPG CPX.ABS CPY.IMM CPY.ZPG CPY.ABS
+#define ISA_FUSE_CMPBRA 5 // CMP.IMM CMP.ZPG CMP.ABS CPX.IMM CPX.ZPG CPX.ABS CPY.IMM CPY.ZPG CPY.ABS followed by BNE BEQ BCC BCS BPL BMI
+
+uint8_t isa_opcode_fuse   ( uint8_t op1, uint8_t op2 ); // The class (ISA_FUSE_xxx) of the pair in the fusion table, 0 when not in the table
+
+
+// Scanning ===========================================================
+// Finding instruction boundaries in a block of bytes (e.g. a ROM image) copied to RAM.
+
+void    isa_scan_lengths( const uint8_t * buf, uint16_t n, uint8_t * lens ); // lens[i] is isa_opcode_bytes(buf[i]), for all i<n
+uint8_t isa_scan_resync ( const uint8_t * buf, uint16_t n ); // Returns most likely offset (0..2) of first instruction boundary in buf
 
 
 #endif
@@ -0,0 +1,83 @@
+// snap.cpp - snapshot and restore of memory (page granular, copy-on-write)
+
+
+#include <Arduino.h>
+#include "snap.h"
+
+
+#define SNAP_STATE_NONE  0 // No snapshot taken
+#define SNAP_STATE_VALID 1 // Snapshot can be restored
+#define SNAP_STATE_LOST  2 // Too many pages written; snapshot can not be restored
+
+
+static uint8_t  snap_state;
+static uint8_t  snap_dirtybits[SNAP_PAGES/8]; // Bit set when the page has a copy
+static uint16_t snap_num;                     // Number of copies in use
+static uint8_t  snap_page[SNAP_COPIES];       // The page each copy belongs to
+static bool     snap_hascpu;                  // Snapshot includes a cpu
+static cpu_t    snap_cpu;
+#ifdef __AVR__
+static uint8_t  snap_data[SNAP_COPIES][SNAP_PAGE_SIZE];
+#else
+// Copies are allocated on first use, and kept for the next snapshot
+static uint8_t * snap_data[SNAP_COPIES];
+#endif
+
+
+// Returns the memory size (a full 64k memory has mem_size 0)
+static uint32_t snap_memsize(void) {
+  return mem_size==0 ? 0x10000L : mem_size;
+}
+
+
+// Clears all dirty bits (and releases all copies)
+static void snap_clear(void) {
+  for( uint16_t i=0; i<snap_num; i++ ) snap_dirtybits[snap_page[i]/8]&= ~(1<<(snap_page[i]%8));
+  snap_num= 0;
+}
+
+
+uint8_t snap_take(const cpu_t * cpu) {
+  if( snap_memsize() > (uint32_t)SNAP_PAGES*SNAP_PAGE_SIZE || snap_memsize()%SNAP_PAGE_SIZE!=0 ) return SNAP_ERR_SIZE;
+  memset(snap_dirtybits,0,sizeof snap_dirtybits);
+  snap_num= 0;
+  snap_hascpu= cpu!=0;
+  if( cpu ) snap_cpu= *cpu;
+  snap_state= SNAP_STATE_VALID;
+  return SNAP_OK;
+}
+
+
+uint8_t snap_restore(cpu_t * cpu) {
+  if( snap_state==SNAP_STATE_NONE ) return SNAP_ERR_NONE;
+  if( snap_state==SNAP_STATE_LOST ) return SNAP_ERR_LOST;
+  // Writing back does not make copies: the dirty bits of these pages are still set
+  for( uint16_t i=0; i<snap_num; i++ ) {
+    uint16_t addr= snap_page[i]*SNAP_PAGE_SIZE;
+    for( uint16_t j=0; j<SNAP_PAGE_SIZE; j++ ) mem_write(addr+j, snap_data[i][j]);
+  }
+  snap_clear();
+  if( cpu && snap_hascpu ) *cpu= snap_cpu;
+  return SNAP_OK;
+}
+
+
+void snap_write(uint16_t addr) {
+  if( snap_state!=SNAP_STATE_VALID ) return;
+  uint8_t page= (addr%snap_memsize())/SNAP_PAGE_SIZE;
+  if( snap_dirtybits[page/8] & (1<<(page%8)) ) return; // page already has a copy
+  if( snap_num==SNAP_COPIES ) { snap_state= SNAP_STATE_LOST; snap_clear(); return; }
+  #ifndef __AVR__
+  if( snap_data[snap_num]==0 ) snap_data[snap_num]= (uint8_t *)malloc(SNAP_PAGE_SIZE);
+  if( snap_data[snap_num]==0 ) { snap_state= SNAP_STATE_LOST; snap_clear(); return; }
+  #endif
+  uint16_t base= page*SNAP_PAGE_SIZE;
+  for( uint16_t j=0; j<SNAP_PAGE_SIZE; j++ ) snap_data[snap_num][j]= mem_read(base+j);
+  snap_page[snap_num++]= page;
+  snap_dirtybits[page/8]|= 1<<(page%8);
+}
+
+
+uint16_t snap_dirty(void) {
+  return snap_num;
+}
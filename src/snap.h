@@ -0,0 +1,42 @@
+// snap.h - snapshot and restore of memory (page granular, copy-on-write)
+#ifndef __SNAP_H__
+#define __SNAP_H__
+
+
+// The context is expected to implement
+#include <stdint.h>
+#include "cpu.h"
+extern uint8_t mem_read(uint16_t addr);
+extern void    mem_write(uint16_t addr, uint8_t data);
+extern const uint16_t mem_size; // 0 means 64k
+// and to call snap_write(addr) in mem_write(), before the memory is changed
+
+
+// Taking a snapshot copies nothing. The memory is split in pages of SNAP_PAGE_SIZE bytes, with a dirty bit each.
+// The first write to a page after the snapshot copies that page (copy-on-write) and sets its dirty bit.
+// Restoring writes back only the dirty pages, so it costs time proportional to the pages touched.
+// On AVR there are a few page copies only; when more pages are written, the snapshot is lost.
+#ifdef __AVR__
+#define SNAP_PAGE_SIZE  32 // Bytes per page
+#define SNAP_PAGES      32 // Max pages (so mem_size up to 1k)
+#define SNAP_COPIES      4 // Max number of pages that can be written after a snapshot
+#else
+#define SNAP_PAGE_SIZE 256
+#define SNAP_PAGES     256
+#define SNAP_COPIES    256
+#endif
+
+
+#define SNAP_OK        0 // Operation succeeded
+#define SNAP_ERR_NONE  1 // There is no snapshot (to restore)
+#define SNAP_ERR_LOST  2 // The snapshot was lost (more than SNAP_COPIES pages were written)
+#define SNAP_ERR_SIZE  3 // mem_size is too big (more than SNAP_PAGES pages) or not a multiple of SNAP_PAGE_SIZE
+
+
+uint8_t  snap_take   (const cpu_t * cpu); // Takes a snapshot of memory (and of `cpu`, unless 0); returns SNAP_OK or SNAP_ERR_xxx
+uint8_t  snap_restore(cpu_t * cpu);       // Restores memory (and `cpu`, unless 0) to the snapshot; returns SNAP_OK or SNAP_ERR_xxx
+void     snap_write  (uint16_t addr);     // Must be called before memory at `addr` changes (copies its page when needed)
+uint16_t snap_dirty  (void);              // Returns the number of pages written since the snapshot (or its restore)
+
+
+#endif
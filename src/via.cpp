@@ -0,0 +1,124 @@
+// via.cpp - model of a 6522 VIA (versatile interface adapter): timers, ports and IRQ
+
+
+#include <Arduino.h>
+#include "via.h"
+
+
+// A timer loaded with N at cycle s counts N, N-1, .., 0 in cycles s..s+N, is FFFF at s+N+1 (the
+// time-out: its interrupt flag is set), and then continues with FFFE (one-shot), or with N (free-run).
+// So free-run has a period of N+2 cycles.
+
+
+// Drives the IRQ output from the flags and enables
+static void via_irq(via_t * via) {
+  uint8_t level= (via->ifr & via->ier & 0x7F)!=0;
+  if( level==via->irq ) return;
+  via->irq= level;
+  cpu_irq(via->cpu, level);
+}
+
+
+// Returns the counter of a timer loaded with `count` at cycle `start`; `free` for a free-run timer (reloads `count`)
+static uint16_t via_counter(via_t * via, uint16_t count, uint32_t start, bool free) {
+  uint32_t k= via->cpu->cycles - start;
+  if( free && (int32_t)k<0 ) return 0xFFFF; // at the time-out: the reload counts from the next cycle
+  if( !free || k<=count ) return count-k;
+  k= (k-count-1) % ((uint32_t)count+2); // cycles since the first time-out
+  return k==0 ? 0xFFFF : count-(k-1);
+}
+
+
+static void via_t1_timeout(cpu_t * cpu, cpusched_event_t * ev) {
+  (void)cpu;
+  via_t * via= (via_t *)ev->arg;
+  via->ifr|= VIA_INT_T1;
+  if( via->acr & VIA_ACR_T1FREE ) { // reload: the counter is t1latch one cycle after the time-out
+    via->t1count= via->t1latch;
+    via->t1start= ev->when+1;
+    cpusched_post(via->sched, ev, via->t1start+via->t1count+1);
+  }
+  via_irq(via);
+}
+
+
+static void via_t2_timeout(cpu_t * cpu, cpusched_event_t * ev) {
+  (void)cpu;
+  via_t * via= (via_t *)ev->arg;
+  via->ifr|= VIA_INT_T2;
+  via_irq(via);
+}
+
+
+void via_init(via_t * via, cpu_t * cpu, cpusched_t * sched, uint8_t page) {
+  if( via->t1ev.pprev ) cpusched_cancel(via->sched, &via->t1ev);
+  if( via->t2ev.pprev ) cpusched_cancel(via->sched, &via->t2ev);
+  memset(via, 0, sizeof *via);
+  via->cpu= cpu;
+  via->sched= sched;
+  via->page= page;
+  via->ina= 0xFF; // pins float high
+  via->inb= 0xFF;
+  via->t1ev.func= via_t1_timeout;
+  via->t1ev.arg= via;
+  via->t2ev.func= via_t2_timeout;
+  via->t2ev.arg= via;
+  cpu_page_set(page, cpu_page_get(page) | CPU_PAGE_IO);
+}
+
+
+uint8_t via_read(via_t * via, uint16_t addr) {
+  switch( addr & 0x0F ) {
+    case VIA_ORB  : return (via->orb & via->ddrb) | (via->inb & ~via->ddrb);
+    case VIA_ORA  : 
+    case VIA_ORAX : return (via->ora & via->ddra) | (via->ina & ~via->ddra);
+    case VIA_DDRB : return via->ddrb;
+    case VIA_DDRA : return via->ddra;
+    case VIA_T1CL : via->ifr&= ~VIA_INT_T1; via_irq(via); return via_counter(via, via->t1count, via->t1start, via->acr & VIA_ACR_T1FREE) & 0xFF;
+    case VIA_T1CH : return via_counter(via, via->t1count, via->t1start, via->acr & VIA_ACR_T1FREE) >> 8;
+    case VIA_T1LL : return via->t1latch & 0xFF;
+    case VIA_T1LH : return via->t1latch >> 8;
+    case VIA_T2CL : via->ifr&= ~VIA_INT_T2; via_irq(via); return via_counter(via, via->t2count, via->t2start, false) & 0xFF;
+    case VIA_T2CH : return via_counter(via, via->t2count, via->t2start, false) >> 8;
+    case VIA_SR   : return via->sr;
+    case VIA_ACR  : return via->acr;
+    case VIA_PCR  : return via->pcr;
+    case VIA_IFR  : return via->ifr | (via->irq ? VIA_INT_ANY : 0);
+    case VIA_IER  : return via->ier | 0x80;
+  }
+  return 0; // not reached
+}
+
+
+void via_write(via_t * via, uint16_t addr, uint8_t data) {
+  switch( addr & 0x0F ) {
+    case VIA_ORB  : via->orb= data; break;
+    case VIA_ORA  : 
+    case VIA_ORAX : via->ora= data; break;
+    case VIA_DDRB : via->ddrb= data; break;
+    case VIA_DDRA : via->ddra= data; break;
+    case VIA_T1CL : 
+    case VIA_T1LL : via->t1latch= (via->t1latch & 0xFF00) | data; break;
+    case VIA_T1LH : via->t1latch= (via->t1latch & 0x00FF) | (data<<8); via->ifr&= ~VIA_INT_T1; break;
+    case VIA_T1CH : 
+      via->t1latch= (via->t1latch & 0x00FF) | (data<<8);
+      via->t1count= via->t1latch;
+      via->t1start= via->cpu->cycles;
+      via->ifr&= ~VIA_INT_T1;
+      cpusched_post(via->sched, &via->t1ev, via->t1start+via->t1count+1);
+      break;
+    case VIA_T2CL : via->t2latch= data; break;
+    case VIA_T2CH : 
+      via->t2count= via->t2latch | (data<<8);
+      via->t2start= via->cpu->cycles;
+      via->ifr&= ~VIA_INT_T2;
+      if( !(via->acr & VIA_ACR_T2PULS) ) cpusched_post(via->sched, &via->t2ev, via->t2start+via->t2count+1);
+      break;
+    case VIA_SR   : via->sr= data; break;
+    case VIA_ACR  : via->acr= data; break;
+    case VIA_PCR  : via->pcr= data; break;
+    case VIA_IFR  : via->ifr&= ~data; break;
+    case VIA_IER  : if( data & 0x80 ) via->ier|= data & 0x7F; else via->ier&= ~data; break;
+  }
+  via_irq(via);
+}
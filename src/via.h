@@ -0,0 +1,81 @@
+// via.h - model of a 6522 VIA (versatile interface adapter): timers, ports and IRQ
+#ifndef __VIA_H__
+#define __VIA_H__
+
+
+#include <stdint.h>
+#include "cpu.h"
+#include "cpusched.h"
+
+
+// The VIA occupies one memory page (its 16 registers are mirrored in that page); via_init() marks the
+// page as I/O in the cpu page table. The context routes the accesses to that page, from its
+// mem_read() and mem_write(), to via_read() and via_write().
+//
+// The timers are not ticked per cycle. When a timer is started, an event is posted to the scheduler
+// for the cycle it times out; a counter value is computed from the cycle counter when it is read.
+// Timing is relative to the start of the instruction that accesses the VIA.
+// Supported: T1 one-shot and free-run (ACR bit 6), T2 one-shot, IFR, IER and the IRQ output, and the
+// ports A and B (ORx, DDRx; the inputs are set by the context in `ina` and `inb`).
+// Not modelled: PB7 output of T1, T2 pulse counting, shift register, and handshakes (CA1/CA2/CB1/CB2);
+// SR and PCR are plain registers.
+#define VIA_ORB   0x00 // Output register B (read: input register B)
+#define VIA_ORA   0x01 // Output register A (read: input register A)
+#define VIA_DDRB  0x02 // Data direction B (1 is output)
+#define VIA_DDRA  0x03 // Data direction A
+#define VIA_T1CL  0x04 // Write: T1 latch low; read: T1 counter low (clears T1 interrupt)
+#define VIA_T1CH  0x05 // Write: T1 latch high and start T1; read: T1 counter high
+#define VIA_T1LL  0x06 // T1 latch low
+#define VIA_T1LH  0x07 // T1 latch high (write clears T1 interrupt)
+#define VIA_T2CL  0x08 // Write: T2 latch low; read: T2 counter low (clears T2 interrupt)
+#define VIA_T2CH  0x09 // Write: T2 counter high and start T2; read: T2 counter high
+#define VIA_SR    0x0A // Shift register
+#define VIA_ACR   0x0B // Auxiliary control register
+#define VIA_PCR   0x0C // Peripheral control register
+#define VIA_IFR   0x0D // Interrupt flags (write 1s to clear)
+#define VIA_IER   0x0E // Interrupt enable (write bit 7 set: enable the 1s, bit 7 clear: disable the 1s)
+#define VIA_ORAX  0x0F // Output register A, without handshake
+
+
+#define VIA_INT_T1   0x40 // IFR/IER bit of timer 1
+#define VIA_INT_T2   0x20 // IFR/IER bit of timer 2
+#define VIA_INT_ANY  0x80 // IFR bit: an enabled interrupt is flagged (that is, IRQ is asserted)
+
+
+#define VIA_ACR_T1FREE 0x40 // ACR bit: T1 free-run (reloads from latch), else one-shot
+#define VIA_ACR_T2PULS 0x20 // ACR bit: T2 counts pulses on PB6 (not modelled: T2 does not count)
+
+
+typedef struct via_s {
+  cpu_t *          cpu;     // The cpu with the cycle counter for the timers, and the IRQ line the VIA drives
+  cpusched_t *     sched;   // The scheduler for the timer events (typically cpu->sched)
+  uint8_t          page;    // The memory page of the VIA
+  uint8_t          ora;     // Port A output register
+  uint8_t          orb;     // Port B output register
+  uint8_t          ddra;    // Port A data direction
+  uint8_t          ddrb;    // Port B data direction
+  uint8_t          ina;     // Port A input pins (set by the context)
+  uint8_t          inb;     // Port B input pins (set by the context)
+  uint16_t         t1latch; // T1 latch
+  uint16_t         t1count; // T1 counter value at cycle t1start
+  uint32_t         t1start;
+  uint8_t          t2latch; // T2 latch (low byte only)
+  uint16_t         t2count; // T2 counter value at cycle t2start
+  uint32_t         t2start;
+  uint8_t          sr;
+  uint8_t          acr;
+  uint8_t          pcr;
+  uint8_t          ifr;     // Interrupt flags (bit 7 is computed when read)
+  uint8_t          ier;     // Interrupt enables (bit 7 not used)
+  uint8_t          irq;     // Level of the IRQ output
+  cpusched_event_t t1ev;    // Event for the T1 time-out
+  cpusched_event_t t2ev;    // Event for the T2 time-out
+} via_t;
+
+
+void    via_init (via_t * via, cpu_t * cpu, cpusched_t * sched, uint8_t page); // Resets `via` (zeroed, or initialized before), located at memory `page`
+uint8_t via_read (via_t * via, uint16_t addr);               // Reads the register at `addr` (the low 4 bits select the register)
+void    via_write(via_t * via, uint16_t addr, uint8_t data); // Writes the register at `addr`
+
+
+#endif
@@ -0,0 +1,104 @@
+# batch_test.py - differential test of cpubatch: runs random programs with cpubatch_run() and with cpu_step()
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import unittest
+import host
+
+
+# Makes `n` instances from random images (seeded with argv[1]) and runs them for argv[2] cycles, first all with
+# cpubatch_run(), then one by one with cpu_step(). Groups of instances share an image, but differ in zero page and
+# registers. An image is random opcodes (a few not in use, so that some instances halt).
+# Prints the differences and a summary line.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cputrace.h"
+#include "cpubatch.h"
+#include "isa.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k (snap.cpp is linked for cpurec.cpp, but not used)
+void cputrace_put(cputrace_t * trace, cpu_t * cpu, uint8_t opcode) { } // not traced
+#define N     64 // instances
+#define SHARE 16 // instances per image
+static uint8_t * cur; // memory of the instance cpu_step() runs
+uint8_t mem_read(uint16_t addr) { return cur[addr]; }
+void    mem_write(uint16_t addr, uint8_t data) { cur[addr]= data; }
+static uint32_t seed;
+static uint8_t rnd(void) { seed= seed*1103515245 + 12345; return seed>>16; }
+int main(int argc, char * argv[]) {
+  seed= strtoul(argv[1],0,16);
+  uint32_t budget= strtoul(argv[2],0,16);
+  uint8_t * mem= (uint8_t *)malloc(N*0x10000L); // for cpubatch_run()
+  uint8_t * ref= (uint8_t *)malloc(N*0x10000L); // for cpu_step()
+  static cpubatch_state_t init[N], states[N];
+  for( int i=0; i<N; i++ ) {
+    uint8_t * m= mem+i*0x10000L;
+    if( i%SHARE==0 ) {
+      for( long a=0; a<0x10000; a++ ) { uint8_t b; do b= rnd(); while( isa_opcode_iix(b)==0 && rnd()!=0 ); m[a]= b; }
+    } else {
+      memcpy(m,m-0x10000L,0x10000);
+    }
+    for( int a=0; a<0x100; a++ ) m[a]= rnd();
+    init[i].pc= m[0xFFFC] | (m[0xFFFD]<<8);
+    init[i].a= rnd(); init[i].x= rnd(); init[i].y= rnd(); init[i].sp= rnd();
+    init[i].p= (rnd() & ~ISA_FLAG_B) | 0x20;
+    init[i].cycles= 0; init[i].steps= 0; init[i].halted= 0;
+  }
+  memcpy(ref,mem,N*0x10000L);
+  memcpy(states,init,sizeof init);
+  // cpubatch first: it must not depend on a cpu_reset() (e.g. for the decimal table)
+  if( !cpubatch_run(states,mem,N,budget) ) { printf("no memory\\n"); return 1; }
+  int diffs= 0;
+  uint32_t steps= 0, halts= 0;
+  for( int i=0; i<N; i++ ) {
+    static cpu_t cpu;
+    cur= ref+i*0x10000L;
+    cpu_reset(&cpu);
+    cpu.pc= init[i].pc; cpu.a= init[i].a; cpu.x= init[i].x; cpu.y= init[i].y; cpu.sp= init[i].sp;
+    cpu_status_set(&cpu,init[i].p);
+    cpu.cycles= 0;
+    uint32_t n= 0;
+    uint8_t halted= 0;
+    while( cpu.cycles<budget ) { if( cpu_step(&cpu)==0 ) { halted= 1; break; } n++; }
+    uint8_t p= (cpu_status(&cpu) & ~ISA_FLAG_B) | 0x20;
+    cpubatch_state_t * s= &states[i];
+    if( s->pc!=cpu.pc || s->a!=cpu.a || s->x!=cpu.x || s->y!=cpu.y || s->sp!=cpu.sp || s->p!=p || s->cycles!=cpu.cycles || s->steps!=n || s->halted!=halted ) {
+      printf("%2d: batch PC=%04X A=%02X X=%02X Y=%02X S=%02X P=%02X %08X/%X%s", i, s->pc, s->a, s->x, s->y, s->sp, s->p, s->cycles, s->steps, s->halted?" halted":"");
+      printf(" step PC=%04X A=%02X X=%02X Y=%02X S=%02X P=%02X %08X/%X%s\\n", cpu.pc, cpu.a, cpu.x, cpu.y, cpu.sp, p, cpu.cycles, n, halted?" halted":"");
+      diffs++;
+    }
+    if( memcmp(mem+i*0x10000L,cur,0x10000)!=0 ) { printf("%2d: memory differs\\n", i); diffs++; }
+    steps+= n;
+    halts+= halted;
+  }
+  printf("instances %d steps %X halted %X differences %d\\n", N, steps, halts, diffs);
+  return 0;
+}
+"""
+
+
+# Runs the instances made from `seed` for `budget` cycles; returns the output lines
+def run_batch(seed,budget) :
+  return host.run(MAIN_CPP,["cpu.cpp","isa.cpp","cpusched.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp","cpubatch.cpp"],args=[f"{seed:X}",f"{budget:X}"])
+
+
+##########################################################################
+### batch
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_batch(unittest.TestCase):
+
+  # Random programs give the same registers, cycles and memory with cpubatch_run() as with cpu_step()
+  def test_random(self):
+    for seed in (1,2,3) :
+      lines= run_batch(seed,0x4000)
+      self.assertEqual(lines[:-1],[])
+      self.assertRegex(lines[-1],r"^instances 64 steps [0-9A-F]+ halted [0-9A-F]+ differences 0$")
+      self.assertGreater(int(lines[-1].split()[3],16),64*0x100) # the programs ran a while
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -9,6 +9,8 @@
 import re
 import sys
 import glob
+import time
+import binascii
 import serial
 import datetime
 
@@ -62,6 +64,20 @@ class CmdException(Exception):
 #     return h[:-1]
 
     
+# Parameters of the binary transfer protocol of the 'load' and 'save' commands (see cmdxfer.cpp)
+XFER_FRAME= 32
+XFER_WINDOW= 4
+XFER_ACK= 0x06
+XFER_NAK= 0x15
+
+
+def xfer_frame(seq,data):
+    """Returns the frame for 'data' with number 'seq': <seq> <len> <data> <crc-lo> <crc-hi>."""
+    frame= bytes([seq%256,len(data)])+bytes(data)
+    crc= binascii.crc_hqx(frame,0xFFFF) # CRC-16/CCITT
+    return frame+bytes([crc&0xFF,crc>>8])
+
+
 class Cmd:
     """A driver for the cmd library, offering the low-level exec() command command."""
     def __init__(self, port=None):
@@ -115,9 +131,13 @@ class Cmd:
         return not self.serial is None
     def exec(self,icmd,isync=">> "):
         """Send command 'icmd' to the command interpreter; waiting for dongle response to have 'isync'. Returns response up to 'isync'."""
-        cmd= icmd.encode(); sync= isync.encode() # Convert strings to bytes
+        cmd= icmd.encode() # Convert strings to bytes
         self.serial.write(cmd+b"\r") # Send bytes with <CR> to command interpreter
         if self.logfile!=None: self.log(icmd+"\r",">") # Log the command that was send
+        return self.wait(isync)
+    def wait(self,isync=">> "):
+        """Waits for the command interpreter to send 'isync'. Returns response up to 'isync'."""
+        sync= isync.encode() # Convert strings to bytes
         pos,tries = -1,0
         while (pos<0) and (tries<100):
             self.rxbuf+= self.serial.read(1000)
@@ -129,6 +149,53 @@ class Cmd:
         res=self.rxbuf[:pos]
         self.rxbuf=self.rxbuf[pos+len(sync):]
         return res.decode() # Convert bytes to strings
+    def read(self,num,timeout=1.0):
+        """Reads 'num' raw bytes from the command interpreter (first from the receive buffer). Returns fewer bytes on timeout."""
+        deadline= time.time()+timeout
+        while len(self.rxbuf)<num and time.time()<deadline:
+            self.rxbuf+= self.serial.read(num-len(self.rxbuf))
+        res=self.rxbuf[:num]
+        self.rxbuf=self.rxbuf[num:]
+        return res
+    def quiet(self):
+        """Discards received bytes until the line is quiet (see CMDXFER_QUIET in cmdxfer.cpp)."""
+        self.rxbuf=b""
+        while self.serial.read(1000)!=b"": pass
+    def load(self,addr,data,window=XFER_WINDOW):
+        """Writes the bytes 'data' to memory at 'addr' using the binary 'load' command. Returns the response text."""
+        frames= [data[i:i+XFER_FRAME] for i in range(0,len(data),XFER_FRAME)]
+        self.exec(f"load {addr:04X} {len(data)%0x10000:04X}","INFO: load ready\r\n")
+        base,next = 0,0 # oldest unacknowledged frame, next frame to send
+        while base<len(frames):
+            while next<len(frames) and next-base<window:
+                self.serial.write(xfer_frame(next,frames[next]))
+                next+= 1
+            res= self.read(2)
+            if len(res)<2: raise CmdException("load(): no acknowledge ["+(res+self.read(1000,0.1)).decode(errors="replace")+"]")
+            ix= (res[1]-base)%256 # frame index relative to base
+            if base+ix>=next: continue # stale
+            if res[0]==XFER_ACK: base= base+ix+1
+            elif res[0]==XFER_NAK: base,next = base+ix,base+ix # go back
+            else: raise CmdException("load(): unexpected acknowledge ["+res.hex()+"]")
+        return self.wait()
+    def save(self,addr,num):
+        """Reads 'num' bytes from memory at 'addr' using the binary 'save' command. Returns the bytes."""
+        self.exec(f"save {addr:04X} {num%0x10000:04X}","INFO: save ready\r\n")
+        data= b""
+        while len(data)<num:
+            seq= len(data)//XFER_FRAME%256
+            size= min(XFER_FRAME,num-len(data))
+            frame= self.read(2+size+2)
+            if len(frame)==0:
+                raise CmdException("save(): no frame received")
+            elif frame==xfer_frame(seq,frame[2:2+size]):
+                data+= frame[2:2+size]
+                self.serial.write(bytes([XFER_ACK,seq]))
+            else:
+                self.quiet()
+                self.serial.write(bytes([XFER_NAK,seq]))
+        self.wait()
+        return data
 
 
 def findports():
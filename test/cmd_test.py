@@ -167,6 +167,7 @@ class Test_help(unittest.TestCase):
     self.assertIn("read -",r) 
     self.assertIn("write -",r) 
     self.assertIn("prog -",r)
+    self.assertIn("console -",r)
 
   # The help <cmd> command lists details
   def test_sub(self):
@@ -537,6 +538,15 @@ class Test_read(unittest.TestCase):
     r= self.cmd.exec("read - 2") 
     self.assertIn("0202: EA 33\r\n",r) 
 
+  # The 'read' command does not read an I/O page (the console at 8000), so it takes no received byte
+  def test_io(self):
+    n= int(self.cmd.exec("console").split()[-2],16)
+    self.cmd.exec("console 41") 
+    r= self.cmd.exec("read 7FFE 4") 
+    self.assertEqual("7FFE: 00 00 ?? ??\r\n",r) 
+    r= self.cmd.exec("console") 
+    self.assertEqual(f"INFO: console input has {n+1:X} bytes\r\n",r) 
+
 ##########################################################################
 ### write
 ##########################################################################
@@ -750,6 +760,14 @@ class Test_dasm(unittest.TestCase):
     r= self.cmd.exec("dasm 240 00") 
     self.assertEqual("",r) 
 
+  # The 'dasm' command can sync to an instruction boundary
+  def test_sync(self):
+    self.cmd.exec("write 0200 A2 20 A0 30 AD BA AB C9 11 D0 F5 18 4C 04 02 00") 
+    r= self.cmd.exec("dasm 203 2 sync") 
+    self.assertEqual("INFO: skipped 1 bytes to sync\r\n0204 AD BA AB LDA ABBA\r\n0207 C9 11    CMP #11\r\n",r) 
+    r= self.cmd.exec("dasm 200 1 s") 
+    self.assertEqual("0200 A2 20    LDX #20\r\n",r) 
+
   # The 'dasm' command also continues from assembler
   def test_asm(self):
     self.cmd.exec("write 0200 A2 20 A0 30 AD BA AB C9 11 D0 F5 18 4C 04 02 00") 
@@ -758,6 +776,12 @@ class Test_dasm(unittest.TestCase):
     r= self.cmd.exec("dasm - 2") 
     self.assertIn("0202 06 05    ASL *05\r\n",r) 
 
+  # The 'dasm' command does not read an I/O page (the console at 8000)
+  def test_io(self):
+    self.cmd.exec("write 7FFE EA AD") # NOP, LDA abs with its operand on the I/O page
+    r= self.cmd.exec("dasm 7FFE 3") 
+    self.assertEqual("7FFE EA       NOP\r\n7FFF AD ??\r\n8000 ??\r\n",r) 
+
 
 #########################################################################
 ### asm
@@ -798,8 +822,12 @@ class Test_asm(unittest.TestCase):
     self.assertEqual("ERROR: syntax error in operand '**'\r\n",r) 
     r= self.cmd.exec("asm lda +1")
     self.assertEqual("ERROR: instruction 'LDA' does not have addressing mode REL\r\n",r) 
+    r= self.cmd.exec("asm lda f.o")
+    self.assertEqual("ERROR: operand must be <hex> or <label>, not 'f.o'\r\n",r) 
     r= self.cmd.exec("asm lda foo")
-    self.assertEqual("ERROR: operand must be <hex>, not 'foo'\r\n",r) 
+    self.assertEqual("ERROR: undefined label 'foo' (forward references need streaming mode)\r\n",r) 
+    r= self.cmd.exec("asm dead: nop")
+    self.assertEqual("ERROR: label 'dead' must be an identifier (max 8 chars), not a hex lookalike or reserved word\r\n",r) 
     r= self.cmd.exec("asm lda #123")
     self.assertEqual("ERROR: operand must be 00..ff, not '123'\r\n",r) 
     r= self.cmd.exec("asm lda #12 foo")
@@ -885,6 +913,51 @@ class Test_asm(unittest.TestCase):
     r= self.cmd.exec("-", "> ")
     self.assertEqual("ERROR: can not undo\r\nA:0200",r) 
 
+  # The asm command restores overwritten bytes on undo, and has redo
+  def test_asm_redo(self) :
+    self.cmd.exec("write 0200 11 22 33 44 55")
+    self.cmd.exec("asm 200", "> ")
+    self.cmd.exec("lda #1", "> ")
+    r= self.cmd.exec("lda 1234", "> ")
+    self.assertEqual("A:0205",r) 
+    r= self.cmd.exec("-", "> ")
+    self.assertEqual("A:0202",r) 
+    r= self.cmd.exec("-", "> ")
+    self.assertEqual("A:0200",r) 
+    r= self.cmd.exec("+", "> ")
+    self.assertEqual("A:0202",r) 
+    r= self.cmd.exec("+", "> ")
+    self.assertEqual("A:0205",r) 
+    r= self.cmd.exec("+", "> ")
+    self.assertEqual("ERROR: can not redo\r\nA:0205",r) 
+    r= self.cmd.exec("-", "> ")
+    self.assertEqual("A:0202",r) 
+    self.cmd.exec("") # Stop streaming
+    r= self.cmd.exec("read 0200 5")
+    self.assertEqual("0200: A9 01 33 44 55\r\n",r)
+
+  # The asm command supports labels, also forward references in streaming mode
+  def test_asm_labels(self) :
+    r= self.cmd.exec("asm 200 self: bne self")
+    self.assertEqual("",r) 
+    r= self.cmd.exec("dasm 200 1")
+    self.assertEqual("0200 D0 FE    BNE +FE (0200)\r\n",r) 
+    self.cmd.exec("asm 200", "> ")
+    self.cmd.exec("ldx #5", "> ")
+    self.cmd.exec("loop: dex", "> ")
+    self.cmd.exec("bne loop", "> ")
+    self.cmd.exec("beq done", "> ")
+    self.cmd.exec("jmp done", "> ")
+    r= self.cmd.exec("done:", "> ")
+    self.assertEqual("A:020a",r) 
+    r= self.cmd.exec("loop:", "> ")
+    self.assertEqual("ERROR: label 'loop' already defined (0202)\r\nA:020a",r) 
+    self.cmd.exec("jmp nowhere", "> ")
+    r= self.cmd.exec("") # Stop streaming
+    self.assertEqual("WARNING: unresolved label 'nowhere' at 020A\r\n",r) 
+    r= self.cmd.exec("dasm 200 6")
+    self.assertEqual("0200 A2 05    LDX #05\r\n0202 CA       DEX\r\n0203 D0 FD    BNE +FD (0202)\r\n0205 F0 03    BEQ +03 (020A)\r\n0207 4C 0A 02 JMP 020A\r\n020A 4C 00 00 JMP 0000\r\n",r)
+
   # test instruction ADC - GENERATED BY isa6502.py
   def test_asm_ADC(self) :
     self.cmd.exec("asm 200", "> ") # Start streaming
@@ -1428,6 +1501,924 @@ class Test_asm(unittest.TestCase):
     r= self.cmd.exec("dasm 0200 01")
     self.assertEqual("0200 98       TYA\r\n",r)
 
+##########################################################################
+### load
+##########################################################################
+
+class Test_load(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help load")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: load",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("<num> 0000 means 10000 (the full 64k)",r) 
+
+  # Erroneous args
+  def test_errargs(self):
+    r= self.cmd.exec("load")
+    self.assertEqual("ERROR: insufficient arguments, need <addr> and <num>\r\n",r) 
+    r= self.cmd.exec("load foo 10")
+    self.assertEqual("ERROR: expected hex <addr>, not 'foo'\r\n",r) 
+    r= self.cmd.exec("load 0200 bar")
+    self.assertEqual("ERROR: expected hex <num>, not 'bar'\r\n",r) 
+    r= self.cmd.exec("load 0200 10 baz")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # The load command writes the received frames to memory
+  def test_load(self):
+    data= bytes( (i*7+3)%256 for i in range(0x50) )
+    r= self.cmd.load(0x200,data)
+    self.assertEqual("INFO: loaded 50 bytes\r\n",r) 
+    r= self.cmd.exec("read 200 4") 
+    self.assertEqual("0200: 03 0A 11 18\r\n",r) 
+    r= self.cmd.exec("read 24E 2") 
+    self.assertEqual("024E: 25 2C\r\n",r) 
+
+  # The load command rejects a frame with a bad CRC, and accepts the resent frame
+  def test_badframe(self):
+    self.cmd.exec("load 0200 2","INFO: load ready\r\n")
+    frame= bytearray(cmd.xfer_frame(0,b"\x12\x34"))
+    frame[-1]^= 0xFF # corrupt CRC
+    self.cmd.serial.write(frame)
+    self.assertEqual(bytes([cmd.XFER_NAK,0]),self.cmd.read(2)) 
+    self.cmd.serial.write(cmd.xfer_frame(0,b"\x12\x34"))
+    self.assertEqual(bytes([cmd.XFER_ACK,0]),self.cmd.read(2)) 
+    r= self.cmd.wait()
+    self.assertEqual("INFO: loaded 2 bytes\r\n",r) 
+    r= self.cmd.exec("read 200 2") 
+    self.assertEqual("0200: 12 34\r\n",r) 
+
+##########################################################################
+### save
+##########################################################################
+
+class Test_save(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help save")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: save",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("<num> 0000 means 10000 (the full 64k)",r) 
+
+  # Erroneous args
+  def test_errargs(self):
+    r= self.cmd.exec("save")
+    self.assertEqual("ERROR: insufficient arguments, need <addr> and <num>\r\n",r) 
+    r= self.cmd.exec("save foo 10")
+    self.assertEqual("ERROR: expected hex <addr>, not 'foo'\r\n",r) 
+    r= self.cmd.exec("save 0200 bar")
+    self.assertEqual("ERROR: expected hex <num>, not 'bar'\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # The save command sends memory in frames
+  def test_save(self):
+    self.cmd.exec("write 0200 00 11 22 33 44 55 66 77 88 99 AA BB CC DD EE FF") 
+    data= self.cmd.save(0x200,0x10)
+    self.assertEqual(bytes.fromhex("00112233445566778899AABBCCDDEEFF"),data) 
+    # More than a window of frames
+    data= bytes( (i*7+3)%256 for i in range(0x100) )
+    self.cmd.load(0x200,data)
+    self.assertEqual(data,self.cmd.save(0x200,0x100)) 
+
+  # The save command resends frames after a negative acknowledge
+  def test_nak(self):
+    self.cmd.exec("write 0200 12 34") 
+    self.cmd.exec("save 0200 2","INFO: save ready\r\n")
+    self.assertEqual(cmd.xfer_frame(0,b"\x12\x34"),self.cmd.read(6)) 
+    self.cmd.serial.write(bytes([cmd.XFER_NAK,0]))
+    self.assertEqual(cmd.xfer_frame(0,b"\x12\x34"),self.cmd.read(6)) 
+    self.cmd.serial.write(bytes([cmd.XFER_ACK,0]))
+    r= self.cmd.wait()
+    self.assertEqual("INFO: saved 2 bytes\r\n",r) 
+
+##########################################################################
+### import
+##########################################################################
+
+class Test_import(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help import")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: import",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("records with a bad length or checksum are rejected",r) 
+
+  # Erroneous records
+  def test_errrecord(self):
+    r= self.cmd.exec("import 0200")
+    self.assertEqual("ERROR: record must start with ':' (Intel HEX) or 'S' (S-record)\r\n",r) 
+    r= self.cmd.exec("import :0102000012E")
+    self.assertEqual("ERROR: record must be hex digit pairs (max 28 bytes)\r\n",r) 
+    r= self.cmd.exec("import :0202000012EB")
+    self.assertEqual("ERROR: record length mismatch\r\n",r) 
+    r= self.cmd.exec("import :0102000012EC")
+    self.assertEqual("ERROR: record checksum mismatch (expected EB)\r\n",r) 
+    r= self.cmd.exec("import :020000040001F9")
+    self.assertEqual("ERROR: address beyond 64k\r\n",r) 
+    r= self.cmd.exec("import S20500020012E6")
+    self.assertEqual("ERROR: unsupported record type S2\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # A single record is written to memory
+  def test_import(self):
+    self.cmd.exec("write 0200 00 00 00")
+    r= self.cmd.exec("import :030200001234565F")
+    self.assertEqual("",r) 
+    r= self.cmd.exec("read 200 3") 
+    self.assertEqual("0200: 12 34 56\r\n",r) 
+    r= self.cmd.exec("import S1060200ABCDEF90")
+    self.assertEqual("",r) 
+    r= self.cmd.exec("read 200 3") 
+    self.assertEqual("0200: AB CD EF\r\n",r) 
+
+  # Streaming mode ends with the end record, and reports bad records
+  def test_stream(self):
+    self.cmd.exec("write 0200 00 00 00")
+    r= self.cmd.exec("import", "> ")
+    self.assertEqual("I:0000",r[-6:]) 
+    r= self.cmd.exec(":030200001234565F", "> ")
+    self.assertEqual("I:0203",r) 
+    r= self.cmd.exec(":0302000012345660", "> ")
+    self.assertEqual("ERROR: record checksum mismatch (expected 5F)\r\nI:0203",r) 
+    r= self.cmd.exec(":00000001FF")
+    self.assertEqual("INFO: imported 3 bytes, 1 bad records\r\n",r) 
+    r= self.cmd.exec("read 200 3") 
+    self.assertEqual("0200: 12 34 56\r\n",r) 
+
+  # The output of 'prog compile hex' and 'prog compile srec' can be imported
+  def test_roundtrip(self):
+    self.cmd.exec("prog new example")
+    self.cmd.wait() # the example is streamed in with its own prompts
+    for fmt in ["hex","srec"] :
+      self.cmd.exec("write 0200 00 00 00 00")
+      r= self.cmd.exec("prog compile "+fmt)
+      records= r.split("\r\n")[2:-1] # skip INFO and blank line
+      self.cmd.exec("import", "> ")
+      for rec in records[:-1] :
+        self.cmd.exec(rec, "> ")
+      r= self.cmd.exec(records[-1])
+      self.assertEqual("INFO: imported 15 bytes, 0 bad records\r\n",r) 
+      r= self.cmd.exec("read 200 4") 
+      self.assertEqual("0200: A2 05 BD 00\r\n",r) 
+
+
+###########################################################################
+### Prog
+###########################################################################
+
+class Test_prog(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The listing can also be annotated with the cycles per instruction, basic block and loop iteration
+  def test_cycles(self):
+    self.cmd.exec("prog new")
+    self.cmd.exec("prog insert 0 .ORG 0300")
+    self.cmd.exec("prog insert 1 LDA 0310,X")
+    self.cmd.exec("prog insert 2 loop DEX")
+    self.cmd.exec("prog insert 3 BNE loop")
+    self.cmd.exec("prog insert 4 RTS")
+    r= self.cmd.exec("prog compile list cycles")
+    self.assertIn("0300 | BD 10 03    | 4-5    | 001          LDA 0310,X\r\n"
+      "     |             | 4-5    | block 0300-0302\r\n"
+      "0303 | CA          | 2      | 002 loop     DEX \r\n"
+      "0304 | D0 FD       | 2/3    | 003          BNE loop\r\n"
+      "     |             | 4-5    | block 0303-0305\r\n"
+      "     |             | 5      | loop 0303-0305 per iteration\r\n"
+      "0306 | 60          | 6      | 004          RTS \r\n",r) 
+    r= self.cmd.exec("prog compile list cycles x")
+    self.assertEqual("ERROR: expected prof or cycles, not 'x'\r\n",r) 
+
+  # The worst case cycles of each routine, with the bounds of the loops given in comments
+  def test_wcet(self):
+    self.cmd.exec("prog new")
+    self.cmd.exec("prog insert 0 .ORG 0200")
+    self.cmd.exec("prog insert 1 LDX #05")
+    self.cmd.exec("prog insert 2 loop DEX")
+    self.cmd.exec("prog insert 3 BNE loop")
+    self.cmd.exec("prog insert 4 JSR wait")
+    self.cmd.exec("prog insert 5 RTS")
+    self.cmd.exec("prog insert 6 wait DEC 0310")
+    self.cmd.exec("prog insert 7 BNE wait")
+    self.cmd.exec("prog insert 8 RTS")
+    r= self.cmd.exec("prog compile wcet")
+    self.assertIn("WARNING: loop on line 6 has no bound (add '; loop <num>' before it)\r\n",r) 
+    self.assertIn("routines: addr (ln ln#) kind cycles\r\n"
+      " 0200 (ln 001) reset unbounded\r\n"
+      " 0209 (ln 006) sub   unbounded\r\n",r) 
+    self.cmd.exec("prog insert 6 ; loop 10")
+    r= self.cmd.exec("prog compile wcet")
+    self.assertIn("routines: addr (ln ln#) kind cycles\r\n"
+      " 0200 (ln 001) reset BD\r\n"
+      " 0209 (ln 007) sub   96\r\n",r) 
+    r= self.cmd.exec("prog compile wcet x")
+    self.assertEqual("ERROR: expected hex <budget>, not 'x'\r\n",r) 
+
+  # The worst case cycles of the NMI and IRQ handlers (from the vectors), with a warning when one exceeds the budget
+  def test_wcet_irq(self):
+    self.cmd.exec("prog new")
+    self.cmd.exec("prog insert 0 .ORG 0200")
+    self.cmd.exec("prog insert 1 LDX #03")
+    self.cmd.exec("prog insert 2 loop DEX")
+    self.cmd.exec("prog insert 3 BNE loop")
+    self.cmd.exec("prog insert 4 stop JMP stop")
+    self.cmd.exec("prog insert 5 RTI") # 0208 nmi
+    self.cmd.exec("prog insert 6 ; loop 20")
+    self.cmd.exec("prog insert 7 irq DEC 0310") # 0209 irq
+    self.cmd.exec("prog insert 8 BNE irq")
+    self.cmd.exec("prog insert 9 RTI")
+    self.cmd.exec("prog insert A .ORG FFFA")
+    self.cmd.exec("prog insert B .DW 0208")
+    self.cmd.exec("prog insert C .DW 0200")
+    self.cmd.exec("prog insert D .DW 0209")
+    r= self.cmd.exec("prog compile wcet 126")
+    self.assertIn("routines: addr (ln ln#) kind cycles\r\n"
+      " 0200 (ln 001) reset unbounded\r\n"
+      " 0208 (ln 005) nmi   6\r\n"
+      " 0209 (ln 007) irq   126\r\n"
+      "INFO: warnings 1\r\n",r) # the JMP stop loop has no bound
+    r= self.cmd.exec("prog compile wcet 125")
+    self.assertIn(" 0209 (ln 007) irq   126\r\n"
+      "WARNING: irq handler at 0209 exceeds budget 125\r\n"
+      "INFO: warnings 2\r\n",r) 
+    r= self.cmd.exec("prog compile wcet 5")
+    self.assertIn("WARNING: nmi handler at 0208 exceeds budget 5\r\n",r) 
+    self.assertIn("INFO: warnings 3\r\n",r) 
+
+
+###########################################################################
+### Snapshot
+###########################################################################
+
+class Test_snapshot(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help snapshot")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: snapshot",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("a page is copied when it is first written",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("snapshot 0200")
+    self.assertEqual("ERROR: no arguments allowed\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # A new snapshot replaces the old one
+  def test_snapshot(self):
+    self.cmd.exec("write 0200 11")
+    r= self.cmd.exec("snapshot")
+    self.assertEqual("INFO: snapshot taken\r\n",r) 
+    self.cmd.exec("write 0200 22")
+    r= self.cmd.exec("snapshot")
+    self.assertEqual("INFO: snapshot taken\r\n",r) 
+    self.cmd.exec("write 0200 33")
+    r= self.cmd.exec("restore")
+    self.assertEqual("INFO: restored 1 pages\r\n",r) 
+    r= self.cmd.exec("read 200 1") 
+    self.assertEqual("0200: 22\r\n",r) 
+
+
+###########################################################################
+### Restore
+###########################################################################
+
+class Test_restore(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help restore")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: restore",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("only pages written since the snapshot are restored",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("restore 0200")
+    self.assertEqual("ERROR: no arguments allowed\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Only written pages are restored, and the snapshot can be restored again
+  def test_restore(self):
+    self.cmd.exec("write 0000 11 22")
+    self.cmd.exec("write 0300 33")
+    self.cmd.exec("snapshot")
+    r= self.cmd.exec("restore")
+    self.assertEqual("INFO: restored 0 pages\r\n",r) 
+    self.cmd.exec("write 0000 44")
+    self.cmd.exec("write 0300 55")
+    r= self.cmd.exec("restore")
+    self.assertEqual("INFO: restored 2 pages\r\n",r) 
+    r= self.cmd.exec("read 0 2") 
+    self.assertEqual("0000: 11 22\r\n",r) 
+    r= self.cmd.exec("read 300 1") 
+    self.assertEqual("0300: 33\r\n",r) 
+    self.cmd.exec("write 0001 66")
+    r= self.cmd.exec("restore")
+    self.assertEqual("INFO: restored 1 pages\r\n",r) 
+    r= self.cmd.exec("read 0 2") 
+    self.assertEqual("0000: 11 22\r\n",r) 
+
+###########################################################################
+### Break
+###########################################################################
+
+class Test_break(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    self.cmd.exec("break clr")
+    
+  def tearDown(self):
+    self.cmd.exec("break clr")
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help break")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: break",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("execution stops before the instruction at a breakpoint",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("break xyz")
+    self.assertEqual("ERROR: expected hex <addr>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("break clr xyz")
+    self.assertEqual("ERROR: expected hex <addr>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("break 0200 0300")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Set, list and clear
+  def test_break(self):
+    r= self.cmd.exec("break")
+    self.assertEqual("INFO: no breakpoints\r\n",r) 
+    r= self.cmd.exec("break 1234")
+    self.assertEqual("",r) 
+    self.cmd.exec("break 0208")
+    r= self.cmd.exec("break")
+    self.assertEqual("0208\r\n1234\r\n",r) 
+    self.cmd.exec("break cl 1234")
+    r= self.cmd.exec("break")
+    self.assertEqual("0208\r\n",r) 
+    self.cmd.exec("break clr")
+    r= self.cmd.exec("break")
+    self.assertEqual("INFO: no breakpoints\r\n",r) 
+
+  # The last page (the list must end)
+  def test_lastpage(self):
+    self.cmd.exec("break FFFF")
+    self.cmd.exec("break FF10")
+    r= self.cmd.exec("break")
+    self.assertEqual("FF10\r\nFFFF\r\n",r) 
+
+
+###########################################################################
+### Watch
+###########################################################################
+
+class Test_watch(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    self.cmd.exec("watch clr")
+    
+  def tearDown(self):
+    self.cmd.exec("watch clr")
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help watch")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: watch",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("execution stops after the instruction that accessed a watched address",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("watch xyz")
+    self.assertEqual("ERROR: expected hex <addr>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("watch 0300 x")
+    self.assertEqual("ERROR: expected r, w or rw, not 'x'\r\n",r) 
+    r= self.cmd.exec("watch 0300 r w")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+    for addr in ["0300","0301","0302","0303"] :
+      self.cmd.exec("watch "+addr)
+    r= self.cmd.exec("watch 0304")
+    self.assertEqual("ERROR: too many watchpoints (max 4)\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Set, list and clear
+  def test_watch(self):
+    r= self.cmd.exec("watch")
+    self.assertEqual("INFO: no watchpoints\r\n",r) 
+    r= self.cmd.exec("watch 0300 w")
+    self.assertEqual("",r) 
+    self.cmd.exec("watch 0301")
+    self.cmd.exec("watch 0302 r")
+    r= self.cmd.exec("watch")
+    self.assertEqual("0300 w\r\n0301 rw\r\n0302 r\r\n",r) 
+    self.cmd.exec("watch cl 0301")
+    r= self.cmd.exec("watch")
+    self.assertEqual("0300 w\r\n0302 r\r\n",r) 
+    self.cmd.exec("watch clr")
+    r= self.cmd.exec("watch")
+    self.assertEqual("INFO: no watchpoints\r\n",r) 
+
+  # The last page (the list must end)
+  def test_lastpage(self):
+    self.cmd.exec("watch FFFF w")
+    self.cmd.exec("watch FF10")
+    r= self.cmd.exec("watch")
+    self.assertEqual("FF10 rw\r\nFFFF w\r\n",r) 
+
+
+###########################################################################
+### Prof
+###########################################################################
+
+class Test_prof(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    self.cmd.exec("prof clr")
+    
+  def tearDown(self):
+    self.cmd.exec("prof clr")
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help prof")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: prof",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("'prog compile list prof' annotates the listing",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("prof xyz")
+    self.assertEqual("ERROR: expected on, off, clr, pairs or hex <num>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("prof 0")
+    self.assertEqual("ERROR: <num> must be 1..10\r\n",r) 
+    r= self.cmd.exec("prof 11")
+    self.assertEqual("ERROR: <num> must be 1..10\r\n",r) 
+    r= self.cmd.exec("prof on off")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Start, stop and free
+  def test_prof(self):
+    r= self.cmd.exec("prof")
+    self.assertEqual("INFO: no profile (use 'prof on')\r\n",r) 
+    r= self.cmd.exec("prog compile list prof")
+    self.assertEqual("ERROR: no profile (see 'prof')\r\n",r) 
+    r= self.cmd.exec("prof on")
+    self.assertEqual("",r) 
+    r= self.cmd.exec("prof")
+    self.assertEqual("INFO: profile is empty\r\n",r) 
+    r= self.cmd.exec("prof off")
+    self.assertEqual("",r) 
+    r= self.cmd.exec("prof 4")
+    self.assertEqual("INFO: profile is empty\r\n",r) 
+    self.cmd.exec("prof cl")
+    r= self.cmd.exec("prof")
+    self.assertEqual("INFO: no profile (use 'prof on')\r\n",r) 
+
+  # Pairs of opcodes executed in sequence (input for the fusion table of isa6502.py)
+  def test_pairs(self):
+    r= self.cmd.exec("prof pairs")
+    if r=="ERROR: no pair counts on this target\r\n" : # AVR has no room for the pair counts
+      self.cmd.exec("prof on")
+      r= self.cmd.exec("prof pairs")
+      self.assertEqual("ERROR: no pair counts on this target\r\n",r) 
+      return
+    self.assertEqual("INFO: no profile (use 'prof on')\r\n",r) 
+    self.cmd.exec(PROG_LOOP)
+    self.cmd.exec("prof on")
+    self.cmd.exec("run 0200 10")
+    r= self.cmd.exec("prof pairs")
+    self.assertEqual("pair  count    share  instructions\r\n"
+      "CA D0 00000003  50.0% DEX.IMP BNE.REL\r\n"
+      "D0 CA 00000002  33.3% BNE.REL DEX.IMP\r\n"
+      "A2 CA 00000001  16.6% LDX.IMM DEX.IMP\r\n"
+      "total 00000006\r\n",r) 
+
+
+###########################################################################
+### Run
+###########################################################################
+
+# A loop that ends in a jump to itself: LDX #03 / DEX / BNE 0202 / JMP 0205
+PROG_LOOP= "write 0200 A2 03 CA D0 FD 4C 05 02"
+
+class Test_run(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    self.cmd.exec(PROG_LOOP)
+    
+  def tearDown(self):
+    self.cmd.exec("break clr")
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help run")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: run",r) 
+    self.assertIn("SYNTAX: run stop",r) 
+    self.assertIn("SYNTAX: run reset",r) 
+    self.assertIn("SYNTAX: run record",r) 
+    self.assertIn("SYNTAX: run replay",r) 
+    self.assertIn("SYNTAX: run pace",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("between bursts commands are accepted",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("run xyz")
+    self.assertEqual("ERROR: expected hex <addr>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("run 0200 xyz")
+    self.assertEqual("ERROR: expected hex <cycles>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("run 0200 123456789")
+    self.assertEqual("ERROR: expected hex <cycles>, not '123456789'\r\n",r) 
+    r= self.cmd.exec("run 0200 10 20")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+    r= self.cmd.exec("run stop")
+    self.assertEqual("ERROR: not running\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Run with a cycle budget, and continue
+  def test_run(self):
+    r= self.cmd.exec("run 0200 10")
+    self.assertIn("INFO: all cycles used (ran 10 cycles)\r\n",r) 
+    self.assertIn(" A=00 X=00 Y=00 P=26 S=FD 0205 4C 05 02 JMP 0205\r\n",r) 
+    # read and dasm follow execution
+    r= self.cmd.exec("read - 3")
+    self.assertEqual("0205: 4C 05 02\r\n",r) 
+    r= self.cmd.exec("run - 6")
+    self.assertIn("INFO: all cycles used (ran 6 cycles)\r\n",r) 
+
+  # Run stops at a breakpoint, and resumes over it
+  def test_break(self):
+    self.cmd.exec("break 0205")
+    r= self.cmd.exec("run 0200")
+    self.assertIn("INFO: breakpoint (ran 10 cycles)\r\n",r) 
+    self.assertIn("0205 4C 05 02 JMP 0205\r\n",r) 
+    r= self.cmd.exec("run")
+    self.assertIn("INFO: breakpoint (ran 3 cycles)\r\n",r) 
+
+  # An endless run is stopped by a command
+  def test_stop(self):
+    r= self.cmd.exec("run 0205")
+    self.assertEqual("",r) 
+    r= self.cmd.exec("run 0200")
+    self.assertEqual("ERROR: already running (use 'run stop')\r\n",r) 
+    r= self.cmd.exec("run stop")
+    self.assertIn("INFO: stopped (ran ",r) 
+    self.assertIn("0205 4C 05 02 JMP 0205\r\n",r) 
+
+  # Pace to a clock, the run reports the achieved speed
+  def test_pace(self):
+    r= self.cmd.exec("run pace")
+    self.assertEqual("INFO: not paced (speed compared to 1000000 Hz)\r\n",r) 
+    r= self.cmd.exec("run pace 0")
+    self.assertEqual("ERROR: expected hex <hz> (not 0) or off, not '0'\r\n",r) 
+    r= self.cmd.exec("run pace F4240")
+    self.assertEqual("INFO: paced to 1000000 Hz\r\n",r) 
+    # A slow clock (4096 Hz), that any board (and a busy PC) keeps up with; so the run takes the paced time
+    r= self.cmd.exec("run pace 1000")
+    self.assertEqual("INFO: paced to 4096 Hz\r\n",r) 
+    self.cmd.exec("run 0200 333") # 0.2s at 4096 Hz
+    time.sleep(0.5)
+    r= self.cmd.exec("run pace off")
+    self.assertIn("INFO: all cycles used (ran 33",r) # the last instruction may end beyond the budget
+    self.assertIn(" cycles, at ",r) 
+    self.assertIn("% of 4096 Hz",r) 
+    self.assertIn("INFO: not paced (speed compared to 4096 Hz)\r\n",r) 
+    ratio= int(r.split(", at ")[1].split("%")[0])
+    self.assertTrue(50<=ratio<=101) # never (much) faster than the clock
+
+  # A device sees the same cycle count in a run (which fuses pairs) as when stepping
+  def test_fused_io(self):
+    # LDA #FF, STA 9004 (T1 latch), LDA #FF, STA 9005 (T1 starts), LDA 9004 (T1 low byte)
+    self.cmd.exec("write 0200 A9 FF 8D 04 90 A9 FF 8D 05 90 AD 04 90 4C 0D 02")
+    self.cmd.exec("write FFFC 00 02")
+    r= self.cmd.exec("run 0200 10")
+    self.assertIn("00000010 A=FB X=00 Y=00 P=A4 S=FD 020D 4C 0D 02 JMP 020D\r\n",r) 
+    self.cmd.exec("run reset")
+    r= self.cmd.exec("step 5")
+    self.assertEqual("00000010 A=FB X=00 Y=00 P=A4 S=FD 020D 4C 0D 02 JMP 020D\r\n",r) 
+
+  # Reset takes the pc from the reset vector
+  def test_reset(self):
+    self.cmd.exec("write FFFC 00 02")
+    r= self.cmd.exec("run reset")
+    self.assertEqual("00000000 A=00 X=00 Y=00 P=24 S=FD 0200 A2 03    LDX #03\r\n",r) 
+
+  # A replay takes the interrupts at the same instruction as the recording, also when the VIA raises it during one
+  def test_record(self):
+    # Start VIA T1 (20 cycles), wait till it timed out, then enable its interrupt (STA 900E raises IRQ)
+    self.cmd.exec("write 0200 A9 20 8D 04 90 A9 00 8D 05 90 A2 10 CA D0 FD 58 A9 C0 8D 0E 90 4C 15 02")
+    # The handler clears the interrupt, and puts the low byte of the return address in Y
+    self.cmd.exec("write 0220 AD 04 90 BA BC 02 01 40")
+    self.cmd.exec("write 03FE 20 02") # IRQ vector (FFFE, the memory of this sketch is mirrored)
+    r= self.cmd.exec("run replay")
+    self.assertEqual("ERROR: nothing recorded (use 'run record')\r\n",r) 
+    r= self.cmd.exec("run record")
+    self.assertEqual("INFO: recording (snapshot taken)\r\n",r) 
+    r= self.cmd.exec("run 0200 A0")
+    self.assertIn("000000A0 A=BC X=FA Y=15 P=A0 S=FD 0215 4C 15 02 JMP 0215\r\n",r) 
+    r= self.cmd.exec("run replay")
+    self.assertIn("INFO: replaying 6 bytes of log\r\n",r) 
+    r= self.cmd.exec("run 0200 A0")
+    self.assertEqual("INFO: all cycles used (ran A0 cycles)\r\n000000A0 A=BC X=FA Y=15 P=A0 S=FD 0215 4C 15 02 JMP 0215\r\n",r) 
+
+
+###########################################################################
+### Until
+###########################################################################
+
+class Test_until(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    self.cmd.exec(PROG_LOOP)
+    self.cmd.exec("run 0200 0")
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help until")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: until <addr>",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("use 'run stop' when <addr> is never reached",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("until")
+    self.assertEqual("ERROR: expected <addr>\r\n",r) 
+    r= self.cmd.exec("until xyz")
+    self.assertEqual("ERROR: expected hex <addr>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("until 0200 0300")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Run until an address
+  def test_until(self):
+    r= self.cmd.exec("until 0202")
+    self.assertIn("INFO: reached 0202 (ran 2 cycles)\r\n",r) 
+    self.assertIn(" A=00 X=03 Y=00 P=24 S=FD 0202 CA       DEX\r\n",r) 
+    r= self.cmd.exec("until 0205")
+    self.assertIn("INFO: reached 0205 (ran E cycles)\r\n",r) 
+
+
+###########################################################################
+### Step
+###########################################################################
+
+class Test_step(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    self.cmd.exec(PROG_LOOP)
+    self.cmd.exec("run 0200 0")
+    
+  def tearDown(self):
+    self.cmd.exec("break clr")
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help step")
+    # Check if all sections are there
+    self.assertIn("SYNTAX: step",r) 
+    self.assertIn("NOTES:",r) 
+    # Check notes
+    self.assertIn("stops early at a breakpoint",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("step xyz")
+    self.assertEqual("ERROR: expected hex <num>, not 'xyz'\r\n",r) 
+    r= self.cmd.exec("step 1 2")
+    self.assertEqual("ERROR: too many arguments\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Single and multiple steps
+  def test_step(self):
+    r= self.cmd.exec("step")
+    self.assertEqual("00000002 A=00 X=03 Y=00 P=24 S=FD 0202 CA       DEX\r\n",r) 
+    r= self.cmd.exec("step 2")
+    self.assertEqual("00000007 A=00 X=02 Y=00 P=24 S=FD 0202 CA       DEX\r\n",r) 
+    r= self.cmd.exec("dasm - 1")
+    self.assertEqual("0202 CA       DEX\r\n",r) 
+
+  # Steps stop at a breakpoint (but not at the first instruction)
+  def test_break(self):
+    self.cmd.exec("break 0202")
+    r= self.cmd.exec("step 10")
+    self.assertEqual("INFO: breakpoint\r\n00000002 A=00 X=03 Y=00 P=24 S=FD 0202 CA       DEX\r\n",r) 
+    r= self.cmd.exec("step 3")
+    self.assertEqual("INFO: breakpoint\r\n00000007 A=00 X=02 Y=00 P=24 S=FD 0202 CA       DEX\r\n",r) 
+
+
+###########################################################################
+### Regs
+###########################################################################
+
+class Test_regs(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help regs")
+    self.assertIn("SYNTAX: regs",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("regs 1")
+    self.assertEqual("ERROR: no arguments allowed\r\n",r) 
+
+  ## Test for main features ##############################################
+  
+  # Registers and the instruction at pc
+  def test_regs(self):
+    self.cmd.exec(PROG_LOOP)
+    self.cmd.exec("run 0200 0")
+    r= self.cmd.exec("regs")
+    self.assertEqual(" A=00 X=00 Y=00 P=24 S=FD 0200 A2 03    LDX #03\r\n",r[8:]) 
+
+  # The instruction at pc is not read from an I/O page (the console at 8000)
+  def test_regs_io(self):
+    self.cmd.exec("run 8000 0")
+    r= self.cmd.exec("regs")
+    self.assertEqual(" 8000 ??\r\n",r[-10:]) 
+    self.cmd.exec("write 7FFF AD") # LDA abs, its operand is on the I/O page
+    self.cmd.exec("run 7FFF 0")
+    r= self.cmd.exec("regs")
+    self.assertEqual(" 7FFF AD ??\r\n",r[-13:]) 
+
+
+##########################################################################
+### console
+##########################################################################
+
+class Test_console(unittest.TestCase):
+  def setUp(self):
+    self.cmd= cmd.Cmd()
+    self.cmd.logstart(filemode="a",msg=type(self).__name__+"."+self._testMethodName)
+    self.cmd.open(port)
+    
+  def tearDown(self):
+    self.cmd.close()
+    self.cmd= None
+
+  # Returns the number of bytes in the input queue of the console
+  def count(self):
+    r= self.cmd.exec("console")
+    self.assertIn("INFO: console input has ",r) 
+    return int(r.split()[-2],16)
+
+  # The long help gives details
+  def test_longhelp(self):
+    r= self.cmd.exec("help console")
+    self.assertIn("SYNTAX: console\r\n",r) 
+    self.assertIn("SYNTAX: console <byte>",r) 
+    self.assertIn("NOTES:",r) 
+
+  # Erroneous arguments
+  def test_errargs(self):
+    r= self.cmd.exec("console 100")
+    self.assertEqual("ERROR: expected hex <byte>, not '100'\r\n",r) 
+    r= self.cmd.exec("console 4X")
+    self.assertEqual("ERROR: expected hex <byte>, not '4X'\r\n",r) 
+
+  # A full input queue is reported
+  def test_full(self):
+    r= ""
+    for i in range(9) : r+= self.cmd.exec("console 0 0 0 0 0 0 0 0") # 72 bytes
+    self.assertIn("ERROR: console input full\r\n",r) 
+    
+  ## Test for main features ##############################################
+  
+  # The program reads the queued bytes from the data register 8000
+  def test_rx(self):
+    n= self.count()
+    self.cmd.exec("write 0200 AD 00 80 85 10 AD 00 80 85 11 4C 0A 02") # LDA 8000; STA 10; LDA 8000; STA 11; JMP 020A
+    for i in range(n) : self.cmd.exec("run 0200 3") # drain what an earlier test left
+    self.assertEqual(0,self.count())
+    self.cmd.exec("console 41 42") 
+    self.assertEqual(2,self.count())
+    self.cmd.exec("run 0200 20") 
+    r= self.cmd.exec("read 10 2") 
+    self.assertEqual("0010: 41 42\r\n",r) 
+    self.assertEqual(0,self.count())
+
+
 ###########################################################################
 # ### Xxx
 # ##########################################################################
@@ -0,0 +1,169 @@
+# cpurec_test.py - test of cpurec: records a program with a VIA, replays it without the VIA, and checks the log
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import unittest
+import host
+
+
+# Records the image at 0200 (IRQ handler at 0300) for `cycles` cycles with a VIA at 9000, then replays it. For the
+# replay the VIA is replaced by one on a scheduler that never runs, and reads from its page give EE: all I/O reads
+# and interrupts must come from the log. Prints per run the state (cycle count, registers, zero page 10-12), and
+# the number of I/O reads and the log (in hex) of the recording.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cpusched.h"
+#include "cputrace.h"
+#include "cpurec.h"
+#include "via.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k
+void cputrace_put(cputrace_t * trace, cpu_t * cpu, uint8_t opcode) { } // not traced
+static const uint8_t image[]= { %s };
+static const uint8_t isr[]= { %s };
+static uint8_t mem[0x10000];
+static via_t via;
+static bool replaying;
+static uint32_t ioreads;
+uint8_t mem_read(uint16_t addr) { if( (addr>>8)==0x90 ) { ioreads++; return replaying ? 0xEE : via_read(&via,addr); } return mem[addr]; }
+void    mem_write(uint16_t addr, uint8_t data) { if( (addr>>8)==0x90 ) { via_write(&via,addr,data); return; } snap_write(addr); mem[addr]=data; }
+static void print(const char * name, cpu_t * cpu, uint32_t start) {
+  printf("%%s %%08X A=%%02X X=%%02X Y=%%02X P=%%02X S=%%02X PC=%%04X", name, (unsigned)(cpu->cycles-start), cpu->a, cpu->x, cpu->y, cpu_status(cpu), cpu->sp, cpu->pc);
+  for( int i=0x10; i<0x13; i++ ) printf(" %%02X", mem[i]);
+  printf("\\n");
+}
+int main() {
+  static cpu_t cpu;
+  static cpusched_t sched, dead;
+  static cpurec_t rec;
+  static uint8_t log[0x1000];
+  memcpy(mem+0x0200,image,sizeof image);
+  memcpy(mem+0x0300,isr,sizeof isr);
+  mem[0xFFFC]= 0x00; mem[0xFFFD]= 0x02;
+  mem[0xFFFE]= 0x00; mem[0xFFFF]= 0x03;
+  cpu_reset(&cpu);
+  cpusched_init(&sched,cpu.cycles);
+  cpu.sched= &sched;
+  via_init(&via,&cpu,&sched,0x90);
+  uint32_t start= cpu.cycles;
+  if( cpurec_record(&rec,&cpu,log,sizeof log)!=SNAP_OK ) return 1;
+  while( cpu.cycles-start<%d ) cpu_step(&cpu);
+  print("record",&cpu,start);
+  cpurec_stop(&rec,&cpu);
+  printf("reads %%X mode %%X\\n", ioreads, rec.mode);
+  printf("log");
+  for( uint16_t i=0; i<rec.len; i++ ) printf(" %%02X", log[i]);
+  printf("\\n");
+  replaying= true;
+  cpusched_init(&dead,cpu.cycles);
+  via_init(&via,&cpu,&dead,0x90);
+  if( cpurec_replay(&rec,&cpu)!=SNAP_OK ) return 1;
+  while( cpu.cycles-start<%d ) cpu_step(&cpu);
+  print("replay",&cpu,start);
+  printf("mode %%X\\n", rec.mode);
+  return 0;
+}
+"""
+
+
+# The main program: T1 free-run interrupts, and a loop reading T2; counts the loops in 11 and the interrupts in 12
+IMAGE= [
+  0xA9,0x40,       # 0200 LDA #40
+  0x8D,0x0B,0x90,  # 0202 STA 900B (ACR: T1 free-run)
+  0xA9,0xC0,       # 0205 LDA #C0
+  0x8D,0x0E,0x90,  # 0207 STA 900E (IER: enable T1)
+  0xA9,0x00,       # 020A LDA #00
+  0x8D,0x04,0x90,  # 020C STA 9004 (T1 latch low)
+  0xA9,0x08,       # 020F LDA #08
+  0x8D,0x05,0x90,  # 0211 STA 9005 (T1 latch high, starts T1)
+  0x58,            # 0214 CLI
+  0xAD,0x08,0x90,  # 0215 LDA 9008 (T2 counter low)
+  0x85,0x10,       # 0218 STA 10
+  0xE6,0x11,       # 021A INC 11
+  0x4C,0x15,0x02,  # 021C JMP 0215
+]
+ISR= [
+  0x48,            # 0300 PHA
+  0xAD,0x04,0x90,  # 0301 LDA 9004 (clears the T1 interrupt)
+  0xE6,0x12,       # 0304 INC 12
+  0x68,            # 0306 PLA
+  0x40,            # 0307 RTI
+]
+
+
+# Records and replays the program for `cycles`; returns the output lines
+def run_rec(cycles) :
+  hexs= lambda bs: ", ".join(f"0x{b:02X}" for b in bs)
+  main= MAIN_CPP % (hexs(IMAGE),hexs(ISR),cycles,cycles)
+  return host.run(main,["cpu.cpp","isa.cpp","cpusched.cpp","via.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp"])
+
+
+# Parses the log (see cpurec.h) into a list of items: ("io",values) or ("ev",event,delta)
+def parse(log) :
+  items= []
+  pos= 0
+  while pos<len(log) :
+    if log[pos]<0x80 :
+      n= log[pos]+1
+      items.append( ("io",log[pos+1:pos+1+n]) )
+      pos+= 1+n
+    else :
+      ev= log[pos]&0x7F
+      delta= 0
+      shift= 0
+      pos+= 1
+      while True :
+        delta|= (log[pos]&0x7F)<<shift
+        shift+= 7
+        pos+= 1
+        if log[pos-1]<0x80 : break
+      items.append( ("ev",ev,delta) )
+  return items
+
+
+##########################################################################
+### cpurec
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_cpurec(unittest.TestCase):
+
+  # A replay without the VIA ends in the same state as the recording
+  def test_roundtrip(self):
+    lines= run_rec(0x3000)
+    self.assertEqual(lines[0].split()[0],"record")
+    self.assertEqual(lines[3].split()[0],"replay")
+    self.assertEqual(lines[0].split()[1:],lines[3].split()[1:])
+    self.assertEqual(lines[4],"mode 0") # replay ended at the end of the log (not out of sync)
+    self.assertRegex(lines[0]," [0-9A-F]{2} [0-9A-F]{2} [0-9A-F]{2}$")
+    self.assertNotEqual(lines[0][-2:],"00") # interrupts were taken
+
+  # The log has the I/O reads in runs of at most 128, and the IRQ changes with the cycle deltas
+  def test_log(self):
+    lines= run_rec(0x3000)
+    reads= int(lines[1].split()[1],16)
+    self.assertEqual(lines[1].split()[3],"0") # not full
+    log= [int(b,16) for b in lines[2].split()[1:]]
+    items= parse(log)
+    self.assertEqual(sum(len(i[1]) for i in items if i[0]=="io"),reads) # every I/O read is in the log
+    self.assertTrue(all(len(i[1])<=0x80 for i in items if i[0]=="io"))
+    self.assertTrue(any(len(i[1])==0x80 for i in items if i[0]=="io")) # a long run is split
+    self.assertEqual(items[0][0],"io") # no interrupt before T1 times out
+    events= [i for i in items if i[0]=="ev"]
+    self.assertEqual([e[1] for e in events],[1,0]*(len(events)//2)) # IRQ high, low, high, ...
+    self.assertGreater(len(events),6)
+    self.assertEqual(len(events)//2,int(lines[0].split()[-1],16)) # one interrupt per rise
+    self.assertLess(sum(e[2] for e in events),0x3000)
+    # Free-run T1 with latch 0800 has a period of 0802 cycles; the interrupts are taken at instruction boundaries
+    rises= []
+    cycle= 0
+    for e in events :
+      cycle+= e[2]
+      if e[1]==1 : rises.append(cycle)
+    self.assertTrue(all(0x802-7<=b-a<=0x802+7 for a,b in zip(rises,rises[1:])))
+
+
+if __name__ == '__main__':
+  unittest.main()
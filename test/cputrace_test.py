@@ -0,0 +1,119 @@
+# cputrace_test.py - test of cputrace: the entries of the ring, a full ring, and the file thread
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import os
+import tempfile
+import unittest
+import host
+
+
+# Runs a random image (seeded with argv[1], a few opcodes not in use end a run) with tracing, in three parts:
+#  - "entries": takes every entry right after its instruction, and compares it with the cpu state before it
+#  - "full": executes 20 instructions with a ring of 8 entries, and takes the entries only after that
+#  - "file": executes argv[3] instructions with a ring of 64 entries that a thread writes to file argv[2]
+# Prints a line per part.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cputrace.h"
+#include "isa.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k (snap.cpp is linked for cpurec.cpp, but not used)
+static uint8_t mem[0x10000];
+uint8_t mem_read(uint16_t addr) { return mem[addr]; }
+void    mem_write(uint16_t addr, uint8_t data) { mem[addr]= data; }
+static uint32_t seed;
+static uint8_t rnd(void) { seed= seed*1103515245 + 12345; return seed>>16; }
+static cpu_t cpu;
+// Steps the cpu; at an opcode not in use (not traced), it restarts the cpu at a random address and returns false
+static bool step(void) { if( cpu_step(&cpu)==0 ) { cpu.pc= rnd() | (rnd()<<8); return false; } return true; }
+int main(int argc, char * argv[]) {
+  seed= strtoul(argv[1],0,16);
+  for( long a=0; a<0x10000; a++ ) { uint8_t b; do b= rnd(); while( isa_opcode_iix(b)==0 && rnd()>8 ); mem[a]= b; }
+  cpu_reset(&cpu);
+  static cputrace_t tr;
+  static cputrace_entry_t ring[1024];
+  // entries
+  cputrace_init(&tr,ring,1024);
+  cpu.trace= &tr;
+  int diffs= 0;
+  uint32_t lazy= 0;
+  for( int i=0; i<0x1000; i++ ) {
+    cpu_t before= cpu;
+    uint8_t p= cpu_status(&before);
+    lazy+= cpu.lazy!=0;
+    cputrace_entry_t e;
+    if( !step() ) { if( cputrace_get(&tr,&e) ) diffs++; continue; }
+    if( !cputrace_get(&tr,&e) ) { diffs++; continue; }
+    uint8_t bytes= isa_opcode_bytes(e.opcode);
+    if( e.cycles!=before.cycles || e.pc!=before.pc || e.opcode!=mem[before.pc] || e.a!=before.a || e.x!=before.x || e.y!=before.y || e.sp!=before.sp ) diffs++;
+    if( (bytes>1 && e.op1!=mem[(uint16_t)(before.pc+1)]) || (bytes>2 && e.op2!=mem[(uint16_t)(before.pc+2)]) ) diffs++;
+    if( cputrace_status(&e)!=p ) diffs++;
+  }
+  printf("entries %%X lazy %%X differences %%d\\n", 0x1000, lazy, diffs);
+  // full
+  cputrace_init(&tr,ring,8);
+  uint16_t pcs[20];
+  for( int i=0; i<20; ) { uint16_t pc= cpu.pc; if( step() ) pcs[i++]= pc; }
+  int got= 0;
+  cputrace_entry_t e;
+  while( cputrace_get(&tr,&e) ) { if( e.pc!=pcs[got] ) diffs++; got++; }
+  printf("full got %%X lost %%X differences %%d\\n", got, tr.lost, diffs);
+  // file
+  #if CPUTRACE_THREADS
+  cputrace_init(&tr,ring,64);
+  uint32_t steps= strtoul(argv[3],0,16);
+  if( !cputrace_file_start(&tr,argv[2]) ) return 1;
+  for( uint32_t i=0; i<steps; ) if( step() ) i++;
+  cputrace_file_stop();
+  cpu.trace= 0;
+  FILE * f= fopen(argv[2],"rb");
+  uint32_t num= 0, prev= 0;
+  while( fread(&e,sizeof e,1,f)==1 ) { if( num>0 && (int32_t)(e.cycles-prev)<=0 ) diffs++; prev= e.cycles; num++; }
+  fclose(f);
+  printf("file %%X lost %%X differences %%d\\n", num, tr.lost, diffs);
+  #endif
+  return 0;
+}
+"""
+
+
+# Runs the three parts for the image from `seed`, with `steps` instructions traced to a file; returns the output lines
+def run_trace(seed,steps) :
+  with tempfile.TemporaryDirectory() as tmp :
+    main= MAIN_CPP % ()
+    sources= ["cpu.cpp","isa.cpp","cpusched.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp","cputrace.cpp"]
+    return host.run(main,sources,flags=["-pthread"],args=[f"{seed:X}",os.path.join(tmp,"trace.bin"),f"{steps:X}"])
+
+
+##########################################################################
+### cputrace
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_cputrace(unittest.TestCase):
+
+  # Every entry has the state before its instruction; the status register is computed from the lazy flags
+  def test_entries(self):
+    lines= run_trace(1,0x100)
+    self.assertRegex(lines[0],r"^entries 1000 lazy [0-9A-F]+ differences 0$")
+    self.assertGreater(int(lines[0].split()[3],16),0x800) # most entries had lazy flags
+
+  # A full ring keeps the oldest entries (one slot stays free), and counts the dropped ones
+  def test_full(self):
+    lines= run_trace(2,0x100)
+    self.assertEqual(lines[1],"full got 7 lost D differences 0")
+
+  # The file thread writes the entries in order; every instruction is either in the file or counted as lost
+  def test_file(self):
+    lines= run_trace(3,0x40000)
+    self.assertRegex(lines[2],r"^file [0-9A-F]+ lost [0-9A-F]+ differences 0$")
+    num,lost= int(lines[2].split()[1],16),int(lines[2].split()[3],16)
+    self.assertEqual(num+lost,0x40000)
+    self.assertGreater(num,0)
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -0,0 +1,142 @@
+# fuse_test.py - differential test of the pair fusion: runs a program with cpu_run() and with cpu_step()
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+import host
+
+
+ISA6502= os.path.join(os.path.dirname(os.path.abspath(__file__)),"..","isa6502.py")
+
+# A profile (output of 'prof pairs') with a pair of each class, so that isa6502.py puts them all in the fusion table
+PAIRS= """
+A9 85 00000100
+18 65 00000100
+E8 E0 00000100
+CD F0 00000100
+EC D0 00000100
+CA D0 00000100
+total 00000600
+"""
+
+
+# Runs the image at 0200 for `cycles` cycles, with cpu_run() (which fuses pairs) or, when argv[1] is "step", with
+# cpu_step(). Page C0 is an I/O device: a read of it raises the IRQ line (and returns 00), a write lowers it.
+# Prints the cycle count, the registers, memory 0400-0407 and a hash (FNV-1a) of all memory.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cputrace.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k (snap.cpp is linked for cpurec.cpp, but not used)
+void cputrace_put(cputrace_t * trace, cpu_t * cpu, uint8_t opcode) { } // not traced
+static const uint8_t image[]= { %s };
+static const uint8_t isr[]= { %s };
+static uint8_t mem[0x10000];
+static cpu_t cpu;
+uint8_t mem_read(uint16_t addr) { if( (addr>>8)==0xC0 ) { cpu_irq(&cpu,true); return 0; } return mem[addr]; }
+void    mem_write(uint16_t addr, uint8_t data) { if( (addr>>8)==0xC0 ) { cpu_irq(&cpu,false); return; } mem[addr]=data; }
+int main(int argc, char * argv[]) {
+  memcpy(mem+0x0200,image,sizeof image);
+  memcpy(mem+0x0300,isr,sizeof isr);
+  mem[0xFFFC]= 0x00; mem[0xFFFD]= 0x02;
+  mem[0xFFFE]= 0x00; mem[0xFFFF]= 0x03;
+  cpu_page_set(0xC0,CPU_PAGE_IO);
+  cpu_reset(&cpu);
+  if( argc>1 && strcmp(argv[1],"step")==0 ) {
+    while( (int32_t)(cpu.cycles-%d)<0 ) cpu_step(&cpu);
+  } else {
+    cpu_run(&cpu,%d);
+  }
+  printf("%%08X A=%%02X X=%%02X Y=%%02X P=%%02X S=%%02X PC=%%04X", (unsigned)cpu.cycles, cpu.a, cpu.x, cpu.y, cpu_status(&cpu), cpu.sp, cpu.pc);
+  for( int i=0x400; i<0x408; i++ ) printf(" %%02X", mem[i]);
+  uint32_t hash= 0x811C9DC5;
+  for( int i=0; i<0x10000; i++ ) hash= (hash^mem[i])*0x01000193;
+  printf(" mem=%%08X\\n", (unsigned)hash);
+  return 0;
+}
+"""
+
+
+# The interrupt service routine at 0300 logs the low byte of the interrupted pc at 0400 (index at 10), and lowers the IRQ
+ISR= [
+  0x48,            # 0300 PHA
+  0x8A,            # 0301 TXA
+  0x48,            # 0302 PHA
+  0x8D,0x00,0xC0,  # 0303 STA C000 (lowers IRQ)
+  0xBA,            # 0306 TSX
+  0xBD,0x04,0x01,  # 0307 LDA 0104,X (the pushed pc, low byte)
+  0xA4,0x10,       # 030A LDY 10
+  0x99,0x00,0x04,  # 030C STA 0400,Y
+  0xE6,0x10,       # 030F INC 10
+  0x68,            # 0311 PLA
+  0xAA,            # 0312 TAX
+  0x68,            # 0313 PLA
+  0x40,            # 0314 RTI
+]
+
+
+# Builds the program with `code` at 0200 (and isa.cpp with the fusion table of PAIRS), and runs it for `cycles` with
+# cpu_run() and with cpu_step(); returns the two result lines
+def run_both(code,cycles) :
+  with tempfile.TemporaryDirectory() as tmp :
+    with open(os.path.join(tmp,"pairs.txt"),"w") as f : f.write(PAIRS)
+    isa= subprocess.run([sys.executable,ISA6502,"cpp",os.path.join(tmp,"pairs.txt")],stdout=subprocess.PIPE,check=True,text=True).stdout
+  main= MAIN_CPP % (", ".join(f"0x{b:02X}" for b in code),", ".join(f"0x{b:02X}" for b in ISR),cycles,cycles)
+  sources= ["cpu.cpp","cpusched.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp"]
+  return host.run(main,sources,{"isa.cpp":isa})[0],host.run(main,sources,{"isa.cpp":isa},args=["step"])[0]
+
+
+##########################################################################
+### fuse
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_fuse(unittest.TestCase):
+
+  # Every class of pair ends in the same state as the two instructions stepped
+  def test_pairs(self):
+    code= [
+      0xA2,0x10,       # 0200 LDX #10
+      0xA9,0x05,       # 0202 LDA #05    (LDST)
+      0x85,0x11,       # 0204 STA 11
+      0x18,            # 0206 CLC        (CARRY)
+      0x65,0x12,       # 0207 ADC 12
+      0x85,0x12,       # 0209 STA 12
+      0xE8,            # 020B INX        (INCCMP)
+      0xE0,0x20,       # 020C CPX #20
+      0xD0,0x03,       # 020E BNE 0213
+      0x4C,0x00,0x02,  # 0210 JMP 0200
+      0xCD,0x12,0x00,  # 0213 CMP 0012   (CMPBRA)
+      0xF0,0x02,       # 0216 BEQ 021A
+      0xE6,0x13,       # 0218 INC 13
+      0xCA,            # 021A DEX        (INCBRA)
+      0xD0,0xEA,       # 021B BNE 0207
+      0x4C,0x00,0x02,  # 021D JMP 0200
+    ]
+    run,step= run_both(code,0x4000)
+    self.assertEqual(run,step)
+
+  # A compare that reads an I/O page (here raising the IRQ) is not fused with its branch: the IRQ is taken before the branch
+  def test_io(self):
+    code= [
+      0x58,            # 0200 CLI
+      0xA2,0x00,       # 0201 LDX #00
+      0xE8,            # 0203 INX
+      0xEA,            # 0204 NOP
+      0xEC,0x00,0xC0,  # 0205 CPX C000 (raises IRQ)
+      0xD0,0xF9,       # 0208 BNE 0203
+      0x4C,0x03,0x02,  # 020A JMP 0203
+    ]
+    run,step= run_both(code,0x200)
+    self.assertIn(" 08 08 08 08 08 08 08 08 mem=",step) # interrupted at the BNE
+    self.assertEqual(run,step)
+
+
+if __name__ == '__main__':
+  unittest.main()
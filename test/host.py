@@ -0,0 +1,47 @@
+# host.py - builds and runs C++ test programs on the PC (no Arduino board), for the host tests (e.g. recomp_test.py)
+# Needs g++; the sources in src are compiled with a minimal Arduino.h
+
+import os
+import shutil
+import subprocess
+import tempfile
+
+
+SRC= os.path.join(os.path.dirname(os.path.abspath(__file__)),"..","src")
+
+# True when the host tests can run
+available= shutil.which("g++") is not None
+
+
+# Just enough of the Arduino core for the cpu and its modules
+ARDUINO_H= """
+#include <stdint.h>
+#include <stdlib.h>
+#include <avr/pgmspace.h>
+"""
+PGMSPACE_H= """
+#include <string.h>
+#include <strings.h>
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(p))
+#define strcasecmp_P strcasecmp
+#define strncasecmp_P strncasecmp
+"""
+
+
+# Builds `main` (text of main.cpp) with `sources` (file names in src) and `files` (name to text, the .cpp ones are
+# compiled too), with the extra g++ `flags`; runs it with `args` and returns its output lines
+def run(main,sources,files={},flags=[],args=[]) :
+  with tempfile.TemporaryDirectory() as tmp :
+    with open(os.path.join(tmp,"Arduino.h"),"w") as f : f.write(ARDUINO_H)
+    os.mkdir(os.path.join(tmp,"avr"))
+    with open(os.path.join(tmp,"avr","pgmspace.h"),"w") as f : f.write(PGMSPACE_H)
+    files= dict(files,**{"main.cpp":main})
+    for name,text in files.items() :
+      with open(os.path.join(tmp,name),"w") as f : f.write(text)
+    cpps= [os.path.join(tmp,name) for name in files if name.endswith(".cpp")]
+    exe= os.path.join(tmp,"prog")
+    subprocess.run(["g++","-O1","-I"+tmp,"-I"+SRC]+flags+["-o",exe]+cpps+[os.path.join(SRC,s) for s in sources],check=True)
+    res= subprocess.run([exe]+args,stdout=subprocess.PIPE,check=True,text=True)
+    return res.stdout.splitlines()
@@ -0,0 +1,99 @@
+# jobs_test.py - test of cpujobs: runs random jobs on worker threads, and one by one with cpu_step()
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import unittest
+import host
+
+
+# Makes N jobs from random images (seeded with argv[1]) with a budget of argv[3] cycles, and runs them with
+# cpujobs_run() on argv[2] threads. Then runs every job with cpu_step(), and compares registers, cycles and memory.
+# An image is random opcodes (a few not in use, so that some jobs halt). Prints the differences and a summary line.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cputrace.h"
+#include "cpujobs.h"
+#include "isa.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k (snap.cpp is linked for cpurec.cpp, but not used)
+void cputrace_put(cputrace_t * trace, cpu_t * cpu, uint8_t opcode) { } // not traced
+#define N    40     // jobs
+#define SIZE 0xFFFF // bytes per image (loaded at 0000)
+static uint8_t * cur; // memory of the job cpu_step() runs
+uint8_t mem_read(uint16_t addr) { return cur[addr]; }
+void    mem_write(uint16_t addr, uint8_t data) { cur[addr]= data; }
+static uint32_t seed;
+static uint8_t rnd(void) { seed= seed*1103515245 + 12345; return seed>>16; }
+int main(int argc, char * argv[]) {
+  seed= strtoul(argv[1],0,16);
+  uint8_t threads= strtoul(argv[2],0,16);
+  uint32_t budget= strtoul(argv[3],0,16);
+  static cpujobs_job_t jobs[N];
+  for( int j=0; j<N; j++ ) {
+    uint8_t * image= (uint8_t *)malloc(SIZE);
+    for( long a=0; a<SIZE; a++ ) { uint8_t b; do b= rnd(); while( isa_opcode_iix(b)==0 && rnd()!=0 ); image[a]= b; }
+    jobs[j].image= image;
+    jobs[j].addr= 0x0000;
+    jobs[j].size= SIZE;
+    jobs[j].entry= rnd() | (rnd()<<8);
+    jobs[j].budget= budget/2 + rnd()*(budget/0x200); // jobs of different length, so that workers steal
+    jobs[j].mem= (uint8_t *)malloc(0x10000L);
+  }
+  if( !cpujobs_run(jobs,N,threads) ) { printf("no memory\\n"); return 1; }
+  int diffs= 0;
+  uint32_t steps= 0, halts= 0;
+  cur= (uint8_t *)malloc(0x10000L);
+  for( int j=0; j<N; j++ ) {
+    static cpu_t cpu;
+    memset(cur,0,0x10000L);
+    memcpy(cur,jobs[j].image,SIZE);
+    cpu_reset(&cpu);
+    cpu.pc= jobs[j].entry; cpu.a= 0; cpu.x= 0; cpu.y= 0; cpu.sp= 0xFD;
+    cpu_status_set(&cpu,ISA_FLAG_I);
+    cpu.cycles= 0;
+    uint32_t n= 0;
+    uint8_t halted= 0;
+    while( cpu.cycles<jobs[j].budget ) { if( cpu_step(&cpu)==0 ) { halted= 1; break; } n++; }
+    uint8_t p= (cpu_status(&cpu) & ~ISA_FLAG_B) | 0x20;
+    cpubatch_state_t * s= &jobs[j].result;
+    if( s->pc!=cpu.pc || s->a!=cpu.a || s->x!=cpu.x || s->y!=cpu.y || s->sp!=cpu.sp || s->p!=p || s->cycles!=cpu.cycles || s->steps!=n || s->halted!=halted ) {
+      printf("%2d: jobs PC=%04X A=%02X X=%02X Y=%02X S=%02X P=%02X %08X/%X%s", j, s->pc, s->a, s->x, s->y, s->sp, s->p, s->cycles, s->steps, s->halted?" halted":"");
+      printf(" step PC=%04X A=%02X X=%02X Y=%02X S=%02X P=%02X %08X/%X%s\\n", cpu.pc, cpu.a, cpu.x, cpu.y, cpu.sp, p, cpu.cycles, n, halted?" halted":"");
+      diffs++;
+    }
+    if( memcmp(jobs[j].mem,cur,0x10000L)!=0 ) { printf("%2d: memory differs\\n", j); diffs++; }
+    steps+= n;
+    halts+= halted;
+  }
+  printf("jobs %d steps %X halted %X differences %d\\n", N, steps, halts, diffs);
+  return 0;
+}
+"""
+
+
+# Runs the jobs made from `seed` with `budget` on `threads` threads; returns the output lines
+def run_jobs(seed,threads,budget) :
+  sources= ["cpu.cpp","isa.cpp","cpusched.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp","cpubatch.cpp","cpujobs.cpp"]
+  return host.run(MAIN_CPP,sources,flags=["-pthread"],args=[f"{seed:X}",f"{threads:X}",f"{budget:X}"])
+
+
+##########################################################################
+### jobs
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_jobs(unittest.TestCase):
+
+  # Jobs run on worker threads give the same registers, cycles and memory as with cpu_step()
+  def test_threads(self):
+    for seed,threads in ((1,1),(2,4),(3,7),(4,0)) : # 0 is one thread per core
+      lines= run_jobs(seed,threads,0x4000)
+      self.assertEqual(lines[:-1],[])
+      self.assertRegex(lines[-1],r"^jobs 40 steps [0-9A-F]+ halted [0-9A-F]+ differences 0$")
+      self.assertGreater(int(lines[-1].split()[3],16),40*0x100) # the jobs ran a while
+
+
+if __name__ == '__main__':
+  unittest.main()
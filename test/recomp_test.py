@@ -0,0 +1,186 @@
+# recomp_test.py - differential test of recomp6502.py: runs a program interpreted and recompiled, with a VIA
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+import host
+
+
+RECOMP= os.path.join(os.path.dirname(os.path.abspath(__file__)),"..","recomp6502.py")
+
+
+# Runs the image at 0200 for `cycles` cycles, first interpreted, then recompiled; the VIA is at 9000.
+# Prints per run the cycle count, the registers, zero page 10-17 and a hash (FNV-1a) of all memory.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cpusched.h"
+#include "cputrace.h"
+#include "via.h"
+#include "cpurecomp.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k (snap.cpp is linked for cpurec.cpp, but not used)
+extern const cpurecomp_block_t recomp_blocks[];
+extern const uint16_t recomp_blocks_num;
+void cputrace_put(cputrace_t * trace, cpu_t * cpu, uint8_t opcode) { } // not traced
+static const uint8_t image[]= { %s };
+static uint8_t mem[0x10000];
+static via_t via;
+uint8_t mem_read(uint16_t addr) { if( (addr>>8)==0x90 ) return via_read(&via,addr); return mem[addr]; }
+void    mem_write(uint16_t addr, uint8_t data) { if( (addr>>8)==0x90 ) { via_write(&via,addr,data); return; } mem[addr]=data; }
+int main() {
+  for( int recomp=0; recomp<2; recomp++ ) {
+    static cpu_t cpu;
+    static cpusched_t sched;
+    memset(mem,0,sizeof mem);
+    memcpy(mem+0x0200,image,sizeof image);
+    mem[0xFFFC]= 0x00; mem[0xFFFD]= 0x02;
+    cpu_reset(&cpu);
+    cpusched_init(&sched,cpu.cycles);
+    cpu.sched= &sched;
+    via_init(&via,&cpu,&sched,0x90);
+    if( recomp ) {
+      if( !cpurecomp_init(recomp_blocks,recomp_blocks_num) ) return 1;
+      cpurecomp_run(&cpu,%d);
+    } else {
+      while( (int32_t)(cpu.cycles-%d)<0 ) cpu_step(&cpu);
+    }
+    printf("%%08X A=%%02X X=%%02X Y=%%02X P=%%02X S=%%02X PC=%%04X", (unsigned)cpu.cycles, cpu.a, cpu.x, cpu.y, cpu_status(&cpu), cpu.sp, cpu.pc);
+    for( int i=0x10; i<0x18; i++ ) printf(" %%02X", mem[i]);
+    uint32_t hash= 0x811C9DC5;
+    for( int i=0; i<0x10000; i++ ) hash= (hash^mem[i])*0x01000193;
+    printf(" mem=%%08X\\n", (unsigned)hash);
+  }
+  return 0;
+}
+"""
+
+
+# Recompiles `code` (bytes at 0200), builds it with the sources and runs it for `cycles`; returns the two result lines
+def run_both(code,cycles) :
+  with tempfile.TemporaryDirectory() as tmp :
+    with open(os.path.join(tmp,"prog.bin"),"wb") as f : f.write(bytes(code))
+    recomp= subprocess.run([sys.executable,RECOMP,os.path.join(tmp,"prog.bin"),"--addr","0200","--entry","0200"],stdout=subprocess.PIPE,check=True,text=True).stdout
+  main= MAIN_CPP % (", ".join(f"0x{b:02X}" for b in code),cycles,cycles)
+  return host.run(main,["cpu.cpp","isa.cpp","cpusched.cpp","via.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp"],{"recomp.cpp":recomp})
+
+
+##########################################################################
+### recomp
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_recomp(unittest.TestCase):
+
+  # The VIA sees the same cycle counts from the recompiled blocks as from the interpreter
+  def test_via(self):
+    # A store to I/O ends a block, the interpreter then executes the JMP, which continues in the next block
+    code= [
+      0xA9,0x00,       # 0200 LDA #00
+      0x8D,0x04,0x90,  # 0202 STA 9004 (T1 latch low)
+      0x4C,0x08,0x02,  # 0205 JMP 0208
+      0xEA,            # 0208 NOP
+      0xEA,            # 0209 NOP
+      0xA9,0x01,       # 020A LDA #01
+      0x8D,0x05,0x90,  # 020C STA 9005 (T1 latch high, starts T1)
+      0x4C,0x12,0x02,  # 020F JMP 0212
+      0xEA,            # 0212 NOP
+      0xAE,0x04,0x90,  # 0213 LDX 9004 (T1 counter low)
+      0xAC,0x05,0x90,  # 0216 LDY 9005 (T1 counter high)
+      0x86,0x10,       # 0219 STX 10
+      0x84,0x11,       # 021B STY 11
+      0xA2,0x02,       # 021D LDX #02
+      0xBD,0x02,0x90,  # 021F LDA 9002,X (T1 counter low)
+      0x85,0x12,       # 0222 STA 12
+      0x4C,0x24,0x02,  # 0224 JMP 0224
+    ]
+    interp,recomp= run_both(code,0x60)
+    self.assertIn("PC=0224 F7 00 E7 ",interp) # T1 (latch 0100) read by the LDX and the LDA
+    self.assertEqual(interp,recomp)
+
+  # The recompiled blocks leave the same registers (all flags, also after decimal mode) and memory as the interpreter
+  def test_state(self):
+    code= [
+      0xA0,0x00,       # 0200 LDY #00
+      0xA9,0x00,       # 0202 LDA #00
+      0x85,0x10,       # 0204 STA 10
+      0xA9,0x04,       # 0206 LDA #04
+      0x85,0x11,       # 0208 STA 11 (pointer 10 is 0400)
+      0x98,            # 020A TYA
+      0x20,0x30,0x02,  # 020B JSR 0230
+      0x91,0x10,       # 020E STA (10),Y
+      0x08,            # 0210 PHP
+      0x68,            # 0211 PLA
+      0x99,0x00,0x05,  # 0212 STA 0500,Y
+      0xC8,            # 0215 INY
+      0xD0,0xF2,       # 0216 BNE 020A
+      0xE6,0x11,       # 0218 INC 11
+      0xA5,0x11,       # 021A LDA 11
+      0xC9,0x08,       # 021C CMP #08
+      0xD0,0xEA,       # 021E BNE 020A
+      0xA9,0x04,       # 0220 LDA #04
+      0x85,0x11,       # 0222 STA 11
+      0xE6,0x13,       # 0224 INC 13
+      0x4C,0x0A,0x02,  # 0226 JMP 020A
+      0xEA,0xEA,0xEA,0xEA,0xEA,0xEA, # 0229 NOP (not executed)
+      0x00,            # 022F BRK (not executed)
+      0xF8,            # 0230 SED
+      0x69,0x27,       # 0231 ADC #27
+      0xD8,            # 0233 CLD
+      0x2A,            # 0234 ROL A
+      0x45,0x12,       # 0235 EOR 12
+      0x85,0x12,       # 0237 STA 12
+      0xE9,0x13,       # 0239 SBC #13
+      0x60,            # 023B RTS
+    ]
+    interp,recomp= run_both(code,0x40000)
+    self.assertIn("PC=0210 00 07 C4 04 00 00 00 00 mem=E4EB7146",interp) # pointer 10, checksum 12 and passes 13
+    self.assertEqual(interp,recomp)
+
+  # A store into recompiled code (by a block, and by the interpreter) drops the block, also after the page got a bit map
+  def test_smc(self):
+    code= [
+      0xA2,0x00,       # 0200 LDX #00
+      0x20,0x40,0x02,  # 0202 JSR 0240
+      0xE8,            # 0205 INX
+      0xE0,0x10,       # 0206 CPX #10
+      0xD0,0xF8,       # 0208 BNE 0202 (the STX 0250 of 0240 gives its page a bit map)
+      0xA9,0x22,       # 020A LDA #22
+      0x8D,0x41,0x02,  # 020C STA 0241 (a block stores into the code of 0240)
+      0x20,0x40,0x02,  # 020F JSR 0240
+      0xA5,0x14,       # 0212 LDA 14
+      0x85,0x16,       # 0214 STA 16
+      0xA9,0x80,       # 0216 LDA #80
+      0x85,0x20,       # 0218 STA 20
+      0xA9,0x02,       # 021A LDA #02
+      0x85,0x21,       # 021C STA 21
+      0x6C,0x20,0x00,  # 021E JMP (0020) (to 0280, which is not recompiled)
+    ] + [0xEA]*0x1F + [ # 0221 NOP (padding)
+      0xA9,0x11,       # 0240 LDA #11
+      0x85,0x14,       # 0242 STA 14
+      0x8E,0x50,0x02,  # 0244 STX 0250 (a variable in the page with code)
+      0x4C,0x60,0x02,  # 0247 JMP 0260
+    ] + [0xEA]*0x16 + [ # 024A NOP (padding)
+      0xA9,0x44,       # 0260 LDA #44
+      0x85,0x15,       # 0262 STA 15
+      0x60,            # 0264 RTS
+    ] + [0xEA]*0x1B + [ # 0265 NOP (padding)
+      0xA9,0x33,       # 0280 LDA #33
+      0x8D,0x61,0x02,  # 0282 STA 0261 (the interpreter stores into the code of 0260)
+      0x20,0x40,0x02,  # 0285 JSR 0240
+      0xA5,0x15,       # 0288 LDA 15
+      0x85,0x17,       # 028A STA 17
+      0x4C,0x8C,0x02,  # 028C JMP 028C
+    ]
+    interp,recomp= run_both(code,0x400)
+    self.assertIn("PC=028C 00 00 00 00 22 33 22 33 ",interp) # 16 and 17 have the values of the modified code
+    self.assertEqual(interp,recomp)
+
+
+if __name__ == '__main__':
+  unittest.main()
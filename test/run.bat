@@ -4,8 +4,15 @@ IF "(env) " neq "%PROMPT:~0,6%" ECHO Please run setup.bat first && EXIT /b
 REM python -m unittest cmd_test
 
 
-python  cmd_test.py  Test_cmd  Test_help  Test_echo  Test_man  Test_read  Test_write  Test_dasm  Test_asm
-rem python  cmd_test.py  Test_prog
+python  cmd_test.py  Test_cmd  Test_help  Test_echo  Test_man  Test_read  Test_write  Test_dasm  Test_asm  Test_load  Test_save  Test_import  Test_prog  Test_snapshot  Test_restore  Test_break  Test_watch  Test_prof  Test_run  Test_until  Test_step  Test_regs  Test_console
+python  recomp_test.py
+python  batch_test.py
+python  jobs_test.py
+python  cpurec_test.py
+python  cputrace_test.py
+python  sched_test.py
+python  via_test.py
+python  fuse_test.py
 
 
 
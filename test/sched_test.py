@@ -0,0 +1,136 @@
+# sched_test.py - test of cpusched: random posts and cancels while the cycle counter runs (and wraps)
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import unittest
+import host
+
+
+# Drives the scheduler like cpu_step does (cpusched_run when the cycle counter passed `next`), starting at
+# cycle argv[2] (hex). Mode argv[1] "random": for a number of steps, posts (also periodic events that post
+# themselves again) and cancels random events, with delays up to 30000000, and advances the counter by
+# random amounts. Mode "idle": the counter runs 3FFFFF00 cycles without events (so `now` lags behind),
+# then an event is posted past the wheel, and the counter advances in jumps of 100000 until it fired.
+# Checks that an event fires exactly at the first run at or after its cycle, never when cancelled, and
+# that cpusched_posted() agrees. Prints the number of events fired, and the number of errors; for "idle"
+# also the number of function calls in the run right after the post.
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpu.h"
+#include "cpusched.h"
+#define N 64
+#define BEFORE(t1,t2) ((int32_t)((t1)-(t2))<0)
+typedef struct tev_s {
+  cpusched_event_t ev;
+  bool     posted; // Reference: the event is posted ..
+  uint32_t when;   // .. for this cycle
+  uint32_t period; // Posts itself again after this many cycles (0: not)
+} tev_t;
+static tev_t evs[N];
+static cpu_t cpu;
+static cpusched_t sched;
+static uint32_t fired, errors;
+// The idle mode is built with -finstrument-functions, to count the function calls of the scheduler
+static bool counting;
+static uint32_t calls;
+extern "C" void __cyg_profile_func_enter(void * fn, void * site) __attribute__((no_instrument_function));
+extern "C" void __cyg_profile_func_exit (void * fn, void * site) __attribute__((no_instrument_function));
+extern "C" void __cyg_profile_func_enter(void * fn, void * site) { if( counting ) calls++; }
+extern "C" void __cyg_profile_func_exit (void * fn, void * site) { }
+static uint32_t seed;
+static uint32_t rnd(void) { seed= seed*1103515245 + 12345; return seed>>8; }
+static void post(tev_t * t, uint32_t when) { cpusched_post(&sched,&t->ev,when); t->posted= true; t->when= when; }
+static void fire(cpu_t * c, cpusched_event_t * ev) {
+  tev_t * t= (tev_t *)ev->arg;
+  if( !t->posted || ev->when!=t->when || BEFORE(c->cycles,ev->when) ) { printf("wrong fire %%08X at %%08X\\n", ev->when, c->cycles); errors++; }
+  t->posted= false;
+  fired++;
+  if( t->period ) post(t,ev->when+t->period);
+}
+// The cpu_step check, then the invariant: no posted event lies at or before the cycle counter
+static void step(uint32_t cycles) {
+  cpu.cycles+= cycles;
+  if( !BEFORE(cpu.cycles,sched.next) ) cpusched_run(&sched,&cpu);
+  for( int i=0; i<N; i++ ) {
+    if( evs[i].posted!=cpusched_posted(&evs[i].ev) ) { printf("posted %%d differs\\n", i); errors++; }
+    if( evs[i].posted && !BEFORE(cpu.cycles,evs[i].when) ) { printf("missed %%08X at %%08X\\n", evs[i].when, cpu.cycles); errors++; evs[i].posted= false; }
+  }
+}
+static uint32_t delay(void) {
+  switch( rnd()%%5 ) {
+    case 0 : return rnd()%%4;          // due (almost) at once
+    case 1 : return rnd()%%0x100;      // level 0
+    case 2 : return rnd()%%0x10000;    // level 1
+    case 3 : return rnd()%%0x1000000;  // level 2
+    default: return rnd()%%0x30000000; // overflow
+  }
+}
+int main(int argc, char * argv[]) {
+  seed= 1;
+  cpu.cycles= strtoul(argv[2],0,16);
+  cpusched_init(&sched,cpu.cycles);
+  for( int i=0; i<N; i++ ) { evs[i].ev.func= fire; evs[i].ev.arg= &evs[i]; }
+  if( strcmp(argv[1],"random")==0 ) {
+    for( int i=0; i<N/8; i++ ) evs[i].period= 0x400+rnd()%%0x2000;
+    for( uint32_t s=0; s<300000; s++ ) {
+      if( rnd()%%8==0 ) {
+        tev_t * t= &evs[rnd()%%N];
+        if( t->posted && rnd()%%3==0 ) { cpusched_cancel(&sched,&t->ev); t->posted= false; }
+        else post(t,cpu.cycles+delay());
+      }
+      uint32_t r= rnd()%%1000;
+      step( r<900 ? 1+rnd()%%7 : r<999 ? rnd()%%0x10000 : rnd()%%0x1000000 );
+    }
+  } else {
+    for( uint32_t s=0; s<0x3FFF; s++ ) step(0x10000);
+    step(0xFF00);
+    post(&evs[0],cpu.cycles+0x20000000);
+    counting= true;
+    step(0x100); // `now` catches up with the cycle counter here: a jump, not a pass per rotation of the wheel
+    counting= false;
+    while( evs[0].posted && fired==0 ) step(0x100000);
+    if( fired!=1 || BEFORE(evs[0].ev.when+0x100000,cpu.cycles) ) errors++;
+    printf("calls %%X\\n", calls);
+  }
+  printf("fired %%X errors %%X\\n", fired, errors);
+  return 0;
+}
+"""
+
+
+# Runs `mode` from cycle `start`, with the wheel of the PC, or with the (smaller) wheel of AVR; returns the output lines
+def run_sched(mode,start,avr=False) :
+  flags= ["-D__AVR__"] if avr else []
+  if mode=="idle" : flags+= ["-fno-inline","-finstrument-functions"]
+  return host.run(MAIN_CPP % (),["cpusched.cpp"],flags=flags,args=[mode,f"{start:X}"])
+
+
+##########################################################################
+### sched
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_sched(unittest.TestCase):
+
+  # Events fire at their cycle, also across the wrap of the cycle counter
+  def test_random(self):
+    for avr in (False,True) :
+      for start in (0x00000000,0xFFFF0000,0x7FFFFF00) :
+        lines= run_sched("random",start,avr)
+        self.assertRegex(lines[-1],r"^fired [0-9A-F]+ errors 0$")
+        self.assertGreater(int(lines[-1].split()[1],16),0x1000)
+
+  # An event posted past the wheel, while `now` lags far behind the cycle counter, fires at its cycle;
+  # `now` catches up in a few passes (not one per rotation of the wheel: 40 on a PC, 40000 on AVR)
+  def test_idle(self):
+    for avr in (False,True) :
+      for start in (0x00000000,0xF0000000) :
+        lines= run_sched("idle",start,avr)
+        self.assertEqual(lines[1],"fired 1 errors 0")
+        self.assertLess(int(lines[0].split()[1],16),0x100)
+
+
+if __name__ == '__main__':
+  unittest.main()
@@ -0,0 +1,104 @@
+# via_test.py - test of the VIA model: timer T1 counter values, interrupt flag and IRQ, cycle by cycle
+# https://docs.python.org/3/library/unittest.html
+# Needs g++ on the PC (no Arduino board), see host.py
+
+import unittest
+import host
+
+
+# Starts T1 with latch argv[2] (hex) at cycle s, one-shot, or free-run when argv[1] is "free" or "irq", with the
+# T1 interrupt enabled. Then, for cycles s to s+argv[3], runs the scheduler (as cpu_step does) and prints the
+# cycle (relative to s), IFR and the IRQ line, and (not for "irq") the T1 counter, read as T1CH then T1CL (so
+# the flag is cleared every cycle). For "irq" the counter is not read, except T1CL once, at cycle argv[4].
+MAIN_CPP= """
+#include <Arduino.h>
+#include <stdio.h>
+#include "cpu.h"
+#include "cpusched.h"
+#include "cputrace.h"
+#include "via.h"
+#include "snap.h"
+const uint16_t mem_size= 0; // 64k (snap.cpp is linked for cpurec.cpp, but not used)
+uint8_t mem_read(uint16_t addr) { return 0; }
+void    mem_write(uint16_t addr, uint8_t data) { }
+void cputrace_put(cputrace_t * trace, cpu_t * cpu, uint8_t opcode) { } // not traced
+int main(int argc, char * argv[]) {
+  static cpu_t cpu;
+  static cpusched_t sched;
+  static via_t via;
+  bool free= strcmp(argv[1],"oneshot")!=0;
+  bool irq= strcmp(argv[1],"irq")==0;
+  uint16_t latch= strtoul(argv[2],0,16);
+  uint32_t num= strtoul(argv[3],0,16);
+  uint32_t clr= argc>4 ? strtoul(argv[4],0,16) : 0;
+  uint32_t s= 0x1000;
+  cpu.cycles= s-4;
+  cpusched_init(&sched,cpu.cycles);
+  cpu.sched= &sched;
+  via_init(&via,&cpu,&sched,0x90);
+  via_write(&via,0x9000+VIA_ACR,free ? VIA_ACR_T1FREE : 0);
+  via_write(&via,0x9000+VIA_IER,0x80|VIA_INT_T1);
+  via_write(&via,0x9000+VIA_T1CL,latch&0xFF);
+  cpu.cycles= s;
+  via_write(&via,0x9000+VIA_T1CH,latch>>8);
+  for( uint32_t k=0; k<=num; k++ ) {
+    cpu.cycles= s+k;
+    if( (int32_t)(cpu.cycles-sched.next)>=0 ) cpusched_run(&sched,&cpu);
+    printf("%%X %%02X %%X", k, via_read(&via,0x9000+VIA_IFR), cpu.irq);
+    if( !irq ) {
+      uint8_t hi= via_read(&via,0x9000+VIA_T1CH);
+      printf(" %%02X%%02X", hi, via_read(&via,0x9000+VIA_T1CL));
+    } else if( k==clr ) {
+      via_read(&via,0x9000+VIA_T1CL);
+    }
+    printf("\\n");
+  }
+  return 0;
+}
+"""
+
+
+# Runs the VIA (see MAIN_CPP); returns the output lines, split in fields
+def run_via(mode,latch,num,clr=0) :
+  sources= ["cpu.cpp","isa.cpp","cpusched.cpp","via.cpp","cpurecomp.cpp","cpurec.cpp","snap.cpp"]
+  return [line.split() for line in host.run(MAIN_CPP % (),sources,args=[mode,f"{latch:X}",f"{num:X}",f"{clr:X}"])]
+
+
+##########################################################################
+### via
+##########################################################################
+
+@unittest.skipUnless(host.available,"needs g++")
+class Test_via(unittest.TestCase):
+
+  # Free-run: N, N-1, .., 0, FFFF (the time-out, flag set), N, ..: a period of N+2 cycles
+  def test_t1_free(self):
+    n= 0x10
+    for k,ifr,irq,count in run_via("free",n,4*(n+2)) :
+      k= int(k,16)
+      j= k%(n+2)
+      self.assertEqual(int(count,16), n-j if j<=n else 0xFFFF, f"cycle {k:X}")
+      self.assertEqual(ifr, "C0" if j==n+1 else "00", f"cycle {k:X}")
+      self.assertEqual(irq, "1" if j==n+1 else "0", f"cycle {k:X}")
+
+  # One-shot: N, .., 0, FFFF (the time-out, flag set), then FFFE, FFFD, .. (no second time-out)
+  def test_t1_oneshot(self):
+    n= 0x10
+    for k,ifr,irq,count in run_via("oneshot",n,4*(n+2)) :
+      k= int(k,16)
+      self.assertEqual(int(count,16), (n-k)&0xFFFF, f"cycle {k:X}")
+      self.assertEqual(ifr, "C0" if k==n+1 else "00", f"cycle {k:X}")
+
+  # The T1 flag (and IRQ) stays set until T1CL is read, and is set again at the next time-out
+  def test_t1_clear(self):
+    n= 0x10
+    lines= run_via("irq",n,3*(n+2),n+5)
+    for k,ifr,irq in lines :
+      k= int(k,16)
+      flagged= n+1<=k<=n+5 or k>=2*n+3
+      self.assertEqual(ifr, "C0" if flagged else "00", f"cycle {k:X}")
+      self.assertEqual(irq, "1" if flagged else "0", f"cycle {k:X}")
+
+
+if __name__ == '__main__':
+  unittest.main()